@@ -0,0 +1,18 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <array>
+#include <cstdint>
+
+#include "tone.h"
+
+// sink for the beeper, given the sound timer at every 60Hz tick. it sounds while the timer is non-zero
+class Audio {
+    public:
+        virtual ~Audio() = default;
+        virtual void set_sound_timer(uint8_t sound_timer) = 0;
+        // XO-CHIP's audio buffer (F002) and pitch (FX3A), given whenever either changes. ignored unless the sink plays them
+        virtual void set_pattern(const std::array<uint8_t, AUDIO_PATTERN_BYTES>& /*pattern*/, uint8_t /*pitch*/) {}
+};
+
+#endif
@@ -1,22 +1,136 @@
 #ifndef CHIP8_H
 #define CHIP8_H
 
-#include "renderer.h" 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "audio.h"
+#include "display.h"
+#include "framebuffer.h"
+#include "inputlog.h"
+#include "keypad.h"
 #include "memory.h"
-#include "sound.h"
 #include "cpu.h"
+#include "profiler.h"
+#include "rewind.h"
+#include "rom.h"
+#include "savestate.h"
+#include "trace.h"
+#include "triplebuffer.h"
+
+#define FRAME_RATE 60 // timers and rendering run at 60Hz
+#define DEFAULT_INSTRUCTIONS_PER_FRAME 12 // 720 instructions / second, close to the usual 700Hz clock
+#define HOST_POLL_MS 1 // how long the host thread waits for a new frame before pumping events again
 
 class Chip8 {
     public:
-        void run(std::string file_path);
+        // the display, audio and keypad are supplied by the host (SDL frontend or the null backends in headless.h)
+        Chip8(Display* display, Audio* audio, Keypad* keypad);
+        bool load_ROM(const std::string& file_path); // false (and a message) if the file isn't a ROM which fits, see read_rom
+        void load_ROM(const Rom& rom);
+        // load the ROM and run until the host quits. the core runs on a thread of its own, while the calling thread pumps
+        // events and presents frames
+        void run(const Rom& rom);
+        void run_frame(); // read the keypad, run one frame's batch of instructions, tick the timers and render (on this thread)
+
+        void set_instructions_per_frame(int instructions_per_frame);
+        void set_turbo(bool turbo); // uncapped mode - run frames as fast as the host allows
+        void set_jit(bool jit); // run through the dynamic recompiler where possible
+        void set_quirks(QuirkProfile profile); // which interpreter's behaviour to follow, chip8 by default
+        uint64_t get_cycle_count() const;
+        uint64_t get_frame_count() const;
+        const Framebuffer& get_framebuffer() const;
+
+        // snapshot / restore the whole machine, in memory or on disk. loading from disk returns false (leaving the
+        // machine as it was) if the file isn't a save state of this version
+        void save_state(SaveState& state) const;
+        void load_state(const SaveState& state);
+        bool save_state(const std::string& file_path) const;
+        bool load_state(const std::string& file_path);
+
+        // record every frame into a rewind history of the given size, at least MIN_REWIND_BYTES (or stop recording and
+        // drop it)
+        void set_rewind(bool enabled, size_t capacity_bytes = DEFAULT_REWIND_BYTES);
+        bool rewind_frame(); // go back one frame, false once the history runs out
+        const Rewind* get_rewind() const; // nullptr unless recording
+
+        // deterministic runs: the random number generator is seeded explicitly, and the keypad is read once per frame,
+        // so that a run can be recorded into an input log and played back exactly (the log's seed is applied on playback)
+        void set_seed(uint32_t seed);
+        void record_input(InputLog* log); // append every frame's input to log (nullptr to stop)
+        void play_input(const InputLog* log); // take each frame's input from log instead of the keypad (nullptr to stop)
+        bool is_playback_finished() const; // true once every frame of the log being played has been used
+
+        // count instructions and time the stages of run (off by default). the report is printed, and saved as JSON to
+        // json_path, when run returns or the host asks for it (F10 in the SDL frontend)
+        void set_profiling(bool enabled, const std::string& json_path = DEFAULT_PROFILE_PATH);
+        Profiler* get_profiler(); // nullptr unless profiling
+        void report_profile() const;
+
+        // record every instruction executed, with the registers it ran with, into a binary trace file (off by default).
+        // the file is written as the core runs and completed when tracing stops (or run returns), see Tracer. false (and
+        // a message) if the file can't be created
+        bool set_tracing(bool enabled, const std::string& file_path = DEFAULT_TRACE_PATH);
+        void set_dump_memory(bool dump_memory); // print the whole of memory when run has loaded the ROM (off by default)
+
     private:
-        bool running_ = true; // when the Chip8 system is created, start it running by default
-        
+        void emulation_loop(); // the emulation thread of run
+        bool is_idle() const; // waiting on FX0A or stopped with the timers run down: frames can be skipped until a key is released
+        void park(); // block the emulation thread until there is input (or a quit / host request) for it
+        void wake(); // from the host thread: the emulation thread has something to do
+        void read_keypad(); // pass the keypad's state on to the emulation thread
+        void emulate_frame(); // run_frame without reading the keypad or rendering
+        void report_stack_fault(); // say (once) why the ROM stopped
+        InputFrame sample_input(); // the keypad's state for the coming frame, from the host or the log being played
+        void render(); // show the framebuffer on the host display
+
+    private:
+        std::atomic<bool> running_{true}; // cleared by the host thread when asked to quit
+
+        // clock configuration
+        int instructions_per_frame_ = DEFAULT_INSTRUCTIONS_PER_FRAME;
+        bool turbo_ = false;
+        // emulated time, which drives the timers and rendering
+        uint64_t cycle_count_ = 0;
+        uint64_t frame_count_ = 0;
+
+        // host side components
+        Display* display_;
+        Audio* audio_;
+        Keypad* keypad_;
+
         // hardware components
-        Renderer renderer_;
         Memory memory_;
-        Sound sound_;
-        CPU cpu_{&memory_, &renderer_, &sound_};
+        Framebuffer framebuffer_;
+        CPU cpu_{&memory_, &framebuffer_, audio_};
+        bool stack_fault_reported_ = false;
+
+        // input recording / playback
+        InputLog* recording_ = nullptr;
+        const InputLog* playback_ = nullptr;
+        uint64_t input_start_frame_ = 0; // frame_count_ when recording / playback began, so both follow rewinds
+
+        std::unique_ptr<Rewind> rewind_; // only allocated while rewind is enabled
+        SaveState rewind_state_; // the frame being recorded into / stepped back to, kept rather than built every frame
+        std::unique_ptr<Profiler> profiler_; // only allocated while profiling
+        std::string profile_path_;
+        std::unique_ptr<Tracer> tracer_; // only allocated while tracing
+        std::string trace_path_;
+        bool dump_memory_ = false;
+
+        // between the host and emulation threads of run: input one way (written by the host thread), finished frames
+        // the other
+        std::atomic<uint16_t> host_keys_{0}; // bit k set while key k is held down
+        std::atomic<uint16_t> host_released_{0}; // keys released since the emulation thread last took them
+        std::atomic<bool> rewind_held_{false};
+        std::atomic<bool> profile_requested_{false};
+        TripleBuffer<Framebuffer> frames_;
+        std::mutex park_mutex_;
+        std::condition_variable park_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -3,36 +3,259 @@
 
 #include <array>
 #include <cstdint>
-#include <stack>
+#include <vector>
 
+#include <audio.h>
+#include <framebuffer.h>
+#include <inputlog.h>
 #include <memory.h>
-#include <renderer.h>
-#include <sound.h>
+#include <quirks.h>
+#include <random.h>
+#include <savestate.h>
+#ifdef CHIP8_JIT
+#include <jit.h>
+#endif
 
+#define HANDLER_COUNT 51 // number of instruction handlers (CPU::op_*)
 
-class CPU {
+class CPU;
+class Profiler;
+class Tracer;
+struct Instruction;
+
+typedef void (CPU::*Handler)(const Instruction& instruction);
+
+// an instruction which has already been decoded: the handler which executes it, and its operands
+struct Instruction {
+    uint8_t handler = HANDLER_COUNT; // index into the handler table of the quirks in use, HANDLER_COUNT marks an empty decode cache entry
+    uint16_t opcode = 0;
+    uint16_t nnn = 0; // lowest 12 bits
+    uint8_t nn = 0; // lowest 8 bits
+    uint8_t n = 0; // lowest 4 bits
+    uint8_t x = 0; // register index in the second nibble
+    uint8_t y = 0; // register index in the third nibble
+};
+
+// copy of the cpu registers, e.g. for comparing two cpus running the same ROM
+struct Registers {
+    uint16_t pc;
+    uint16_t i;
+    std::array<uint8_t, 16> v;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+
+    bool operator==(const Registers& other) const = default;
+};
+
+// a 2NNN with all STACK_SIZE entries of the call stack in use, or a 00EE with none
+enum class StackFault { none, overflow, underflow };
+
+class CPU : public MemoryWatcher {
     public:
-        CPU(Memory* chip8_memory, Renderer* chip8_renderer, Sound* chip8_sound);
-        void cycle(); // run a single CPU cycle
-        void decrement_timer();
+        CPU(Memory* chip8_memory, Framebuffer* chip8_framebuffer, Audio* chip8_audio);
+        void cycle(); // run a single CPU cycle, through the dispatch engine chosen at build time (CHIP8_DISPATCH)
+        // a single cycle through a specific dispatch engine, with the given quirks
+        template <class Quirks = Chip8Quirks>
+        void cycle_cached(); // look the decoded instruction up in the decode cache
+        template <class Quirks = Chip8Quirks>
+        void cycle_table(); // look the handler up in the 64K entry opcode table
+        template <class Quirks = Chip8Quirks>
+        void cycle_switch(); // decode through the nested switch
+        void run_cycles(int cycles); // run a batch of CPU cycles
+        void run_cycles_threaded(int cycles); // run a batch of cycles as threaded code, jumping handler to handler through the opcode table
+
+        // run a batch of cycles through a specific dispatch engine, e.g. run_cycles_using<&CPU::cycle_table<>>, for
+        // comparing them. stops on FX0A as run_cycles does, so that every engine does the same work
+        template <void (CPU::*cycle_function)()>
+        void run_cycles_using(int cycles) {
+            for (int i = 0; i < cycles && !waiting_for_key_; i++) {
+                (this->*cycle_function)();
+            }
+        }
+
+        void decrement_timer(); // decrement the delay and sound timers, called at 60Hz
+        void set_jit_enabled(bool enabled); // run compiled blocks where possible in run_cycles
+        void set_fast_forward(bool enabled); // skip the rest of a batch spent in an idle loop in run_cycles (on by default)
+        // behave as another interpreter, e.g. once a ROM is loaded: cycle and run_cycles use that profile's instantiation
+        // of the handlers from then on
+        void set_quirks(QuirkProfile profile);
+        QuirkProfile get_quirks() const;
+        void set_profiler(Profiler* profiler); // profile the instructions run_cycles executes into profiler (nullptr to stop)
+        void set_tracer(Tracer* tracer); // record every instruction run_cycles executes into tracer (nullptr to stop)
+        static int get_handler(uint16_t opcode); // index of the handler which executes opcode
+        static const char* get_handler_name(int handler); // the instruction a handler executes, e.g. "8XY4"
+        Registers get_registers() const;
+        void set_input(const InputFrame& input); // latch the keypad for the frame about to run
+        void set_seed(uint32_t seed); // seed the CXNN random number generator
+        bool is_waiting_for_key() const { return waiting_for_key_; } // halted by FX0A: run_cycles does nothing until set_input releases a key
+        bool is_stopped() const; // at a jump to itself or 00FD, or faulted: only the timers can change from here on
+        // set once the call stack over / underflows: the cpu stays on the offending 2NNN / 00EE, running it again without
+        // effect, until a save state is loaded
+        StackFault get_stack_fault() const { return stack_fault_; }
+        // the cpu, memory and framebuffer into / out of a save state (emulated time is left to the caller)
+        void save_state(SaveState& state) const;
+        void load_state(const SaveState& state);
+        void memory_written(int memory_loc, int length) override; // drop decoded instructions which overlap the write
 
     private:
+        // run_cycles, cycle and the engines behind them, for one set of quirks
+        template <class Quirks>
+        void run_batch(int cycles);
+        template <class Quirks>
+        void step();
+        template <class Quirks>
+        void run_cycles_jit(int cycles);
+        template <class Quirks>
+        void run_cycles_instrumented(int cycles); // run_cycles while tracing
+        template <class Quirks>
+        void run_cycles_sampled(int cycles); // run_cycles while profiling (without tracing)
+        // what run_threaded does besides executing: skip idle loops as run_cycles does, or go round them as written while
+        // handing the profiler a sample every so often / passing every instruction to instrument
+        enum class ThreadedMode { fast_forward, sampled, instrumented };
+        template <ThreadedMode mode, class Quirks>
+        void run_threaded(int cycles); // run_cycles_threaded in mode
+        void instrument(uint16_t pc, uint16_t opcode); // count / trace the instruction about to execute
+        void sample(); // hand the profiler the instruction about to execute as a sample, and pick the next
+        // the sampled threaded code's stretch is used up: count it, then start the next, sampling the instruction about to
+        // execute if it is time to. returns the cycles left in the new stretch, or -1 at the end of the batch
+        int next_stretch();
         uint16_t fetch(); // fetch instruction from memory
+        static constexpr Instruction decode(uint16_t instruction); // decode instruction into its handler and operands
+        static constexpr uint8_t decode_handler(uint16_t instruction); // find the handler for an instruction through the nested switch
+        template <class Quirks>
         void decode_execute(uint16_t instruction); // decode and then execute instruction
 
+        template <class Quirks>
+        void skip(); // step over the next instruction, for a skip which is taken
+
+        // idle loops: a jump to itself (or 00FD, which stays put), or FX07 / 3XNN (or 4XNN) / 1NNN polling the delay timer. until the timers next tick,
+        // every pass round one of these does the same thing, so the rest of the batch can be skipped
+        int idle_loop_length(uint16_t jump_address) const; // instructions in the idle loop closed by the jump at jump_address, or 0
+        template <class Quirks>
+        bool skip_idle_loop(uint16_t jump_address, int& cycles); // called after the instruction at jump_address: if it closed an idle loop, use up the batch's cycles
+
+        // every possible 16 bit opcode already decoded, and the index of its handler in handlers_ (for threaded dispatch).
+        // the handlers are in the same order whatever the quirks, so both tables are shared by every profile. both are
+        // built at compile time, into read only data
+        static constexpr std::array<uint8_t, 0x10000> build_opcode_table();
+        static constexpr std::array<Instruction, 0x10000> build_decoded_opcodes();
+        template <class Quirks>
+        static const std::array<Handler, HANDLER_COUNT> handlers_;
+        static const std::array<const char*, HANDLER_COUNT> handler_names_;
+        static const std::array<uint8_t, 0x10000> opcode_table_;
+        static const std::array<Instruction, 0x10000> decoded_opcodes_;
+
+        // instruction handlers, named after the instruction they execute
+        void op_nop(const Instruction& instruction);
+        void op_00e0(const Instruction& instruction);
+        void op_00ee(const Instruction& instruction);
+        void op_1nnn(const Instruction& instruction);
+        void op_2nnn(const Instruction& instruction);
+        template <class Quirks>
+        void op_3xnn(const Instruction& instruction);
+        template <class Quirks>
+        void op_4xnn(const Instruction& instruction);
+        template <class Quirks>
+        void op_5xy0(const Instruction& instruction);
+        void op_6xnn(const Instruction& instruction);
+        void op_7xnn(const Instruction& instruction);
+        void op_8xy0(const Instruction& instruction);
+        void op_8xy1(const Instruction& instruction);
+        void op_8xy2(const Instruction& instruction);
+        void op_8xy3(const Instruction& instruction);
+        void op_8xy4(const Instruction& instruction);
+        void op_8xy5(const Instruction& instruction);
+        template <class Quirks>
+        void op_8xy6(const Instruction& instruction);
+        void op_8xy7(const Instruction& instruction);
+        template <class Quirks>
+        void op_8xye(const Instruction& instruction);
+        template <class Quirks>
+        void op_9xy0(const Instruction& instruction);
+        void op_annn(const Instruction& instruction);
+        template <class Quirks>
+        void op_bnnn(const Instruction& instruction);
+        void op_cxnn(const Instruction& instruction);
+        template <class Quirks>
+        void op_dxyn(const Instruction& instruction);
+        template <class Quirks>
+        void op_ex9e(const Instruction& instruction);
+        template <class Quirks>
+        void op_exa1(const Instruction& instruction);
+        void op_fx07(const Instruction& instruction);
+        void op_fx0a(const Instruction& instruction);
+        void op_fx15(const Instruction& instruction);
+        void op_fx18(const Instruction& instruction);
+        void op_fx1e(const Instruction& instruction);
+        void op_fx29(const Instruction& instruction);
+        void op_fx33(const Instruction& instruction);
+        template <class Quirks>
+        void op_fx55(const Instruction& instruction);
+        template <class Quirks>
+        void op_fx65(const Instruction& instruction);
+        // SUPER-CHIP
+        void op_00cn(const Instruction& instruction);
+        void op_00fb(const Instruction& instruction);
+        void op_00fc(const Instruction& instruction);
+        void op_00fd(const Instruction& instruction);
+        void op_00fe(const Instruction& instruction);
+        void op_00ff(const Instruction& instruction);
+        void op_fx30(const Instruction& instruction);
+        void op_fx75(const Instruction& instruction);
+        void op_fx85(const Instruction& instruction);
+        // XO-CHIP
+        void op_00dn(const Instruction& instruction);
+        void op_5xy2(const Instruction& instruction);
+        void op_5xy3(const Instruction& instruction);
+        void op_f000(const Instruction& instruction);
+        void op_fn01(const Instruction& instruction);
+        void op_f002(const Instruction& instruction);
+        void op_fx3a(const Instruction& instruction);
+
     private:
         uint16_t pc_; // program counters
-        std::stack<uint16_t> stack_;
+        std::array<uint16_t, STACK_SIZE> stack_{};
+        uint8_t stack_pointer_ = 0; // index of the next free stack entry, STACK_SIZE when full
+        StackFault stack_fault_ = StackFault::none;
         // registers
         uint16_t i_register_;
         std::array<uint8_t, 16> var_registers_{}; 
-        uint8_t delay_timer_;
+        uint8_t delay_timer_ = 0;
+        uint8_t sound_timer_ = 0;
+        // SUPER-CHIP / XO-CHIP state
+        uint8_t plane_mask_ = 1; // planes DXYN, 00E0 and the scrolls work on (FN01)
+        std::array<uint8_t, 16> flags_{}; // FX75 / FX85 user flags
+        std::array<uint8_t, AUDIO_PATTERN_BYTES> audio_pattern_; // F002
+        uint8_t pitch_ = DEFAULT_AUDIO_PITCH; // FX3A
+
+        // decoded instructions, indexed by the address they were fetched from (on the heap, as with 64KB of memory
+        // this is over half a megabyte)
+        std::vector<Instruction> decode_cache_;
+
+        // dynamic recompiler, with the interpreter as fallback
+        bool jit_enabled_ = false;
+#ifdef CHIP8_JIT
+        Jit jit_;
+#endif
+        Profiler* profiler_ = nullptr;
+        int until_sample_ = 0; // instructions left to run before the profiler's next sample
+        int stretch_ = 0; // cycles in the sampled threaded code's current stretch
+        int after_stretch_ = 0; // and left in the batch after it
+        Tracer* tracer_ = nullptr;
 
         // create pointers to all of the hardware components
         Memory* memory_;
-        Renderer* renderer_; 
-        Sound* sound_;
+        Framebuffer* framebuffer_; 
+        Audio* audio_;
+        // input, as latched at the start of the frame
+        uint16_t keys_ = 0;
+        int8_t released_key_ = -1; // key released during the last frame and not yet taken by FX0A, or -1
+        bool waiting_for_key_ = false; // halted by FX0A until a key is released
+        bool fast_forward_ = true;
+        QuirkProfile quirks_ = QuirkProfile::chip8;
+
+        Random random_;
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,13 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "framebuffer.h"
+
+// sink for finished frames, implemented by the SDL renderer and by the headless backend
+class Display {
+    public:
+        virtual ~Display() = default;
+        virtual void render(const Framebuffer& framebuffer) = 0; // draw out the framebuffer
+};
+
+#endif
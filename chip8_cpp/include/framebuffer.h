@@ -0,0 +1,69 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <array>
+#include <cstdint>
+
+#define SCREEN_WIDTH 128 // SUPER-CHIP / XO-CHIP hi-res, the most the framebuffer holds
+#define SCREEN_HEIGHT 64
+#define LORES_WIDTH 64 // the original CHIP-8 screen, and the resolution every ROM starts in
+#define LORES_HEIGHT 32
+#define ROW_WORDS (SCREEN_WIDTH / 64) // 64 bit words across a hi-res row
+#define PLANE_COUNT 2 // XO-CHIP bitplanes, selected with FN01 (plane 0 alone is the CHIP-8 / SUPER-CHIP display)
+#define ALL_PLANES ((1 << PLANE_COUNT) - 1)
+#define MAX_SPRITE_HEIGHT 16
+#define MAX_SPRITE_BYTES (PLANE_COUNT * 32) // a 16x16 DXY0 sprite for each plane
+
+// the display packed one bit per pixel, per plane. each plane is ROW_WORDS columns of 64 pixel wide words, one word
+// per row, with a column's rows next to each other; the leftmost pixel of a word is its most significant bit. lo-res
+// only uses the first column's first LORES_HEIGHT rows, so a CHIP-8 screen is still one word per row, and drawing,
+// scrolling and clearing work a word (or a vector of words) at a time in either resolution
+class Framebuffer {
+    public:
+        void clear(uint8_t planes = ALL_PLANES); // turn every pixel off in the planes selected (bit p for plane p)
+        void set_hires(bool hires); // 00FF / 00FE: switch resolution, clearing the screen
+        bool is_hires() const { return hires_; }
+        unsigned int get_width() const { return hires_ ? SCREEN_WIDTH : LORES_WIDTH; }
+        unsigned int get_height() const { return hires_ ? SCREEN_HEIGHT : LORES_HEIGHT; }
+        bool get_pixel_is_on(unsigned int x, unsigned int y, unsigned int plane = 0) const;
+        void set_pixel(unsigned int x, unsigned int y, bool status, unsigned int plane = 0); // set the pixel on / off
+        uint8_t get_color(unsigned int x, unsigned int y) const; // bit p set if the pixel is on in plane p
+        uint64_t get_word(unsigned int plane, unsigned int column, unsigned int y) const { return words_[plane][column][y]; }
+        // every word of every plane, PLANE_COUNT * ROW_WORDS * SCREEN_HEIGHT of them, e.g. for save states
+        const uint64_t* get_words() const { return words_[0][0].data(); }
+        void set_words(const uint64_t* words);
+        uint64_t hash() const; // 64 bit FNV-1a of the resolution and every word, for comparing screens across runs
+
+        // DXYN: XOR an N byte sprite (DXY0: 16x16, two bytes a row) onto each plane selected, the sprite for the next
+        // plane following on in memory. clips at the edges, or wraps round them. returns true if any pixel was turned off
+        bool draw(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, uint8_t planes, bool wrap);
+        static unsigned int sprite_bytes(unsigned int n, uint8_t planes); // bytes of memory draw reads
+        // XOR an N byte sprite onto one plane at (x, y), clipping at the edges. returns true if any pixel was turned off
+        bool draw_sprite(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, unsigned int plane = 0);
+        // as draw_sprite, for a sprite which doesn't cross from one column of words into the next
+        bool draw_sprite_scalar(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, unsigned int plane = 0);
+        bool draw_sprite_simd(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, unsigned int plane = 0);
+        // as draw_sprite, but pixels past an edge wrap round to the opposite one (XO-CHIP)
+        bool draw_sprite_wrapped(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, unsigned int plane = 0);
+
+        // scroll the planes selected by n pixels of the current resolution (00CN, 00DN) or by 4 (00FB, 00FC). pixels
+        // scrolled off an edge are lost, and those scrolled in are off
+        void scroll_down(unsigned int n, uint8_t planes = ALL_PLANES);
+        void scroll_up(unsigned int n, uint8_t planes = ALL_PLANES);
+        void scroll_right(uint8_t planes = ALL_PLANES);
+        void scroll_left(uint8_t planes = ALL_PLANES);
+
+        bool operator==(const Framebuffer& other) const = default;
+
+    private:
+        // the general case of drawing: any position, 8 or 16 pixels wide, the sprite split across two columns if it
+        // straddles them (or across the right and left edges, when wrapping)
+        template <bool wrap>
+        bool draw_split(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int rows, unsigned int row_bytes, unsigned int plane);
+
+        // bit (63 - x % 64) of words_[plane][x / 64][y] holds whether pixel (x, y) is on in the plane
+        std::array<std::array<std::array<uint64_t, SCREEN_HEIGHT>, ROW_WORDS>, PLANE_COUNT> words_{};
+        bool hires_ = false;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <cstdint>
+
+#include "audio.h"
+#include "display.h"
+#include "keypad.h"
+
+// null backends, so that the core can run without SDL (no window, audio device or keyboard)
+
+class NullDisplay : public Display {
+    public:
+        void render(const Framebuffer& /*framebuffer*/) override {}
+};
+
+class NullAudio : public Audio {
+    public:
+        void set_sound_timer(uint8_t /*sound_timer*/) override {}
+};
+
+class NullKeypad : public Keypad {
+    public:
+        bool poll_events() override { return true; }
+        bool is_key_pressed(uint8_t /*key*/) override { return false; }
+        bool get_key_released(uint8_t& /*key*/) override { return false; }
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define INPUT_LOG_MAGIC 0x4e493843 // "C8IN" read as a little endian word
+#define INPUT_LOG_VERSION 1
+#define INPUT_FRAME_BYTES 4 // a frame in the file: keys then released
+
+// the keypad as the cpu sees it for one frame: keys are sampled once at the start of each frame, rather than whenever
+// an instruction happens to look, so that a run can be reproduced from the frames alone
+struct InputFrame {
+    uint16_t keys = 0; // bit k set while key k is held down
+    uint16_t released = 0; // bit k set if key k was released since the last frame (for FX0A)
+
+    bool operator==(const InputFrame& other) const = default;
+};
+
+// the seed and every frame's input of a run. the same ROM, seed and input log give a bit-identical run, at any speed
+// and on any thread. saved as a small header followed by the frames, little endian
+class InputLog {
+    public:
+        void clear();
+        void append(const InputFrame& input);
+        void truncate(size_t frames); // drop every frame from frames onwards
+        size_t size() const;
+        const InputFrame& get_frame(size_t frame) const;
+        void set_seed(uint32_t seed);
+        uint32_t get_seed() const;
+
+        bool save(const std::string& file_path) const; // false (and a message) if the file can't be written
+        bool load(const std::string& file_path); // false (and a message) if it is missing, truncated or not an input log of this version
+
+    private:
+        uint32_t seed_ = 0;
+        std::vector<InputFrame> frames_;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "memory.h"
+#include "quirks.h"
+
+#define JIT_MAX_BLOCK_INSTRUCTIONS 32 // longest straight-line run compiled into one block
+#define JIT_CODE_SIZE (1 << 20) // bytes of executable memory, everything is recompiled once this fills up
+
+// a compiled block: takes the V registers and the index register, returns the pc to continue from
+typedef uint16_t (*BlockFunction)(uint8_t* var_registers, uint16_t* i_register);
+
+struct Block {
+    BlockFunction code = nullptr; // nullptr if the block can't be compiled (it starts with an instruction the JIT leaves to the interpreter)
+    uint8_t length = 0; // number of CHIP-8 instructions in the block
+    bool compiled = false; // has compilation been attempted at this address
+};
+
+// x86-64 dynamic recompiler for straight-line runs of CHIP-8 instructions.
+// a block ends at a jump or skip, or just before an instruction which is left to the interpreter
+// (calls, returns, draws, keys, timers and memory access). V registers used by the block are
+// kept in host registers from the start of the block to its end.
+class Jit {
+    public:
+        Jit();
+        ~Jit();
+        Jit(const Jit&) = delete;
+        Jit& operator=(const Jit&) = delete;
+
+        bool initialize(); // map the executable memory, returns false if that isn't allowed
+        const Block& get_block(Memory* memory, uint16_t pc); // block starting at pc, compiled on first use
+        void invalidate(int memory_loc, int length); // drop every block overlapping a write
+        // quirks of the cpu's profile the compiled code depends on (8XY6 / 8XYE, and skips over F000 NNNN), recompiling
+        // every block if they change
+        void set_quirks(QuirkProfile profile);
+
+    private:
+        void compile(Memory* memory, uint16_t pc, Block& block);
+        void flush(); // drop every block and reuse the executable memory from the start
+
+    private:
+        std::vector<Block> blocks_; // one per address, MEMORY_SIZE of them once initialized
+        uint8_t* code_ = nullptr; // executable memory, mapped writable only while a block is copied in
+        size_t code_used_ = 0;
+        bool shift_vx_ = false;
+        bool long_skip_ = false;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+#include <SDL_keycode.h>
+#include <SDL_scancode.h>
+#include <array>
+#include <cstdint>
+
+#include "keypad.h"
+
+// the hex keypad, key 0x0 - 0xf, row by row over the left of the keyboard
+constexpr std::array<SDL_Scancode, 16> hex_to_scancode = {
+    SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, SDL_SCANCODE_4, SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_R,
+    SDL_SCANCODE_A, SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_F, SDL_SCANCODE_Z, SDL_SCANCODE_X, SDL_SCANCODE_C, SDL_SCANCODE_V};
+
+// keypad state kept as bitmasks, updated from SDL key events, so that reading it is a load rather than a lookup
+class Keyboard : public Keypad {
+    public:
+        Keyboard();
+        bool poll_events() override;
+        bool is_key_pressed(uint8_t key) override;
+        bool get_key_released(uint8_t& key) override;
+        uint16_t get_keys() override;
+        uint16_t take_released_keys() override;
+        bool is_rewind_held() override; // backspace
+        bool take_profile_request() override; // F10
+
+    private:
+        std::array<int8_t, SDL_NUM_SCANCODES> scancode_to_hex_; // hex key for each scancode, or -1
+        uint16_t keys_ = 0; // bit n set while key n is held
+        uint16_t released_keys_ = 0; // keys released and not yet taken
+        bool rewind_held_ = false;
+        bool profile_requested_ = false;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <cstdint>
+
+// source for the 16 key hex keypad (keys 0x0 - 0xf) and for host events
+class Keypad {
+    public:
+        virtual ~Keypad() = default;
+        virtual bool poll_events() = 0; // pump host events, returns false once the host has asked to quit
+        virtual bool is_key_pressed(uint8_t key) = 0; // is the hex key currently held down
+        virtual bool get_key_released(uint8_t& key) = 0; // if a hex key was released since the last call, store it in key and return true
+        // the whole keypad as bitmasks (bit n for key n); by default built from the calls above, sources which track the
+        // keys as events override these
+        virtual uint16_t get_keys(); // keys currently held down
+        virtual uint16_t take_released_keys(); // keys released since the last call
+        virtual bool is_rewind_held() { return false; } // host control: step back through the rewind history while held
+        virtual bool take_profile_request() { return false; } // host control: true once for each request to print the profile
+};
+
+inline uint16_t Keypad::get_keys() {
+    uint16_t keys = 0;
+    for (uint8_t key = 0; key < 16; key++) {
+        if (is_key_pressed(key)) {
+            keys |= 1 << key;
+        }
+    }
+    return keys;
+}
+
+inline uint16_t Keypad::take_released_keys() {
+    uint16_t released = 0;
+    uint8_t key;
+    while (get_key_released(key)) {
+        released |= 1 << (key & 0xf);
+    }
+    return released;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef LIBCHIP8_H
+#define LIBCHIP8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// C API of libchip8, the emulation core as a shared library, for embedding it in other languages (e.g. Python through
+// ctypes, see chip8_python/libchip8.py). plain C types only, and the machine is an opaque handle, so that the ABI stays
+// the same whatever happens to the C++ classes behind it. nothing here prints, throws or exits: failures are returned as
+// CHIP8_ERROR_ codes. a machine isn't thread safe, but any number of them can be driven from different threads
+
+#define CHIP8_API_VERSION 1 // bumped whenever a function or type below changes incompatibly
+
+#define CHIP8_MEMORY_SIZE 65536
+#define CHIP8_ROM_START 0x200
+#define CHIP8_MAX_ROM_SIZE (CHIP8_MEMORY_SIZE - CHIP8_ROM_START)
+#define CHIP8_SCREEN_WIDTH 128 // hi-res, the most the framebuffer holds. lo-res uses the top left 64x32
+#define CHIP8_SCREEN_HEIGHT 64
+#define CHIP8_ROW_WORDS 2 // 64 pixel words across a hi-res row
+#define CHIP8_PLANE_COUNT 2
+#define CHIP8_FRAMEBUFFER_WORDS (CHIP8_PLANE_COUNT * CHIP8_ROW_WORDS * CHIP8_SCREEN_HEIGHT)
+
+#define CHIP8_OK 0
+#define CHIP8_ERROR_INVALID_ARGUMENT -1 // a null pointer, or a value out of range
+#define CHIP8_ERROR_ROM_EMPTY -2
+#define CHIP8_ERROR_ROM_TOO_BIG -3 // more than CHIP8_MAX_ROM_SIZE bytes
+#define CHIP8_ERROR_NO_ROM -4 // chip8_reset before any ROM was loaded
+
+// interpreter behaviours, as --quirks
+#define CHIP8_QUIRKS_CHIP8 0
+#define CHIP8_QUIRKS_VIP 1
+#define CHIP8_QUIRKS_SCHIP 2
+#define CHIP8_QUIRKS_XOCHIP 3
+
+#if defined(_WIN32)
+#define CHIP8_API __declspec(dllexport)
+#else
+#define CHIP8_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct chip8 chip8_t;
+typedef struct chip8_vector_env chip8_vector_env_t;
+
+typedef struct chip8_registers {
+    uint16_t pc;
+    uint16_t i;
+    uint8_t v[16];
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+} chip8_registers_t;
+
+CHIP8_API int chip8_get_api_version(void); // CHIP8_API_VERSION of the library loaded, to check against the header used
+
+// a machine at power on: no ROM, chip8 quirks, 12 instructions per frame, the default random seed and no keys held
+// down. nullptr if it can't be allocated
+CHIP8_API chip8_t* chip8_create(void);
+CHIP8_API void chip8_destroy(chip8_t* chip8);
+
+// reset the machine to power on (keeping its quirks, clock and seed) and load a ROM from size bytes of data, which the
+// machine keeps a copy of. on an error the machine is left as it was
+CHIP8_API int chip8_load_rom(chip8_t* chip8, const uint8_t* data, size_t size);
+CHIP8_API int chip8_reset(chip8_t* chip8); // back to power on with the last ROM loaded, e.g. to start an episode again
+
+CHIP8_API int chip8_set_quirks(chip8_t* chip8, int quirks); // a CHIP8_QUIRKS_ profile
+CHIP8_API int chip8_set_instructions_per_frame(chip8_t* chip8, int instructions_per_frame);
+CHIP8_API void chip8_set_seed(chip8_t* chip8, uint32_t seed); // seed CXNN's random number generator, now and on every reset
+// the keypad, bit k set while key k is held down. latched at the start of the next step or frame, as the keypad is on
+// every frame of the SDL frontend. keys held before and not now count as released, for FX0A
+CHIP8_API void chip8_set_keys(chip8_t* chip8, uint16_t keys);
+
+// run instructions, without ticking the timers, or whole frames: instructions_per_frame instructions then a tick of
+// the timers. stops early on FX0A, as the frontends do, until a key is released
+CHIP8_API void chip8_step(chip8_t* chip8, int instructions);
+CHIP8_API void chip8_run_frames(chip8_t* chip8, int frames);
+
+// views straight into the machine, valid (at the same address, so they can be wrapped once) until chip8_destroy, and
+// updated in place as it runs. memory is CHIP8_MEMORY_SIZE bytes. the framebuffer is CHIP8_FRAMEBUFFER_WORDS 64 bit
+// words, one bit per pixel: pixel (x, y) of plane p is bit 63 - x % 64 of word (p * CHIP8_ROW_WORDS + x / 64) *
+// CHIP8_SCREEN_HEIGHT + y. a CHIP-8 screen is just the first 32 words, one per row, with the leftmost pixel in bit 63
+CHIP8_API const uint8_t* chip8_get_memory(const chip8_t* chip8);
+CHIP8_API const uint64_t* chip8_get_framebuffer(const chip8_t* chip8);
+CHIP8_API int chip8_get_width(const chip8_t* chip8); // resolution in use: 64x32, or 128x64 after 00FF
+CHIP8_API int chip8_get_height(const chip8_t* chip8);
+
+CHIP8_API void chip8_get_registers(const chip8_t* chip8, chip8_registers_t* registers);
+CHIP8_API uint64_t chip8_get_frame_count(const chip8_t* chip8); // frames run since the last reset
+CHIP8_API int chip8_is_waiting_for_key(const chip8_t* chip8); // halted by FX0A until a key is released
+CHIP8_API int chip8_is_stopped(const chip8_t* chip8); // at a jump to itself or 00FD, or faulted
+
+// many machines running one ROM as an environment for automated play (include/vectorenv.h): reset them all with a
+// seed each, then step them all with a keypad mask each, frame_skip frames at a time, spread over threads threads.
+// observations are CHIP8_OBSERVATION_BYTES per instance, a byte per pixel (see VectorEnv::step). the reward and done
+// functions read an instance's CHIP8_MEMORY_SIZE bytes of memory after each frame, and return its reward for the
+// frame / whether its episode is over; with more than one thread they are called from all of them at once
+#define CHIP8_OBSERVATION_WIDTH 64
+#define CHIP8_OBSERVATION_HEIGHT 32
+#define CHIP8_OBSERVATION_BYTES (CHIP8_OBSERVATION_WIDTH * CHIP8_OBSERVATION_HEIGHT)
+
+typedef float (*chip8_reward_function)(int instance, const uint8_t* memory, void* context);
+typedef int (*chip8_done_function)(int instance, const uint8_t* memory, void* context);
+
+CHIP8_API chip8_vector_env_t* chip8_vector_env_create(int instances, int threads); // nullptr if either isn't positive
+CHIP8_API void chip8_vector_env_destroy(chip8_vector_env_t* env);
+CHIP8_API int chip8_vector_env_load_rom(chip8_vector_env_t* env, const uint8_t* data, size_t size); // reset before stepping
+CHIP8_API int chip8_vector_env_set_quirks(chip8_vector_env_t* env, int quirks);
+CHIP8_API int chip8_vector_env_set_instructions_per_frame(chip8_vector_env_t* env, int instructions_per_frame);
+CHIP8_API int chip8_vector_env_set_frame_skip(chip8_vector_env_t* env, int frame_skip); // 4 to begin with
+// either function may be null: no reward, or episodes which only end when the ROM stops
+CHIP8_API void chip8_vector_env_set_reward(chip8_vector_env_t* env, chip8_reward_function reward, void* context);
+CHIP8_API void chip8_vector_env_set_done(chip8_vector_env_t* env, chip8_done_function done, void* context);
+CHIP8_API int chip8_vector_env_reset(chip8_vector_env_t* env, const uint32_t* seeds, uint8_t* observations);
+CHIP8_API int chip8_vector_env_step(chip8_vector_env_t* env, const uint16_t* actions, uint8_t* observations, float* rewards, uint8_t* dones);
+CHIP8_API int chip8_vector_env_get_instance_count(const chip8_vector_env_t* env);
+CHIP8_API const uint8_t* chip8_vector_env_get_memory(const chip8_vector_env_t* env, int instance); // as chip8_get_memory
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "framebuffer.h"
+#include "inputlog.h"
+#include "memory.h"
+#include "random.h"
+
+#define LOCKSTEP_LANE_BLOCK 32 // lanes are padded to a multiple of one AVX2 vector of bytes
+#define LOCKSTEP_VECTOR_MIN_LANES 8 // lanes a group needs in each block it has lanes in, on average, to be vectorized
+#define LOCKSTEP_STACK_SIZE 16
+
+// runs many instances of one ROM (lanes) in lockstep, e.g. with different keys or random seeds. the machine state is
+// held in structure-of-arrays form (one array per register, indexed by lane), so that lanes which are at the same
+// instruction execute it together as AVX2 vector operations, if the host has AVX2 (checked at run time, so any x86-64
+// build uses it). lanes which have diverged from most of the others, and instructions which touch memory, the stack,
+// the display or the keys, run one lane at a time, as does everything without AVX2.
+// the instructions behave exactly as they do on CPU with the chip8 quirk profile (SUPER-CHIP / XO-CHIP instructions
+// included): a lane given the same seed and per-frame input as a CPU runs identically
+class LockstepEngine {
+    public:
+        LockstepEngine(int lanes);
+        bool load_ROM(const std::string& file_path); // load the same ROM into every lane, false (and a message) if it can't be read
+        void step(); // every lane executes one instruction
+        void run_frame(int instructions_per_frame); // a batch of steps, then tick every lane's timers
+
+        void set_input(int lane, const InputFrame& input); // latch the lane's keypad for the frame about to run
+        void set_seed(int lane, uint32_t seed); // seed the lane's CXNN random number generator (DEFAULT_RANDOM_SEED to begin with)
+
+        int get_lane_count() const;
+        Registers get_registers(int lane) const;
+        Framebuffer get_framebuffer(int lane) const;
+        uint64_t get_vector_lane_steps() const; // lane-instructions executed as part of a vector operation
+        uint64_t get_scalar_lane_steps() const; // lane-instructions executed one lane at a time
+        uint64_t get_random_draws() const; // how many times CXNN ran, in any lane
+
+    private:
+        uint16_t fetch(int lane); // read the lane's next instruction and advance its pc
+        void execute_group(const int* lanes, int count); // execute the instruction which all of these lanes are at
+        bool execute_vector(uint16_t opcode); // execute for every masked lane, false (doing nothing) if the instruction can't be vectorized
+        void execute_lane(int lane, uint16_t opcode);
+
+        // AVX2 kernels over the masked lanes of the group's blocks
+        template <typename VectorOp>
+        void map_register(uint8_t* vx, const uint8_t* vy, VectorOp vector_op);
+        template <typename VectorOp>
+        void map_register_with_flag(uint8_t* vx, const uint8_t* vy, VectorOp vector_op);
+        template <typename VectorOp>
+        void skip_if(const uint8_t* vx, const uint8_t* vy, VectorOp vector_op);
+        void set_wide(uint16_t* registers, uint16_t value); // pc / index = value
+        void add_wide(uint16_t* registers, const uint8_t* values); // pc / index += 8 bit register
+
+        uint8_t* memory_of(int lane) { return memory_.data() + (size_t(lane) * MEMORY_SIZE); }
+        const uint8_t* memory_of(int lane) const { return memory_.data() + (size_t(lane) * MEMORY_SIZE); }
+
+        int lanes_;
+        int padded_lanes_; // lanes_ rounded up to LOCKSTEP_LANE_BLOCK; padding lanes are never masked in
+
+        // machine state, one entry per lane
+        std::vector<uint16_t> pc_;
+        std::vector<uint16_t> i_register_;
+        std::vector<std::vector<uint8_t>> var_registers_; // var_registers_[register][lane]
+        std::vector<uint8_t> delay_timer_;
+        std::vector<uint8_t> sound_timer_;
+        std::vector<uint16_t> stack_; // LOCKSTEP_STACK_SIZE entries per lane
+        std::vector<uint8_t> stack_pointer_;
+        std::vector<uint8_t> memory_; // MEMORY_SIZE bytes per lane
+        std::vector<Framebuffer> framebuffers_;
+        std::vector<uint8_t> planes_; // FN01 plane mask
+        std::vector<uint8_t> flags_; // FX75 / FX85 user flags, 16 per lane
+        std::vector<uint16_t> keys_;
+        std::vector<int8_t> released_key_; // key released during the last frame and not yet taken by FX0A, or -1
+        std::vector<uint32_t> random_state_; // Random's state, one per lane
+
+        // scratch for each step
+        std::vector<uint16_t> opcodes_;
+        std::vector<uint16_t> step_pc_; // pc the instruction was fetched from
+        std::vector<uint32_t> step_key_; // pc and instruction together, for sorting diverged lanes
+        std::vector<int> lane_order_; // lanes sorted by pc and instruction, when they have diverged
+        std::vector<uint8_t> mask_; // 0xff for the lanes in the group being executed, 0 otherwise
+        std::vector<int> blocks_; // first lane of each block with lanes in the group being executed
+        std::vector<int> block_lanes_; // lanes of the group being executed in each block
+        std::vector<uint8_t> all_lanes_mask_; // mask_ and blocks_ for a group of every lane
+        std::vector<int> all_blocks_;
+        const uint8_t* group_mask_ = nullptr; // which of the two the kernels use
+        const std::vector<int>* group_blocks_ = nullptr;
+        bool avx2_ = false;
+
+        uint64_t vector_lane_steps_ = 0;
+        uint64_t scalar_lane_steps_ = 0;
+        uint64_t random_draws_ = 0;
+};
+
+#endif
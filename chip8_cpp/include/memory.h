@@ -1,34 +1,52 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
-#include <SDL_keycode.h>
-#include <SDL_scancode.h>
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <ostream>
 #include <string>
-#include <unordered_map>
+
+#define MEMORY_SIZE 65536 // XO-CHIP's address space. CHIP-8 and SUPER-CHIP ROMs only use the first 4KB
+#define FONT_START 0x0 // 5 byte hex digits, for FX29
+#define BIG_FONT_START 0x50 // SUPER-CHIP's 10 byte hex digits, for FX30
+#define MEMORY_BLOCK_SIZE 256 // memory in use is counted in whole blocks of this many bytes, see get_used_size
+
+// told whenever memory is overwritten, so that anything derived from its contents (e.g. decoded instructions) can be dropped
+class MemoryWatcher {
+    public:
+        virtual ~MemoryWatcher() = default;
+        virtual void memory_written(int memory_loc, int length) = 0;
+};
+
+struct Rom;
 
 class Memory {
     public:
         Memory();
-        void load_ROM(std::string file_path);
-        int get_from_memory(int memory_loc);
+        bool load_ROM(const std::string& file_path); // false (and a message) if the file isn't a ROM which fits, see read_rom
+        void load_ROM(const Rom& rom); // copy a ROM already read into memory at ROM_START
+        void load_ROM(const uint8_t* data, size_t size); // as above, from a buffer already checked to fit (see libchip8)
+        // addresses wrap round at MEMORY_SIZE. inline, as it is on every instruction fetch
+        int get_from_memory(int memory_loc) const { return memory_[memory_loc & (MEMORY_SIZE - 1)]; }
         void set_memory(int memory_loc, uint8_t val);
-
-    public:
-        std::unordered_map<uint8_t, uint8_t> hex_to_scancode_translation {{0x0, SDL_SCANCODE_1}, {0x1, SDL_SCANCODE_2}, {0x2, SDL_SCANCODE_3}, {0x3, SDL_SCANCODE_4},
-                                                                 {0x4, SDL_SCANCODE_Q}, {0x5, SDL_SCANCODE_W}, {0x6, SDL_SCANCODE_E}, {0x7, SDL_SCANCODE_R},
-                                                                 {0x8, SDL_SCANCODE_A}, {0x9, SDL_SCANCODE_S}, {0xa, SDL_SCANCODE_D}, {0xb, SDL_SCANCODE_F},
-                                                                 {0xc, SDL_SCANCODE_Z}, {0xd, SDL_SCANCODE_X}, {0xe, SDL_SCANCODE_C}, {0xf, SDL_SCANCODE_V}};
-        std::unordered_map<uint8_t, uint8_t> scancode_to_hex_translation; 
+        void set_watcher(MemoryWatcher* watcher);
+        const uint8_t* get_contents() const { return memory_.data(); } // all MEMORY_SIZE bytes, e.g. for save states
+        // the bytes from 0 up to the last block ever written to (by the font, a ROM or the program): every byte after them
+        // is zero. a CHIP-8 program uses 4KB at most, so save states only copy these
+        int get_used_size() const { return used_size_; }
+        // overwrite all of memory with size bytes of contents (a multiple of MEMORY_BLOCK_SIZE) and zeros after them,
+        // telling the watcher about the bytes which changed
+        void set_contents(const uint8_t* contents, int size = MEMORY_SIZE);
 
     private:
-        std::array<uint8_t, 4096> memory_{};
+        std::array<uint8_t, MEMORY_SIZE> memory_{};
+        int used_size_;
+        MemoryWatcher* watcher_ = nullptr;
     friend std::ostream& operator<<(std::ostream& stream, const Memory& obj);
 };
 
 // overload the << operator
 std::ostream& operator<<(std::ostream& stream, const Memory& obj);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,92 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "cpu.h"
+#include "memory.h"
+#include "random.h"
+
+#define PROFILER_HOTSPOTS 16 // PCs listed in the report
+#define PROFILER_SAMPLE_INTERVAL 256 // instructions from one sample to the next, on average (at most 256)
+#define DEFAULT_PROFILE_PATH "chip8profile.json"
+
+// stages of Chip8::run which are timed
+enum class Stage { cpu, render, events, sleep };
+#define STAGE_COUNT 4
+
+// execution profiler: counts instructions by opcode family (CPU handler) and by the address they were fetched from, and
+// times the stages of the main loop. compiled in, but nothing is counted unless one is attached (Chip8::set_profiling).
+// while it is, the cpu runs its interpreter (no JIT) and samples: every PROFILER_SAMPLE_INTERVAL instructions or so
+// (at random, so that no loop keeps in step with the samples) the one about to run is counted for itself and for the
+// uncounted run after it. counting every instruction slowed the fastest ROMs by up to a half; sampling keeps within
+// the 5% chip8bench allows. the instruction count is exact, the split between families and addresses an estimate.
+// while tracing, every instruction is a sample
+class Profiler {
+    public:
+        // the instruction about to run at pc is the next sample: it and the instructions after it, up to the next sample,
+        // are counted with it by count_run
+        void sample(uint16_t pc, int handler) {
+            sample_pc_ = pc & (MEMORY_SIZE - 1);
+            sample_handler_ = handler;
+            samples_++;
+        }
+        void count_run(int instructions) {
+            handler_counts_[sample_handler_] += instructions;
+            pc_counts_[sample_pc_] += instructions;
+        }
+        // instructions until the next sample: a half to one and a half times the average
+        int next_interval() { return PROFILER_SAMPLE_INTERVAL / 2 + random_.next_byte() % PROFILER_SAMPLE_INTERVAL; }
+        void add_time(Stage stage, std::chrono::nanoseconds time);
+        void count_frame();
+        void clear();
+
+        uint64_t get_instruction_count() const;
+        uint64_t get_sample_count() const { return samples_; }
+        uint64_t get_handler_count(int handler) const;
+        uint64_t get_pc_count(uint16_t pc) const;
+
+        void write_report(std::ostream& stream) const; // human readable summary
+        void write_json(std::ostream& stream) const; // everything, for tools
+        bool save_json(const std::string& file_path) const; // false (and a message) if the file can't be written
+
+    private:
+        std::array<uint64_t, HANDLER_COUNT> handler_counts_{};
+        std::array<uint64_t, MEMORY_SIZE> pc_counts_{};
+        uint16_t sample_pc_ = 0;
+        int sample_handler_ = 0;
+        uint64_t samples_ = 0;
+        Random random_;
+        // nanoseconds, atomic as the stages of run are timed on two threads
+        std::array<std::atomic<int64_t>, STAGE_COUNT> stage_times_{};
+        uint64_t frames_ = 0;
+};
+
+// adds the time until it goes out of scope to a stage of the profiler, if there is one
+class StageTimer {
+    public:
+        StageTimer(Profiler* profiler, Stage stage) : profiler_(profiler), stage_(stage) {
+            if (profiler_ != nullptr) {
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+        ~StageTimer() {
+            if (profiler_ != nullptr) {
+                profiler_->add_time(stage_, std::chrono::steady_clock::now() - start_);
+            }
+        }
+        StageTimer(const StageTimer&) = delete;
+        StageTimer& operator=(const StageTimer&) = delete;
+
+    private:
+        Profiler* profiler_;
+        Stage stage_;
+        std::chrono::steady_clock::time_point start_;
+};
+
+#endif
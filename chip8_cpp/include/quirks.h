@@ -0,0 +1,57 @@
+#ifndef QUIRKS_H
+#define QUIRKS_H
+
+#include <string>
+
+// behaviours which differ between CHIP-8 interpreters. each profile is a policy type the CPU's handlers and dispatch
+// loops are instantiated with, so a quirk is a constant folded into the handler rather than a branch on every instruction
+enum class QuirkProfile { chip8, vip, schip, xochip };
+#define QUIRK_PROFILE_COUNT 4
+
+// this interpreter's own behaviour, the default
+struct Chip8Quirks {
+    static constexpr bool shift_vx = false; // 8XY6 / 8XYE shift VX in place, rather than VY into VX
+    static constexpr bool increment_i = false; // FX55 / FX65 leave I pointing past the last register
+    static constexpr bool jump_vx = false; // BXNN jumps to XNN + VX, rather than BNNN to NNN + V0
+    static constexpr bool wrap_sprites = false; // DXYN wraps sprites round the edges of the screen, rather than clipping
+    static constexpr bool long_skip = false; // skips step over the whole of a 4 byte F000 NNNN
+};
+
+// the original COSMAC VIP interpreter
+struct VipQuirks : Chip8Quirks {
+    static constexpr bool increment_i = true;
+};
+
+// CHIP-48 and SUPER-CHIP, on the HP 48 calculators
+struct SchipQuirks : Chip8Quirks {
+    static constexpr bool shift_vx = true;
+    static constexpr bool jump_vx = true;
+};
+
+// XO-CHIP, as in Octo
+struct XoChipQuirks : Chip8Quirks {
+    static constexpr bool increment_i = true;
+    static constexpr bool wrap_sprites = true;
+    static constexpr bool long_skip = true;
+};
+
+// call function with the policy for profile (an empty object, for its type), so that a template is picked once, e.g.
+// per batch of instructions, rather than the quirks being tested per instruction
+template <class Function>
+decltype(auto) with_quirks(QuirkProfile profile, Function&& function) {
+    switch (profile) {
+        case QuirkProfile::vip:
+            return function(VipQuirks{});
+        case QuirkProfile::schip:
+            return function(SchipQuirks{});
+        case QuirkProfile::xochip:
+            return function(XoChipQuirks{});
+        default:
+            return function(Chip8Quirks{});
+    }
+}
+
+const char* get_quirk_profile_name(QuirkProfile profile); // e.g. "schip"
+bool parse_quirk_profile(const std::string& name, QuirkProfile& profile); // false if name isn't a profile
+
+#endif
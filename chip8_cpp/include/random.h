@@ -0,0 +1,30 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+#define DEFAULT_RANDOM_SEED 0x2545f491
+
+// per-machine random number generator for CXNN (xorshift32). seeded explicitly, with its whole state in one word so that
+// it can go in save states, and nothing shared between machines, so that a ROM, seed and input give the same run anywhere
+class Random {
+    public:
+        Random(uint32_t seed = DEFAULT_RANDOM_SEED) { set_seed(seed); }
+        void set_seed(uint32_t seed) { state_ = (seed != 0) ? seed : DEFAULT_RANDOM_SEED; } // xorshift never leaves zero
+        uint32_t get_state() const { return state_; }
+        void set_state(uint32_t state) { set_seed(state); }
+        uint8_t next_byte() { return next_byte(state_); }
+
+        // for callers keeping many generators' states side by side (LockstepEngine)
+        static uint8_t next_byte(uint32_t& state) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state >> 24;
+        }
+
+    private:
+        uint32_t state_;
+};
+
+#endif
@@ -5,23 +5,37 @@
 #include <SDL_render.h>
 #include <SDL_surface.h>
 #include <array>
+#include <atomic>
+#include <cstdint>
 
-#define SCREEN_WIDTH 64
-#define SCREEN_HEIGHT 32
+#include "display.h"
+#include "framebuffer.h"
 
-class Renderer {
+// streaming: the screen is drawn into a CPU side pixel buffer and uploaded once per frame, and nothing is presented on
+// frames where it did not change. target: changed pixels are drawn one at a time into a render target texture
+enum class RenderMode { streaming, target };
+
+class Renderer : public Display {
     public:
-        Renderer();
+        Renderer(RenderMode mode = RenderMode::streaming);
         void clear_screen(); // paint the screen black
-        bool get_pixel_is_on(unsigned int x, unsigned int y);
-        void set_pixel(unsigned int x, unsigned int y, bool status); // set the pixel on / off
-        void render(); // draw out to the screen
+        void render(const Framebuffer& framebuffer) override; // draw out to the screen
         void quit();
     private:
+        void render_streaming(const Framebuffer& framebuffer);
+        void render_target(const Framebuffer& framebuffer);
+        void present(); // copy the texture to the window and show it
+        bool row_changed(const Framebuffer& framebuffer, unsigned int y) const; // does row y differ from drawn_ in any plane
+        static int window_event_watch(void* userdata, SDL_Event* event); // flags that the window needs presenting again
+
+        RenderMode mode_;
         SDL_Window* window_; // window object which holds info about win pos, size, etc.
         SDL_Renderer* renderer_; // renderer object for rendering within the window obj
         SDL_Texture* texture_;
-        std::array<bool, SCREEN_WIDTH * SCREEN_HEIGHT> pixel_status_{}; // array which holds if pixels are set on or off
+        Framebuffer drawn_; // the framebuffer as it was last drawn into the texture
+        // ARGB8888 pixels uploaded to the streaming texture, always hi-res: a lo-res pixel is drawn as 2x2
+        std::array<uint32_t, SCREEN_WIDTH * SCREEN_HEIGHT> pixels_{};
+        std::atomic<bool> needs_present_{true}; // set when the window was exposed / resized, so unchanged frames must still be shown
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,55 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "savestate.h"
+
+#define DEFAULT_REWIND_BYTES (8 << 20) // at the usual clock, 45 minutes or more of history for most ROMs, 10 for busy ones
+// the largest encoded frame: a keyframe whose bytes alternate between zero and not, at 3 bytes for every 2, plus the
+// first run's count
+#define MAX_REWIND_FRAME_BYTES (sizeof(SaveState) * 3 / 2 + 2)
+#define MIN_REWIND_BYTES (2 * MAX_REWIND_FRAME_BYTES) // room for any frame, whatever memory the ROM uses
+#define REWIND_KEYFRAME_INTERVAL 120 // frames between keyframes, i.e. every 2 seconds
+
+// history of save states, one per frame, in a fixed size ring buffer. every REWIND_KEYFRAME_INTERVAL frames a keyframe
+// is stored (run length encoded), and each frame in between as the run length encoded XOR of it against its keyframe,
+// which is usually only a few bytes as most of memory and the screen don't change. any frame is rebuilt from its
+// keyframe in one step, so stepping back costs the same however far back it goes. once the buffer is full the oldest
+// frames are overwritten, a keyframe and its deltas at a time
+class Rewind {
+    public:
+        Rewind(size_t capacity_bytes = DEFAULT_REWIND_BYTES); // raised to MIN_REWIND_BYTES if it is less
+        void record(const SaveState& state); // add the newest frame
+        bool step_back(SaveState& state); // drop the newest frame and rebuild the one before it, false if there is none
+        void clear();
+
+        size_t get_frame_count() const;
+        size_t get_bytes_used() const; // encoded size of the frames held
+
+    private:
+        struct Frame {
+            size_t offset; // where its encoding starts in buffer_
+            size_t size;
+            uint64_t sequence; // frame number, counting from the first recorded
+            uint64_t keyframe_sequence; // frame number of its keyframe (its own if it is one)
+        };
+
+        bool store(const std::vector<uint8_t>& encoded, uint64_t keyframe_sequence); // false if the frame's keyframe had to be dropped
+        const Frame& frame(uint64_t sequence) const { return frames_[sequence - frames_.front().sequence]; }
+
+        std::vector<uint8_t> buffer_;
+        size_t head_ = 0; // where the next frame's encoding goes
+        std::deque<Frame> frames_; // oldest first
+        size_t bytes_used_ = 0;
+        uint64_t next_sequence_ = 0;
+
+        SaveState keyframe_; // decoded keyframe of the newest frame
+        uint64_t keyframe_sequence_ = 0;
+        std::vector<uint8_t> encoded_; // scratch for encoding the frame being recorded
+};
+
+#endif
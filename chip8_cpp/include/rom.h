@@ -0,0 +1,50 @@
+#ifndef ROM_H
+#define ROM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "memory.h"
+#include "quirks.h"
+
+#define ROM_START 0x200 // programs are loaded here, after the font
+#define MAX_ROM_SIZE (MEMORY_SIZE - ROM_START)
+#define ROM_DATABASE_FILE "romdb.txt" // looked for next to a ROM when no database is named
+
+// a ROM file's contents, read and checked once so that it can be loaded into any number of machines without touching
+// the disk again
+struct Rom {
+    std::array<uint8_t, MAX_ROM_SIZE> data{};
+    size_t size = 0;
+    uint64_t hash = 0; // 64 bit FNV-1a of the contents, the key into RomDatabase
+};
+
+// read the whole file into rom with a single unbuffered read. false (and a message) if it is missing, empty or doesn't
+// fit in memory after ROM_START, in which case what rom holds is undefined
+bool read_rom(const std::string& file_path, Rom& rom);
+uint64_t hash_rom(const uint8_t* data, size_t size);
+
+// what a known ROM needs to run properly
+struct RomProfile {
+    QuirkProfile quirks = QuirkProfile::chip8;
+    int instructions_per_frame = 0;
+    std::string name;
+};
+
+// known ROMs by hash, from a text file of lines "<hash in hex> <quirk profile> <instructions per frame> <name>"
+// ('#' starts a comment). looking a ROM up is a single hash table probe, so it is cheap even per instance
+class RomDatabase {
+    public:
+        bool load(const std::string& file_path); // false (and a message) if it is missing or has a malformed line
+        const RomProfile* find(uint64_t hash) const; // nullptr for an unknown ROM
+        size_t size() const { return profiles_.size(); }
+        static std::string default_path(const std::string& rom_path); // ROM_DATABASE_FILE in the ROM's directory
+
+    private:
+        std::unordered_map<uint64_t, RomProfile> profiles_;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#include "framebuffer.h"
+#include "memory.h"
+#include "tone.h"
+
+#define SAVE_STATE_MAGIC 0x38504843 // "CHP8" read as a little endian word
+#define SAVE_STATE_VERSION 4 // bump whenever the layout below changes
+#define STACK_SIZE 16
+
+// the whole machine at one instant, as a fixed size block of plain data. XO-CHIP's 64KB of memory is nearly all of it,
+// but only the memory_size bytes in use (see Memory::get_used_size) are copied in or out, the rest being zero: saving or
+// restoring a CHIP-8 machine copies about 6KB. written to disk as is, up to the end of the memory in use, so save files
+// are only portable between hosts of the same endianness
+struct SaveState {
+    uint32_t magic = SAVE_STATE_MAGIC;
+    uint32_t version = SAVE_STATE_VERSION;
+
+    // cpu
+    uint16_t pc{};
+    uint16_t i{};
+    uint8_t v[16]{};
+    uint8_t delay_timer{};
+    uint8_t sound_timer{};
+    uint8_t stack_pointer{};
+    uint8_t planes{}; // XO-CHIP FN01 plane mask
+    uint16_t stack[STACK_SIZE]{};
+    uint32_t random_state{};
+
+    // keypad as latched for the current frame
+    uint16_t keys{};
+    int8_t released_key{};
+    uint8_t hires{}; // 00FF / 00FE
+
+    // SUPER-CHIP / XO-CHIP extras
+    uint8_t flags[16]{}; // FX75 / FX85 user flags
+    uint8_t audio_pattern[AUDIO_PATTERN_BYTES]{}; // F002
+    uint8_t pitch{}; // FX3A
+    uint8_t reserved[3]{};
+    uint32_t memory_size{}; // bytes of memory in use, a multiple of MEMORY_BLOCK_SIZE. every byte of memory after them is zero
+
+    // emulated time
+    uint64_t cycle_count{};
+    uint64_t frame_count{};
+
+    uint64_t framebuffer[PLANE_COUNT][ROW_WORDS][SCREEN_HEIGHT]{}; // every word of every plane, as in Framebuffer
+    uint8_t memory[MEMORY_SIZE]{};
+
+    size_t get_used_bytes() const { return offsetof(SaveState, memory) + memory_size; } // everything up to the end of the memory in use
+};
+
+static_assert(std::is_trivially_copyable_v<SaveState>, "save states must be copyable with memcpy");
+static_assert(std::is_standard_layout_v<SaveState>, "save states are written to disk as raw bytes");
+
+bool write_save_state(const SaveState& state, const std::string& file_path); // false (and a message) if the file can't be written
+bool read_save_state(SaveState& state, const std::string& file_path); // false (and a message) if it is missing, short or from another version
+
+#endif
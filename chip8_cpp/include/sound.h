@@ -1,20 +1,27 @@
 #ifndef SOUND_H
 #define SOUND_H
 
-#include <SDL_mixer.h>
+#include <SDL2/SDL.h>
+#include <array>
 #include <cstdint>
 
-#define BEEP_PATH "../../SOUND/beep.mp3"
+#include "audio.h"
+#include "tone.h"
 
-class Sound {
+// SDL audio output: the tone is synthesized in the audio callback, a small buffer at a time, so it starts and stops
+// within a few milliseconds of the sound timer
+class Sound : public Audio {
     public:
         Sound();
-        void decrement_timer();
-        void set_timer(uint8_t val);
+        void set_sound_timer(uint8_t sound_timer) override;
+        void set_pattern(const std::array<uint8_t, AUDIO_PATTERN_BYTES>& pattern, uint8_t pitch) override;
         void quit();
+
     private:
-        uint8_t sound_timer_ = 0;
-        Mix_Chunk* beep;
+        static void audio_callback(void* userdata, Uint8* stream, int len);
+
+        SDL_AudioDeviceID device_ = 0;
+        ToneGenerator tone_;
 };
 
-#endif
\ No newline at end of file
+#endif
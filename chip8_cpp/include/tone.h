@@ -0,0 +1,38 @@
+#ifndef TONE_H
+#define TONE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#define AUDIO_SAMPLE_RATE 44100
+#define AUDIO_BUFFER_SAMPLES 256 // about 6ms at 44.1kHz
+#define AUDIO_PATTERN_BYTES 16 // a 128 bit pattern, as in XO-CHIP's audio buffer
+#define DEFAULT_AUDIO_PITCH 64 // XO-CHIP pitch register value for 4000 pattern bits a second
+#define DEFAULT_AUDIO_PATTERN_BYTE 0xf0 // every byte of the default pattern: 4 bits high, 4 low, 500Hz at the default pitch
+#define TONE_AMPLITUDE 4000
+#define TONE_RAMP_SAMPLES 64 // fade in / out over this many samples, so that starting and stopping doesn't click
+
+// the beeper, synthesized: plays a 1 bit pattern on a loop while the sound timer is non-zero. the default pattern is
+// a 500Hz square wave; XO-CHIP ROMs can load their own pattern and pitch. the sound timer is the only state shared with
+// the emulation thread, so it is atomic; generate is called from the audio callback
+class ToneGenerator {
+    public:
+        ToneGenerator(int sample_rate = AUDIO_SAMPLE_RATE);
+        void set_sound_timer(uint8_t sound_timer) { sound_timer_.store(sound_timer, std::memory_order_relaxed); }
+        // not safe against a concurrent generate: the caller must hold off the audio callback (SDL_LockAudioDevice)
+        void set_pattern(const std::array<uint8_t, AUDIO_PATTERN_BYTES>& pattern, uint8_t pitch);
+        void generate(int16_t* samples, int count); // fill samples with the next count samples of output (mono)
+
+    private:
+        int sample_rate_;
+        std::atomic<uint8_t> sound_timer_{0};
+
+        // only touched by generate (or with the audio callback held off)
+        std::array<uint8_t, AUDIO_PATTERN_BYTES> pattern_;
+        uint32_t phase_ = 0; // position in the pattern, in 1/65536ths of a bit
+        uint32_t phase_step_ = 0; // pattern bits per sample, in 1/65536ths
+        int gain_ = 0; // 0 (silent) to TONE_RAMP_SAMPLES (full volume)
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_TRACE_PATH "chip8trace.bin"
+#define DEFAULT_TRACE_RECORDS (1 << 16) // records the ring holds (2MB), a power of two
+#define TRACE_FLUSH_MS 5 // how often the flusher thread writes out what the cpu has traced
+#define TRACE_MAGIC 0x52543843 // "C8TR"
+#define TRACE_VERSION 1
+
+// one executed instruction and the registers it ran with, as stored in the ring and in the trace file
+struct TraceRecord {
+    uint32_t sequence; // instructions traced before this one, so that a gap shows records dropped when the ring was full
+    uint32_t frame; // Chip8 frame count
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t i;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    std::array<uint8_t, 16> v;
+};
+static_assert(sizeof(TraceRecord) == 32);
+
+// start of a trace file, followed by the records in the host's byte order
+struct TraceHeader {
+    uint32_t magic = TRACE_MAGIC;
+    uint32_t version = TRACE_VERSION;
+    uint32_t record_size = sizeof(TraceRecord);
+    uint32_t reserved = 0;
+    uint64_t records = 0; // written out, filled in when the trace is closed (or the process crashes)
+    uint64_t dropped = 0; // lost while the ring was full
+};
+static_assert(sizeof(TraceHeader) == 32);
+
+// execution trace: the cpu appends a record per instruction to a fixed size ring (single producer, single consumer,
+// lock-free), which a thread of its own writes to a file every TRACE_FLUSH_MS. the cpu never waits on the disk: if the
+// ring is full the record is dropped and counted instead. should the process crash, a signal handler writes out what
+// is still in the ring before letting the signal through. the file is binary, chip8trace turns it into text. POSIX only
+class Tracer {
+    public:
+        explicit Tracer(size_t ring_records = DEFAULT_TRACE_RECORDS); // rounded up to a power of two
+        ~Tracer(); // close
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        bool open(const std::string& file_path); // start tracing into a new file, false (and a message) if it can't be created
+        void close(); // write out the rest of the ring and fill in the header
+
+        // called by the cpu on every instruction, from one thread (so inline, and no more than a few stores)
+        void record(uint16_t pc, uint16_t opcode, uint16_t i, const std::array<uint8_t, 16>& v, uint8_t delay_timer, uint8_t sound_timer) {
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            uint32_t sequence = sequence_++;
+            if (head - tail_.load(std::memory_order_acquire) > mask_) {
+                dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return;
+            }
+            TraceRecord& record = ring_[head & mask_];
+            record.sequence = sequence;
+            record.frame = frame_;
+            record.pc = pc;
+            record.opcode = opcode;
+            record.i = i;
+            record.delay_timer = delay_timer;
+            record.sound_timer = sound_timer;
+            record.v = v;
+            head_.store(head + 1, std::memory_order_release);
+        }
+        void set_frame(uint64_t frame) { frame_ = static_cast<uint32_t>(frame); } // stamped on the records from now on
+
+        uint64_t get_written() const; // records written to the file so far
+        uint64_t get_dropped() const;
+
+    private:
+        size_t write_pending(); // consumer side: write everything published since the last call, returns the records written
+        void write_header();
+        void flush_loop();
+        static void crash_handler(int signal);
+
+        std::vector<TraceRecord> ring_;
+        size_t mask_;
+        alignas(64) std::atomic<uint64_t> head_{0}; // records published by the cpu
+        alignas(64) std::atomic<uint64_t> tail_{0}; // records written to the file
+        std::atomic<uint64_t> dropped_{0};
+        uint32_t sequence_ = 0;
+        uint32_t frame_ = 0;
+
+        int fd_ = -1;
+        std::atomic<bool> flushing_{false};
+        std::thread flusher_;
+};
+
+// a whole trace file, e.g. for chip8trace. false (and a message) if it is missing or not a trace of this version. a
+// trace cut short without its header filled in (the process was killed outright) still reads, up to its last whole record
+bool read_trace(const std::string& file_path, TraceHeader& header, std::vector<TraceRecord>& records);
+
+#endif
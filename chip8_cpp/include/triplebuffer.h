@@ -0,0 +1,39 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// lock-free hand over of the latest value from one writer thread to one reader thread. the writer fills the back slot
+// and swaps it with the middle one; the reader swaps the middle slot with its front one when it holds something newer.
+// neither side ever waits for the other, and the reader always gets the most recently published value (older ones
+// which it never got round to are skipped)
+template <typename T>
+class TripleBuffer {
+    public:
+        // writer side
+        T& get_back() { return slots_[back_]; }
+        void publish() { back_ = middle_.exchange(back_ | NEW_BIT, std::memory_order_acq_rel) & INDEX_MASK; }
+
+        // reader side: take the newest published value if there is one since the last call, returns false if not
+        bool update() {
+            if (!(middle_.load(std::memory_order_relaxed) & NEW_BIT)) {
+                return false;
+            }
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX_MASK;
+            return true;
+        }
+        const T& get_front() const { return slots_[front_]; }
+
+    private:
+        static constexpr uint8_t INDEX_MASK = 0x3;
+        static constexpr uint8_t NEW_BIT = 0x4; // set in middle_ when the writer has published since the reader last took it
+
+        std::array<T, 3> slots_{};
+        uint8_t back_ = 0; // only touched by the writer
+        std::atomic<uint8_t> middle_{1};
+        uint8_t front_ = 2; // only touched by the reader
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef VECTORENV_H
+#define VECTORENV_H
+
+#include <atomic>
+#include <barrier>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "cpu.h"
+#include "framebuffer.h"
+#include "headless.h"
+#include "memory.h"
+#include "quirks.h"
+#include "rom.h"
+#include "savestate.h"
+
+#define OBSERVATION_WIDTH LORES_WIDTH
+#define OBSERVATION_HEIGHT LORES_HEIGHT
+#define OBSERVATION_BYTES (OBSERVATION_WIDTH * OBSERVATION_HEIGHT) // per instance, a byte per pixel
+#define DEFAULT_FRAME_SKIP 4 // frames each step runs with the same keys held down
+
+// read an instance's memory after each frame it runs (so that a reward can be taken from the score, say). instance is
+// the instance's index, context whatever was passed in with the function. with more than one thread they are called
+// from all of them at once, for different instances
+using RewardFunction = float (*)(int instance, const uint8_t* memory, void* context);
+using DoneFunction = bool (*)(int instance, const uint8_t* memory, void* context);
+
+// many headless instances of one ROM, as an environment for automated play: reset them all, then step them all at once
+// with a keypad mask each, getting back what is on their screens, a reward and whether each episode is over. every
+// instance is a whole machine with its own cpu, so that they run at full speed (fast forwarding idle loops) however
+// far apart they drift, rather than in lockstep. the instances are split evenly over threads, the caller's own thread
+// being one of them
+class VectorEnv {
+    public:
+        VectorEnv(int instances, int threads = 1);
+        ~VectorEnv();
+        VectorEnv(const VectorEnv&) = delete;
+        VectorEnv& operator=(const VectorEnv&) = delete;
+
+        void load_ROM(const Rom& rom); // the ROM every episode starts from. reset before stepping
+        void set_quirks(QuirkProfile profile);
+        void set_instructions_per_frame(int instructions_per_frame);
+        void set_frame_skip(int frame_skip);
+        // nullptr for no reward (0 every step) / for episodes which only end when the ROM stops
+        void set_reward(RewardFunction reward, void* context = nullptr);
+        void set_done(DoneFunction done, void* context = nullptr);
+
+        // start an episode in every instance: power on, the ROM loaded and instance i's random number generator seeded
+        // with seeds[i]. writes every instance's screen to observations (see step)
+        void reset(const uint32_t* seeds, uint8_t* observations);
+        // every instance runs frame_skip frames with actions[i] held down (bit k for key k), summing the reward after
+        // each frame into rewards[i]. an episode is over once done says so, or the ROM stops (a jump to itself, 00FD or
+        // a stack fault): dones[i] is set, the frames left are skipped and the instance starts its next episode, with
+        // its seed one more than the last. observations get OBSERVATION_BYTES per instance, one after another: a byte
+        // per pixel, row by row, holding the pixel's planes (0 or 1 for CHIP-8). hi-res screens are halved, a pixel on
+        // if any of the four it covers is. for a finished episode, this is the first screen of the next one
+        void step(const uint16_t* actions, uint8_t* observations, float* rewards, uint8_t* dones);
+
+        int get_instance_count() const { return static_cast<int>(instances_.size()); }
+        const uint8_t* get_memory(int instance) const; // MEMORY_SIZE bytes, updated in place as the instance runs
+        const Framebuffer& get_framebuffer(int instance) const;
+        Registers get_registers(int instance) const;
+        uint64_t get_episode(int instance) const; // episodes finished since the last reset
+
+    private:
+        struct Instance {
+            Memory memory;
+            Framebuffer framebuffer;
+            NullAudio audio;
+            CPU cpu{&memory, &framebuffer, &audio};
+            uint32_t seed = 0;
+            uint64_t episode = 0;
+            uint16_t keys = 0; // held down during the last step, so that keys let go count as released for FX0A
+        };
+
+        void start_episode(int instance);
+        void observe(int instance, uint8_t* observation) const;
+        void run_slice(int slice); // the job at hand, for the instances of one thread
+        void worker_loop(int slice);
+        void run_job(); // run_slice on every thread, returning when they are all done
+
+        std::vector<std::unique_ptr<Instance>> instances_; // held by pointer, as each cpu points at its own memory
+        SaveState episode_start_; // a machine at power on with the ROM loaded: every episode starts from this state
+        int instructions_per_frame_;
+        int frame_skip_ = DEFAULT_FRAME_SKIP;
+        RewardFunction reward_ = nullptr;
+        void* reward_context_ = nullptr;
+        DoneFunction done_ = nullptr;
+        void* done_context_ = nullptr;
+
+        // the job the threads are given: a reset (actions_ null) or a step
+        const uint32_t* seeds_ = nullptr;
+        const uint16_t* actions_ = nullptr;
+        uint8_t* observations_ = nullptr;
+        float* rewards_ = nullptr;
+        uint8_t* dones_ = nullptr;
+
+        int slice_count_;
+        std::vector<std::thread> workers_;
+        std::barrier<> job_start_;
+        std::barrier<> job_end_;
+        std::atomic<bool> stopping_{false};
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.h"
+#include "headless.h"
+#include "rom.h"
+
+// headless batch runner - runs every ROM (optionally many instances of each) for a fixed number of frames on a
+// work-stealing thread pool, and reports each ROM's final framebuffer hash, instruction count and wall time
+
+#define DEFAULT_BATCH_FRAMES 600 // 10 seconds of emulated time
+
+// thread pool where each worker drains its own queue first, then steals from the front of the others' queues.
+// all jobs are submitted before run(), so a worker is done once every queue is empty
+class WorkStealingPool {
+    public:
+        WorkStealingPool(int thread_count) {
+            for (int i = 0; i < thread_count; i++) {
+                queues_.push_back(std::make_unique<Queue>());
+            }
+        }
+
+        void submit(std::function<void()> job) {
+            // deal the jobs out round robin
+            queues_[next_queue_]->jobs.push_back(std::move(job));
+            next_queue_ = (next_queue_ + 1) % queues_.size();
+        }
+
+        void run() {
+            std::vector<std::thread> workers;
+            for (size_t worker = 0; worker < queues_.size(); worker++) {
+                workers.emplace_back([this, worker] {
+                    std::function<void()> job;
+                    while (pop(worker, job) || steal(worker, job)) {
+                        job();
+                    }
+                });
+            }
+            for (std::thread& thread : workers) {
+                thread.join();
+            }
+        }
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> jobs;
+        };
+
+        // take the newest job from the worker's own queue
+        bool pop(size_t worker, std::function<void()>& job) {
+            Queue& queue = *queues_[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty()) {
+                return false;
+            }
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            return true;
+        }
+
+        // take the oldest job from the first other queue which has any
+        bool steal(size_t thief, std::function<void()>& job) {
+            for (size_t offset = 1; offset < queues_.size(); offset++) {
+                Queue& queue = *queues_[(thief + offset) % queues_.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (!queue.jobs.empty()) {
+                    job = std::move(queue.jobs.front());
+                    queue.jobs.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        std::vector<std::unique_ptr<Queue>> queues_;
+        size_t next_queue_ = 0;
+};
+
+// outcome of running one instance of a ROM
+struct RunResult {
+    uint64_t framebuffer_hash = 0;
+    uint64_t instructions = 0;
+    double seconds = 0;
+};
+
+// collect the ROMs named on the command line, expanding directories into the .ch8 / .rom files inside them
+std::vector<std::string> find_roms(const std::vector<std::string>& paths) {
+    std::vector<std::string> roms;
+    for (const std::string& path : paths) {
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                std::string extension = entry.path().extension().string();
+                if (entry.is_regular_file() && (extension == ".ch8" || extension == ".rom")) {
+                    roms.push_back(entry.path().string());
+                }
+            }
+        }
+        else {
+            roms.push_back(path);
+        }
+    }
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+// a ROM read once for all of its instances, with the clock and quirks it is run at
+struct BatchRom {
+    std::string path;
+    Rom rom;
+    int instructions_per_frame;
+    QuirkProfile quirks;
+};
+
+// the ROM and input (if not nullptr) are shared read only between the workers
+RunResult run_instance(const BatchRom& rom, int frames, bool jit, uint32_t seed, const InputLog* input) {
+    auto start = std::chrono::steady_clock::now();
+
+    NullDisplay display;
+    NullAudio audio;
+    NullKeypad keypad;
+    // on the heap, as the cpu's decode cache makes a machine too big for comfort on a worker's stack
+    auto chip8 = std::make_unique<Chip8>(&display, &audio, &keypad);
+    chip8->set_instructions_per_frame(rom.instructions_per_frame);
+    chip8->set_jit(jit);
+    chip8->set_quirks(rom.quirks);
+    chip8->set_seed(seed);
+    chip8->play_input(input);
+    chip8->load_ROM(rom.rom);
+    for (int frame = 0; frame < frames; frame++) {
+        chip8->run_frame();
+    }
+
+    RunResult result;
+    result.framebuffer_hash = chip8->get_framebuffer().hash();
+    result.instructions = chip8->get_cycle_count();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void print_usage() {
+    std::cout << "Usage: chip8batch [--frames <frames>] [--instances <instances per ROM>] [--threads <threads>] [--ipf <instructions per frame>] [--jit] [--quirks <chip8|vip|schip|xochip>] [--seed <n>] [--input <input log>] [--rom-db <file>]" <<
+        " <ROM or directory of ROMs>..." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int frames = DEFAULT_BATCH_FRAMES;
+    int instances = 1;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int instructions_per_frame = 0; // 0 and quirks_given false until given, so that known ROMs' own settings can be used
+    bool jit = false;
+    QuirkProfile quirks = QuirkProfile::chip8;
+    bool quirks_given = false;
+    uint32_t seed = DEFAULT_RANDOM_SEED;
+    std::string input_path;
+    std::string rom_db_path;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instances = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+            instructions_per_frame = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--jit") == 0) {
+            jit = true;
+        }
+        else if (std::strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            if (!parse_quirk_profile(argv[++i], quirks)) {
+                std::cout << "Unknown quirk profile " << argv[i] << std::endl;
+                print_usage();
+                exit(-1);
+            }
+            quirks_given = true;
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = std::strtoul(argv[++i], nullptr, 0);
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--rom-db") == 0 && i + 1 < argc) {
+            rom_db_path = argv[++i];
+        }
+        else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (frames <= 0 || instances <= 0 || threads <= 0 || instructions_per_frame < 0) {
+        std::cout << "Frames, instances, threads and instructions per frame must be positive numbers" << std::endl;
+        print_usage();
+        exit(-1);
+    }
+
+    std::vector<std::string> rom_paths = find_roms(paths);
+    if (rom_paths.empty()) {
+        std::cout << "Must provide at least one ROM" << std::endl;
+        print_usage();
+        exit(-1);
+    }
+
+    // every ROM is read and hashed once, however many instances of it run, and looked up in the ROM database (the one
+    // named, or else the one in its directory, if any) for its clock and quirks. the command line overrides both.
+    // ROMs which can't be read are reported and left out of the run
+    std::map<std::string, RomDatabase> databases;
+    std::vector<BatchRom> roms;
+    roms.reserve(rom_paths.size());
+    for (const std::string& path : rom_paths) {
+        BatchRom rom;
+        if (!read_rom(path, rom.rom)) {
+            continue;
+        }
+        std::string db_path = rom_db_path.empty() ? RomDatabase::default_path(path) : rom_db_path;
+        auto database = databases.find(db_path);
+        if (database == databases.end()) {
+            database = databases.emplace(db_path, RomDatabase{}).first;
+            if ((!rom_db_path.empty() || std::filesystem::is_regular_file(db_path)) && !database->second.load(db_path)) {
+                exit(-1);
+            }
+        }
+        const RomProfile* profile = database->second.find(rom.rom.hash);
+        rom.path = path;
+        rom.instructions_per_frame = (instructions_per_frame > 0) ? instructions_per_frame
+                                   : (profile != nullptr) ? profile->instructions_per_frame : DEFAULT_INSTRUCTIONS_PER_FRAME;
+        rom.quirks = (quirks_given || profile == nullptr) ? quirks : profile->quirks;
+        roms.push_back(std::move(rom));
+    }
+    if (roms.empty()) {
+        std::cout << "None of the ROMs could be read" << std::endl;
+        exit(-1);
+    }
+
+    // every instance plays the same input (if any), which brings its own seed
+    InputLog input_log;
+    if (!input_path.empty() && !input_log.load(input_path)) {
+        exit(-1);
+    }
+    const InputLog* input = (input_path.empty()) ? nullptr : &input_log;
+
+    // one job per instance; each writes only its own result slot
+    std::vector<RunResult> results(roms.size() * instances);
+    WorkStealingPool pool(threads);
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        for (int instance = 0; instance < instances; instance++) {
+            RunResult* result = &results[rom * instances + instance];
+            const BatchRom* batch_rom = &roms[rom];
+            pool.submit([=] { *result = run_instance(*batch_rom, frames, jit, seed, input); });
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pool.run();
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // per ROM: the final screen (or "varies" if its instances disagree, which with a fixed seed and input means a bug), instructions and time summed over its instances
+    std::cout << std::left << std::setw(24) << "ROM" << std::right << std::setw(18) << "ROM hash" << std::setw(8) << "quirks" << std::setw(6) << "ipf"
+              << std::setw(18) << "framebuffer hash" << std::setw(16) << "instructions" << std::setw(12) << "wall ms" << std::endl;
+    uint64_t total_instructions = 0;
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        const RunResult& first = results[rom * instances];
+        bool consistent = true;
+        uint64_t instructions = 0;
+        double seconds = 0;
+        for (int instance = 0; instance < instances; instance++) {
+            const RunResult& result = results[rom * instances + instance];
+            consistent = consistent && result.framebuffer_hash == first.framebuffer_hash;
+            instructions += result.instructions;
+            seconds += result.seconds;
+        }
+        total_instructions += instructions;
+
+        std::cout << std::left << std::setw(24) << std::filesystem::path(roms[rom].path).filename().string() << std::right << "  " << std::hex
+                  << std::setfill('0') << std::setw(16) << roms[rom].rom.hash << std::setfill(' ') << std::dec << std::setw(8)
+                  << get_quirk_profile_name(roms[rom].quirks) << std::setw(6) << roms[rom].instructions_per_frame;
+        if (consistent) {
+            std::cout << "  " << std::hex << std::setfill('0') << std::setw(16) << first.framebuffer_hash << std::setfill(' ') << std::dec << "  ";
+        }
+        else {
+            std::cout << std::setw(18) << "varies";
+        }
+        std::cout << std::setw(16) << instructions << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1000 << std::endl;
+    }
+
+    std::cout << results.size() << " runs on " << threads << " threads in " << std::fixed << std::setprecision(3) << wall_seconds << "s ("
+              << std::setprecision(1) << total_instructions / wall_seconds / 1e6 << " MIPS)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,2503 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "framebuffer.h"
+#include "headless.h"
+#include "inputlog.h"
+#include "libchip8.h"
+#include "lockstep.h"
+#include "profiler.h"
+#include "rewind.h"
+#include "rom.h"
+#include "savestate.h"
+#include "tone.h"
+#include "trace.h"
+#include "triplebuffer.h"
+#include "vectorenv.h"
+#include "memory.h"
+
+// headless throughput benchmark - runs each ROM through every dispatch engine and reports instructions / second
+
+// every heap allocation made by the process is counted, so that run_allocations can check that none are made once a ROM
+// is running
+std::atomic<uint64_t> heap_allocations{0};
+
+// every replaceable form of new and delete goes through this one malloc / free pair, so that whichever form frees a
+// block matches whichever allocated it. nullptr when out of memory
+void* counted_allocate(std::size_t size, std::size_t alignment = 0) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    size = std::max<std::size_t>(size, 1);
+    if (alignment == 0) {
+        return std::malloc(size);
+    }
+    // aligned_alloc wants the size in whole multiples of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* counted_allocate_or_throw(std::size_t size, std::size_t alignment = 0) {
+    if (void* pointer = counted_allocate(size, alignment)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) {
+    return counted_allocate_or_throw(size);
+}
+
+void* operator new[](std::size_t size) {
+    return counted_allocate_or_throw(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return counted_allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return counted_allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+#define BENCH_FRAMES 2000
+#define BENCH_INSTRUCTIONS_PER_FRAME 1000
+#define LOCKSTEP_LANES 256
+#define LOCKSTEP_FRAMES 200
+#define LOCKSTEP_CHECKED_LANES 8
+#define SAVE_STATE_FRAMES 100
+#define SAVE_STATE_REPEATS 100000
+#define REWIND_FRAMES (60 * FRAME_RATE) // one minute at the normal clock
+#define REPLAY_FRAMES (60 * FRAME_RATE)
+#define FAMILY_CYCLES 4000000
+#define SPRITE_CYCLES 2000000
+#define HEADLESS_FRAMES (60 * FRAME_RATE)
+#define LOAD_ROM_REPEATS 2000
+#define TRIPLE_BUFFER_MS 200
+#define THREADED_RUN_MS 250
+#define KEY_WAIT_MS 200
+#define KEY_WAIT_FRAMES 1000000
+#define IDLE_FRAMES 20000
+#define ALLOCATION_FRAMES (10 * FRAME_RATE)
+#define PROFILER_REPEATS 31 // runs with and without the profiler, the median of their ratios taken as its overhead
+#define PROFILER_WARM_UP_FRAMES 200 // run before timing, so that neither run is timed filling the caches
+#define PROFILER_BUDGET 0.05 // the most the profiler may slow a ROM down by
+#define PROFILER_SHARE_ERROR 0.02 // the most a sampled opcode family's or address's share of the instructions may be off by
+#define TRACE_FRAMES 200
+#define TRACE_CRASH_FRAMES FRAME_RATE
+#define BENCH_PROGRAM_END 0x1000 // the micro benchmark programs fill the 4KB a CHIP-8 program can address
+#define SCREEN_OPS 4000
+#define SCROLL_OPS 20000
+#define VECTOR_ENV_INSTANCES 64
+#define VECTOR_ENV_STEPS 2000 // timed, for every instance
+#define VECTOR_ENV_CHECKED_INSTANCES 8
+#define VECTOR_ENV_CHECKED_STEPS 300
+
+// collect the ROMs named on the command line, expanding directories into the .ch8 / .rom files inside them (ROMS/ if
+// none are named)
+std::vector<std::string> find_roms(std::vector<std::string> paths) {
+    if (paths.empty()) {
+        paths.push_back(CHIP8_ROMS_DIR);
+    }
+    std::vector<std::string> roms;
+    for (const std::string& path : paths) {
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                std::string extension = entry.path().extension().string();
+                if (entry.is_regular_file() && (extension == ".ch8" || extension == ".rom")) {
+                    roms.push_back(entry.path().string());
+                }
+            }
+        }
+        else if (std::filesystem::is_regular_file(path)) {
+            roms.push_back(path);
+        }
+        else {
+            // checked up front, so that a mistyped path fails before the benchmarks rather than partway through them
+            std::cout << "Error: could not find ROM file " << path << std::endl;
+            exit(-1);
+        }
+    }
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+// minimal streaming JSON writer for the --json report: nested objects and arrays of numbers, strings and booleans
+class JsonWriter {
+    public:
+        void begin_object() { open('{'); }
+        void end_object() { close('}'); }
+        void begin_array() { open('['); }
+        void end_array() { close(']'); }
+        void key(const std::string& name) {
+            separate();
+            write_string(name);
+            out_ << ": ";
+            after_key_ = true;
+        }
+        void value(double number) {
+            separate();
+            // JSON has no infinity or NaN (e.g. a rate from a zero length timing)
+            if (std::isfinite(number)) {
+                out_ << std::setprecision(6) << std::defaultfloat << number;
+            }
+            else {
+                out_ << "null";
+            }
+        }
+        void value(int number) { separate(); out_ << number; }
+        void value(bool boolean) { separate(); out_ << (boolean ? "true" : "false"); }
+        void value(const std::string& text) { separate(); write_string(text); }
+        void value(const char* text) { value(std::string(text)); }
+
+        bool save(const std::string& file_path) const {
+            std::ofstream file(file_path);
+            file << out_.str() << std::endl;
+            if (!file) {
+                std::cout << "Error: could not write " << file_path << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        void open(char bracket) {
+            separate();
+            out_ << bracket;
+            first_.push_back(true);
+        }
+        void close(char bracket) {
+            bool empty = first_.back();
+            first_.pop_back();
+            if (!empty) {
+                newline();
+            }
+            out_ << bracket;
+        }
+        // the comma and newline before a key, or before a value which isn't a key's
+        void separate() {
+            if (after_key_) {
+                after_key_ = false;
+                return;
+            }
+            if (first_.empty()) {
+                return;
+            }
+            if (!first_.back()) {
+                out_ << ',';
+            }
+            first_.back() = false;
+            newline();
+        }
+        void newline() { out_ << '\n' << std::string(2 * first_.size(), ' '); }
+        void write_string(const std::string& text) {
+            out_ << '"';
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    out_ << '\\';
+                }
+                out_ << c;
+            }
+            out_ << '"';
+        }
+
+        std::ostringstream out_;
+        std::vector<bool> first_; // per open object / array, whether nothing has been written into it yet
+        bool after_key_ = false;
+};
+
+enum class Engine { nested_switch, table, threaded, cached, jit };
+#define ENGINE_COUNT 5
+const std::array<const char*, ENGINE_COUNT> ENGINE_NAMES = {"switch", "table", "threaded", "cached", "jit"};
+
+// one headless machine: memory, framebuffer and cpu with null audio, and no keys held down unless set with set_input
+struct Machine {
+    Memory memory;
+    Framebuffer framebuffer;
+    NullAudio audio;
+    CPU cpu{&memory, &framebuffer, &audio};
+};
+
+// a key released every frame, so that ROMs waiting on FX0A (for a key to start, say) carry on running instructions rather
+// than halting, and every engine is timed on the same work
+const InputFrame BENCH_INPUT{0, 1};
+
+void set_instruction(Memory& memory, int address, uint16_t instruction) {
+    memory.set_memory(address, instruction >> 8);
+    memory.set_memory(address + 1, instruction & 0xff);
+}
+
+// micro benchmark program: a long run of randomly chosen register, skip, timer and index instructions ending in a
+// jump back to the start, so that dispatch sees an unpredictable mix of opcodes rather than a few hot loops
+void load_mixed_program(Memory& memory) {
+    const std::array<uint16_t, 20> families = {0x3000, 0x4000, 0x5000, 0x6000, 0x7000, 0x8000, 0x8001, 0x8002, 0x8003, 0x8004,
+                                               0x8005, 0x8006, 0x8007, 0x800e, 0x9000, 0xa000, 0xf007, 0xf015, 0xf018, 0xf01e};
+    std::mt19937 rng(0x8);
+    int address = 0x200;
+    for (; address < BENCH_PROGRAM_END - 2; address += 2) {
+        uint16_t instruction = families[rng() % families.size()];
+        switch (instruction & 0xf000) {
+            case 0x3000:
+            case 0x4000:
+            case 0x6000:
+            case 0x7000:
+                instruction |= rng() & 0x0fff;
+                break;
+            case 0xa000:
+                instruction |= rng() & 0x0fff;
+                break;
+            case 0x5000:
+            case 0x8000:
+            case 0x9000:
+                instruction |= rng() & 0x0ff0;
+                break;
+            case 0xf000:
+                instruction |= rng() & 0x0f00;
+                break;
+        }
+        set_instruction(memory, address, instruction);
+    }
+    set_instruction(memory, address, 0x1200);
+}
+
+// run the machine for BENCH_FRAMES frames, returning millions of instructions per second
+double run_machine(Machine& machine, Engine engine) {
+    machine.cpu.set_jit_enabled(engine == Engine::jit);
+    // the engines themselves are being timed, so idle loops are run rather than skipped
+    machine.cpu.set_fast_forward(false);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        machine.cpu.set_input(BENCH_INPUT);
+        switch (engine) {
+            case Engine::nested_switch:
+                machine.cpu.run_cycles_using<&CPU::cycle_switch<>>(BENCH_INSTRUCTIONS_PER_FRAME);
+                break;
+            case Engine::table:
+                machine.cpu.run_cycles_using<&CPU::cycle_table<>>(BENCH_INSTRUCTIONS_PER_FRAME);
+                break;
+            case Engine::threaded:
+                machine.cpu.run_cycles_threaded(BENCH_INSTRUCTIONS_PER_FRAME);
+                break;
+            case Engine::cached:
+                machine.cpu.run_cycles_using<&CPU::cycle_cached<>>(BENCH_INSTRUCTIONS_PER_FRAME);
+                break;
+            case Engine::jit:
+                machine.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+                break;
+        }
+        machine.cpu.decrement_timer();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return (double(BENCH_FRAMES) * BENCH_INSTRUCTIONS_PER_FRAME) / elapsed.count() / 1e6;
+}
+
+double run_rom(const std::string& rom_path, Engine engine) {
+    Machine machine;
+    machine.memory.load_ROM(rom_path);
+    return run_machine(machine, engine);
+}
+
+double run_mixed(Engine engine) {
+    Machine machine;
+    load_mixed_program(machine.memory);
+    return run_machine(machine, engine);
+}
+
+// an opcode family for the per family micro benchmarks: the fixed bits of the opcode, and which bits are filled in at
+// random. 1NNN and 2NNN / 00EE are laid out specially, so that they run through memory like the others. DXYN is timed
+// by height (run_sprite_height)
+struct OpcodeFamily {
+    const char* name;
+    uint16_t opcode;
+    uint16_t operands;
+};
+
+const std::array<OpcodeFamily, 30> OPCODE_FAMILIES = {{
+    {"00E0", 0x00e0, 0x0000}, {"1NNN", 0x1000, 0x0000}, {"2NNN/00EE", 0x2000, 0x0000}, {"3XNN", 0x3000, 0x0fff},
+    {"4XNN", 0x4000, 0x0fff}, {"5XY0", 0x5000, 0x0ff0}, {"6XNN", 0x6000, 0x0fff}, {"7XNN", 0x7000, 0x0fff},
+    {"8XY0", 0x8000, 0x0ff0}, {"8XY1", 0x8001, 0x0ff0}, {"8XY2", 0x8002, 0x0ff0}, {"8XY3", 0x8003, 0x0ff0},
+    {"8XY4", 0x8004, 0x0ff0}, {"8XY5", 0x8005, 0x0ff0}, {"8XY6", 0x8006, 0x0ff0}, {"8XY7", 0x8007, 0x0ff0},
+    {"8XYE", 0x800e, 0x0ff0}, {"9XY0", 0x9000, 0x0ff0}, {"ANNN", 0xa000, 0x0fff}, {"CXNN", 0xc000, 0x0fff},
+    {"EX9E", 0xe09e, 0x0f00}, {"EXA1", 0xe0a1, 0x0f00}, {"FX07", 0xf007, 0x0f00}, {"FX15", 0xf015, 0x0f00},
+    {"FX18", 0xf018, 0x0f00}, {"FX1E", 0xf01e, 0x0f00}, {"FX29", 0xf029, 0x0f00}, {"FX33", 0xf033, 0x0f00},
+    {"FX55", 0xf055, 0x0f00}, {"FX65", 0xf065, 0x0f00},
+}};
+
+// fill memory from 0x200 with instructions of one family, ending in a jump back to the start. the jump is doubled, so
+// that a skip just before it can't run off the end
+void load_family_program(Memory& memory, const OpcodeFamily& family) {
+    std::mt19937 rng(0xf);
+    int address = 0x200;
+    if (family.opcode == 0x1000) {
+        // each jump to the next
+        for (; address < BENCH_PROGRAM_END - 4; address += 2) {
+            set_instruction(memory, address, 0x1000 | (address + 2));
+        }
+    }
+    else if (family.opcode == 0x2000) {
+        // call a return two instructions on, then jump over it (so a third of these are 1NNN)
+        for (; address < BENCH_PROGRAM_END - 10; address += 6) {
+            set_instruction(memory, address, 0x2000 | (address + 4));
+            set_instruction(memory, address + 2, 0x1000 | (address + 6));
+            set_instruction(memory, address + 4, 0x00ee);
+        }
+    }
+    else {
+        for (; address < BENCH_PROGRAM_END - 4; address += 2) {
+            set_instruction(memory, address, family.opcode | (rng() & family.operands));
+        }
+    }
+    set_instruction(memory, address, 0x1200);
+    set_instruction(memory, address + 2, 0x1200);
+}
+
+// fetch, decode and execute one family of instructions through the build's dispatch, returning ns per instruction
+double run_family(const OpcodeFamily& family) {
+    Machine machine;
+    load_family_program(machine.memory, family);
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FAMILY_CYCLES / BENCH_INSTRUCTIONS_PER_FRAME; frame++) {
+        machine.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+        machine.cpu.decrement_timer();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / FAMILY_CYCLES;
+}
+
+const std::array<int, 6> SPRITE_HEIGHTS = {1, 2, 4, 8, 12, 15};
+
+// DXYN of one height at random positions through the cpu (sprites taken from the font and ROM area), returning ns per draw
+double run_sprite_height(int height) {
+    Machine machine;
+    std::mt19937 rng(0xd);
+    // set every register to a random position and point I at the font, then loop over the draws
+    int address = 0x200;
+    for (int x = 0; x < 16; x++, address += 2) {
+        set_instruction(machine.memory, address, 0x6000 | (x << 8) | (rng() & 0xff));
+    }
+    set_instruction(machine.memory, address, 0xa000);
+    address += 2;
+    int loop = address;
+    for (; address < BENCH_PROGRAM_END - 2; address += 2) {
+        set_instruction(machine.memory, address, 0xd000 | (rng() & 0x0ff0) | height);
+    }
+    set_instruction(machine.memory, address, 0x1000 | loop);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < SPRITE_CYCLES / BENCH_INSTRUCTIONS_PER_FRAME; frame++) {
+        machine.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / SPRITE_CYCLES;
+}
+
+// a minute of emulated time through Chip8 at the normal clock, as the frontend runs it without the sleeps (timers, null
+// rendering and all). returns emulated frames per second
+double run_headless(const std::string& rom_path) {
+    NullDisplay display;
+    NullAudio audio;
+    NullKeypad keypad;
+    auto chip8 = std::make_unique<Chip8>(&display, &audio, &keypad);
+    chip8->load_ROM(rom_path);
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < HEADLESS_FRAMES; frame++) {
+        chip8->run_frame();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return HEADLESS_FRAMES / elapsed.count();
+}
+
+// heap allocations made while the ROM runs headless, once loaded: through the interpreter, the JIT, and the JIT under
+// XO-CHIP quirks, with a save state taken and restored every frame. should be none
+uint64_t run_allocations(const std::string& rom_path) {
+    NullDisplay display;
+    NullAudio audio;
+    NullKeypad keypad;
+    uint64_t allocations = 0;
+    for (int run = 0; run < 3; run++) {
+        auto chip8 = std::make_unique<Chip8>(&display, &audio, &keypad);
+        chip8->set_jit(run > 0);
+        chip8->set_quirks(run == 2 ? QuirkProfile::xochip : QuirkProfile::chip8);
+        chip8->load_ROM(rom_path);
+
+        uint64_t start = heap_allocations.load(std::memory_order_relaxed);
+        SaveState state;
+        for (int frame = 0; frame < ALLOCATION_FRAMES; frame++) {
+            chip8->run_frame();
+            chip8->save_state(state);
+            chip8->load_state(state);
+        }
+        allocations += heap_allocations.load(std::memory_order_relaxed) - start;
+    }
+    return allocations;
+}
+
+struct ProfilerResult {
+    double overhead; // extra time while profiling, as a fraction of the time without
+    std::string check;
+};
+
+// the build's dispatch with and without a profiler attached, which must stay within PROFILER_BUDGET. the profile must
+// account for every instruction, as counted by stepping another machine one instruction at a time (cycles spent
+// waiting on FX0A run none), and its sampled split over opcode families and addresses must be close to the exact one
+ProfilerResult run_profiler(const std::string& rom_path) {
+    ProfilerResult result;
+    uint64_t expected = 0;
+    std::array<uint64_t, HANDLER_COUNT> handler_counts{};
+    std::vector<uint64_t> pc_counts(MEMORY_SIZE);
+    Machine reference;
+    reference.memory.load_ROM(rom_path);
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        reference.cpu.set_input(BENCH_INPUT);
+        for (int i = 0; i < BENCH_INSTRUCTIONS_PER_FRAME && !reference.cpu.is_waiting_for_key(); i++) {
+            uint16_t pc = reference.cpu.get_registers().pc & (MEMORY_SIZE - 1);
+            const uint8_t* memory = reference.memory.get_contents();
+            handler_counts[CPU::get_handler((memory[pc] << 8) | memory[(pc + 1) & (MEMORY_SIZE - 1)])]++;
+            pc_counts[pc]++;
+            reference.cpu.run_cycles_using<&CPU::cycle>(1);
+            expected++;
+        }
+        reference.cpu.decrement_timer();
+    }
+
+    // profiled runs go round idle loops, so runs without the profiler must as well for the same work
+    auto run = [&](Machine& machine, Profiler* profiler, int frames) {
+        machine.cpu.set_profiler(profiler);
+        machine.cpu.set_fast_forward(false);
+        for (int frame = 0; frame < frames; frame++) {
+            machine.cpu.set_input(BENCH_INPUT);
+            machine.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+            machine.cpu.decrement_timer();
+        }
+    };
+    auto profiler = std::make_unique<Profiler>();
+    {
+        Machine machine;
+        machine.memory.load_ROM(rom_path);
+        run(machine, profiler.get(), BENCH_FRAMES);
+    }
+    uint64_t pc_total = 0;
+    double worst_error = 0;
+    for (int pc = 0; pc < MEMORY_SIZE; pc++) {
+        pc_total += profiler->get_pc_count(pc);
+        worst_error = std::max(worst_error, std::abs(double(profiler->get_pc_count(pc)) - double(pc_counts[pc])) / expected);
+    }
+    for (int handler = 0; handler < HANDLER_COUNT; handler++) {
+        worst_error = std::max(worst_error, std::abs(double(profiler->get_handler_count(handler)) - double(handler_counts[handler])) / expected);
+    }
+
+    // timed in pairs, so that whatever else the host is doing slows both runs of a pair alike, taking turns at going
+    // first, as the order alone makes a difference
+    auto timed = std::make_unique<Profiler>();
+    std::vector<double> ratios;
+    for (int repeat = 0; repeat < PROFILER_REPEATS; repeat++) {
+        std::array<double, 2> seconds;
+        for (int run_index = 0; run_index < 2; run_index++) {
+            int profiled = run_index ^ (repeat & 1);
+            Machine machine;
+            machine.memory.load_ROM(rom_path);
+            Profiler* attached = profiled ? timed.get() : nullptr;
+            run(machine, attached, PROFILER_WARM_UP_FRAMES);
+            auto start = std::chrono::steady_clock::now();
+            run(machine, attached, BENCH_FRAMES);
+            seconds[profiled] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        ratios.push_back(seconds[1] / seconds[0]);
+    }
+    std::sort(ratios.begin(), ratios.end());
+    result.overhead = ratios[PROFILER_REPEATS / 2] - 1;
+
+    if (profiler->get_instruction_count() != expected || pc_total != expected) {
+        result.check = "miscounted";
+    }
+    else if (worst_error > PROFILER_SHARE_ERROR) {
+        result.check = "samples off";
+    }
+    else {
+        result.check = (result.overhead <= PROFILER_BUDGET) ? "ok" : "over budget";
+    }
+    return result;
+}
+
+struct TraceResult {
+    double overhead; // extra time while tracing, as a fraction of the time without
+    std::string check;
+};
+
+// the build's dispatch with and without a tracer attached. every instruction must be accounted for, as written or
+// dropped, and each one written must match the pc, opcode, registers and frame of another machine stepped one
+// instruction at a time
+TraceResult run_trace(const std::string& rom_path) {
+    TraceResult result;
+    std::string file_path = (std::filesystem::temp_directory_path() / "chip8bench_trace.bin").string();
+    std::array<double, 2> seconds;
+    Tracer tracer;
+    for (int traced = 0; traced < 2; traced++) {
+        Machine machine;
+        machine.memory.load_ROM(rom_path);
+        if (traced) {
+            tracer.open(file_path);
+            machine.cpu.set_tracer(&tracer);
+        }
+        // traced runs go round idle loops, so the run without the tracer must as well for the same work
+        machine.cpu.set_fast_forward(false);
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < TRACE_FRAMES; frame++) {
+            tracer.set_frame(frame);
+            machine.cpu.set_input(BENCH_INPUT);
+            machine.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+            machine.cpu.decrement_timer();
+        }
+        seconds[traced] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    tracer.close();
+    result.overhead = seconds[1] / seconds[0] - 1;
+
+    TraceHeader header;
+    std::vector<TraceRecord> records;
+    if (!read_trace(file_path, header, records)) {
+        result.check = "unreadable";
+        return result;
+    }
+    std::filesystem::remove(file_path);
+
+    result.check = (header.records == records.size()) ? "ok" : "header";
+    Machine reference;
+    reference.memory.load_ROM(rom_path);
+    uint64_t sequence = 0;
+    size_t next = 0;
+    for (size_t frame = 0; frame < TRACE_FRAMES; frame++) {
+        reference.cpu.set_input(BENCH_INPUT);
+        for (int i = 0; i < BENCH_INSTRUCTIONS_PER_FRAME && !reference.cpu.is_waiting_for_key(); i++) {
+            if (next < records.size() && records[next].sequence == sequence) {
+                const TraceRecord& record = records[next++];
+                Registers registers = reference.cpu.get_registers();
+                uint16_t opcode = (reference.memory.get_from_memory(registers.pc) << 8) | reference.memory.get_from_memory(registers.pc + 1);
+                if ((record.pc != registers.pc || record.opcode != opcode || record.i != registers.i || record.v != registers.v
+                     || record.delay_timer != registers.delay_timer || record.sound_timer != registers.sound_timer || record.frame != frame)
+                    && result.check == "ok") {
+                    result.check = "instruction " + std::to_string(sequence);
+                }
+            }
+            reference.cpu.run_cycles_using<&CPU::cycle>(1);
+            sequence++;
+        }
+        reference.cpu.decrement_timer();
+    }
+    if ((next != records.size() || header.records + header.dropped != sequence) && result.check == "ok") {
+        result.check = "miscounted";
+    }
+    return result;
+}
+
+// a process which crashes while tracing must still leave every instruction it ran in the trace file: a child runs the
+// ROM through Chip8 with tracing on and then takes a SIGSEGV
+std::string run_trace_crash(const std::string& rom_path) {
+    std::string file_path = (std::filesystem::temp_directory_path() / "chip8bench_crash.bin").string();
+    std::cout.flush();
+    pid_t child = fork();
+    if (child == 0) {
+        std::cout.rdbuf(nullptr);
+        NullDisplay display;
+        NullAudio audio;
+        NullKeypad keypad;
+        auto chip8 = std::make_unique<Chip8>(&display, &audio, &keypad);
+        chip8->load_ROM(rom_path);
+        chip8->set_tracing(true, file_path);
+        for (int frame = 0; frame < TRACE_CRASH_FRAMES; frame++) {
+            chip8->run_frame();
+        }
+        std::raise(SIGSEGV);
+        _exit(0); // only if the signal didn't end the process
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGSEGV) {
+        return "didn't crash";
+    }
+    TraceHeader header;
+    std::vector<TraceRecord> records;
+    std::streambuf* cout_buffer = std::cout.rdbuf(nullptr);
+    bool read = read_trace(file_path, header, records);
+    // the instructions the child ran, counted by running the same frames again without the crash. not frames alone, as
+    // a ROM waiting on FX0A runs none
+    uint64_t expected;
+    {
+        NullDisplay display;
+        NullAudio audio;
+        NullKeypad keypad;
+        auto chip8 = std::make_unique<Chip8>(&display, &audio, &keypad);
+        chip8->load_ROM(rom_path);
+        chip8->set_profiling(true);
+        for (int frame = 0; frame < TRACE_CRASH_FRAMES; frame++) {
+            chip8->run_frame();
+        }
+        expected = chip8->get_profiler()->get_instruction_count();
+    }
+    std::cout.rdbuf(cout_buffer);
+    std::filesystem::remove(file_path);
+    if (!read || records.empty()) {
+        return "nothing flushed";
+    }
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i].sequence != i) {
+            return "records lost";
+        }
+    }
+    if (header.records != records.size() || header.dropped != 0 || records.size() != expected) {
+        return "header";
+    }
+    return "ok";
+}
+
+// Memory::load_ROM, returning microseconds per load
+double run_load_rom(const std::string& rom_path) {
+    Memory memory;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < LOAD_ROM_REPEATS; i++) {
+        memory.load_ROM(rom_path);
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / LOAD_ROM_REPEATS;
+}
+
+// the loader must take a ROM which just fits, byte for byte and with the right hash, and turn away one a byte too big,
+// an empty file and a missing one without touching memory
+std::string run_rom_loader() {
+    std::string file_path = (std::filesystem::temp_directory_path() / "chip8bench_loader.ch8").string();
+    std::mt19937 rng(0x21);
+    std::vector<uint8_t> contents(MAX_ROM_SIZE + 1);
+    for (uint8_t& byte : contents) {
+        byte = rng();
+    }
+    auto write_file = [&](size_t size) {
+        std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(contents.data()), size);
+    };
+
+    // the loader's error messages aren't wanted here
+    std::streambuf* cout_buffer = std::cout.rdbuf(nullptr);
+    std::string check = "ok";
+    Memory memory;
+    write_file(MAX_ROM_SIZE);
+    Rom rom;
+    if (!memory.load_ROM(file_path) || !read_rom(file_path, rom) || rom.hash != hash_rom(contents.data(), MAX_ROM_SIZE)
+        || !std::equal(contents.begin(), contents.begin() + MAX_ROM_SIZE, memory.get_contents() + ROM_START)) {
+        check = "full size ROM not loaded";
+    }
+    Memory before = memory;
+    write_file(MAX_ROM_SIZE + 1);
+    if (memory.load_ROM(file_path) && check == "ok") {
+        check = "oversized ROM loaded";
+    }
+    write_file(0);
+    if (memory.load_ROM(file_path) && check == "ok") {
+        check = "empty ROM loaded";
+    }
+    std::filesystem::remove(file_path);
+    if (memory.load_ROM(file_path) && check == "ok") {
+        check = "missing ROM loaded";
+    }
+    if (!std::equal(before.get_contents(), before.get_contents() + MEMORY_SIZE, memory.get_contents()) && check == "ok") {
+        check = "memory changed by a rejected ROM";
+    }
+    std::cout.rdbuf(cout_buffer);
+    return check;
+}
+
+// the name of the ROM in the database next to it, or "-" if it isn't known
+std::string find_known_rom(const std::string& rom_path) {
+    Rom rom;
+    RomDatabase database;
+    std::string db_path = RomDatabase::default_path(rom_path);
+    if (!read_rom(rom_path, rom) || !std::filesystem::is_regular_file(db_path) || !database.load(db_path)) {
+        return "-";
+    }
+    const RomProfile* profile = database.find(rom.hash);
+    return (profile != nullptr) ? profile->name : "-";
+}
+
+// differential test of the JIT against the interpreter: run both side by side, comparing them after every frame.
+// returns the first frame they disagree on, or -1
+int compare_jit(const std::string& rom_path) {
+    Machine interpreter, jit;
+    interpreter.memory.load_ROM(rom_path);
+    jit.memory.load_ROM(rom_path);
+    jit.cpu.set_jit_enabled(true);
+
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        interpreter.cpu.set_input(BENCH_INPUT);
+        jit.cpu.set_input(BENCH_INPUT);
+        interpreter.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+        jit.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+        interpreter.cpu.decrement_timer();
+        jit.cpu.decrement_timer();
+        if (!(interpreter.cpu.get_registers() == jit.cpu.get_registers()) || !(interpreter.framebuffer == jit.framebuffer)) {
+            return frame;
+        }
+    }
+    return -1;
+}
+
+// skipping idle loops must leave the machine exactly where running them does: run with and without fast forward side by
+// side, comparing after every frame. returns the first frame they disagree on, or -1, and the speedup in speedup
+int compare_fast_forward(Memory& memory_image, int frames, double& speedup) {
+    Machine run, skip;
+    run.memory.set_contents(memory_image.get_contents());
+    skip.memory.set_contents(memory_image.get_contents());
+    run.cpu.set_fast_forward(false);
+
+    std::chrono::duration<double> run_time{0}, skip_time{0};
+    for (int frame = 0; frame < frames; frame++) {
+        run.cpu.set_input(BENCH_INPUT);
+        skip.cpu.set_input(BENCH_INPUT);
+        auto start = std::chrono::steady_clock::now();
+        run.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+        auto middle = std::chrono::steady_clock::now();
+        skip.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+        skip_time += std::chrono::steady_clock::now() - middle;
+        run_time += middle - start;
+        run.cpu.decrement_timer();
+        skip.cpu.decrement_timer();
+        if (!(run.cpu.get_registers() == skip.cpu.get_registers()) || !(run.framebuffer == skip.framebuffer)) {
+            return frame;
+        }
+    }
+    speedup = run_time / skip_time;
+    return -1;
+}
+
+struct IdleResult {
+    double speedup = 0; // of the batches with fast forward, over running every instruction
+    std::string check;
+};
+
+IdleResult run_idle(const std::string& rom_path) {
+    IdleResult result;
+    Memory memory;
+    memory.load_ROM(rom_path);
+    int mismatch = compare_fast_forward(memory, BENCH_FRAMES, result.speedup);
+    result.check = (mismatch < 0) ? "ok" : "frame " + std::to_string(mismatch);
+    return result;
+}
+
+// the two idle loops: polling the delay timer (a second at a time, forever), and a jump to itself after one poll.
+// skipping them must be exact, and much faster than going round
+IdleResult run_idle_loops() {
+    IdleResult result;
+    result.check = "ok";
+    // V0 = 60, DT = V0, poll: V1 = DT, skip if V1 == 0, jump poll; then jump back to the start, or to itself
+    for (uint16_t last : {0x1200, 0x120a}) {
+        const std::array<uint16_t, 6> program = {0x603c, 0xf015, 0xf107, 0x3100, 0x1204, last};
+        Memory memory;
+        for (size_t i = 0; i < program.size(); i++) {
+            set_instruction(memory, 0x200 + 2 * i, program[i]);
+        }
+        double speedup = 0; // left at 0 if they disagree
+        int mismatch = compare_fast_forward(memory, IDLE_FRAMES, speedup);
+        if (mismatch >= 0) {
+            result.check = "frame " + std::to_string(mismatch);
+        }
+        else if (speedup < 10 && result.check == "ok") {
+            result.check = "not skipped";
+        }
+        result.speedup = (result.speedup == 0) ? speedup : std::min(result.speedup, speedup);
+    }
+    return result;
+}
+
+// a call stack which over / underflows must stop the cpu on the offending instruction, with the fault set, rather than
+// wrapping round: 2200 calls itself until the stack is full, and 00EE returns with nothing to return to
+std::string run_stack() {
+    for (uint16_t instruction : {0x2200, 0x00ee}) {
+        Machine machine;
+        set_instruction(machine.memory, 0x200, instruction);
+        machine.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+        StackFault expected = (instruction == 0x2200) ? StackFault::overflow : StackFault::underflow;
+        if (machine.cpu.get_stack_fault() != expected || machine.cpu.get_registers().pc != 0x200 || !machine.cpu.is_stopped()) {
+            return std::string(expected == StackFault::overflow ? "overflow" : "underflow") + " not caught";
+        }
+    }
+    return "ok";
+}
+
+struct QuirksResult {
+    std::array<double, QUIRK_PROFILE_COUNT> mips; // the mixed opcode program under each profile
+    std::string check;
+};
+
+// a program touching every quirk, run under each profile: BNNN picks VA = 1 (V0 + NNN) or 2 (BXNN, V2 + XNN), 8126
+// shifts V2 or V1 into V1, F155 stores V0 and V1 at 300 and F065 reads V0 back unless I has moved past them, and D341
+// draws at x = 62, clipped or wrapped. then the mixed opcode program is timed under each profile, and the JIT (which
+// compiles 8XY6 / 8XYE) checked against the interpreter under SUPER-CHIP's shifts
+QuirksResult run_quirks() {
+    QuirksResult result;
+    result.check = "ok";
+    const std::array<uint16_t, 20> program = {0x6004, 0x6208, 0xb20a, 0x0000, 0x0000, 0x0000, 0x0000, 0x6a01, 0x1214, 0x6a02,
+                                              0x6105, 0x8126, 0xa300, 0xf155, 0xf065, 0x633e, 0x6400, 0xa000, 0xd341, 0x1226};
+    for (int index = 0; index < QUIRK_PROFILE_COUNT; index++) {
+        QuirkProfile profile = static_cast<QuirkProfile>(index);
+        Machine machine;
+        for (size_t i = 0; i < program.size(); i++) {
+            set_instruction(machine.memory, 0x200 + 2 * i, program[i]);
+        }
+        machine.cpu.set_quirks(profile);
+        machine.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+
+        Registers expected = machine.cpu.get_registers();
+        uint8_t shifted = with_quirks(profile, [](auto quirks) { return decltype(quirks)::shift_vx ? 5 >> 1 : 8 >> 1; });
+        expected.pc = 0x226;
+        expected.v[0xa] = with_quirks(profile, [](auto quirks) { return decltype(quirks)::jump_vx ? 2 : 1; });
+        expected.v[0x1] = shifted;
+        expected.v[0x0] = with_quirks(profile, [&](auto quirks) { return decltype(quirks)::increment_i ? 0 : 4; });
+        uint64_t row = with_quirks(profile, [](auto quirks) { return decltype(quirks)::wrap_sprites ? 0xc000000000000003 : 0x3; });
+        if (!(machine.cpu.get_registers() == expected) || machine.framebuffer.get_word(0, 0, 0) != row
+            || machine.memory.get_from_memory(0x300) != 4 || machine.memory.get_from_memory(0x301) != shifted) {
+            result.check = std::string(get_quirk_profile_name(profile)) + " mismatch";
+        }
+
+        Machine mixed;
+        load_mixed_program(mixed.memory);
+        mixed.cpu.set_quirks(profile);
+        result.mips[index] = run_machine(mixed, Engine::threaded);
+    }
+
+    Machine interpreter, jit;
+    load_mixed_program(interpreter.memory);
+    load_mixed_program(jit.memory);
+    interpreter.cpu.set_quirks(QuirkProfile::schip);
+    jit.cpu.set_quirks(QuirkProfile::schip);
+    jit.cpu.set_jit_enabled(true);
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        interpreter.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+        jit.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+        interpreter.cpu.decrement_timer();
+        jit.cpu.decrement_timer();
+        if (!(interpreter.cpu.get_registers() == jit.cpu.get_registers()) && result.check == "ok") {
+            result.check = "schip jit frame " + std::to_string(frame);
+            break;
+        }
+    }
+    return result;
+}
+
+// the same screen as Framebuffer, a pixel at a time, as a reference for the packed words
+struct PixelScreen {
+    bool hires = false;
+    std::array<std::array<std::array<bool, SCREEN_WIDTH>, SCREEN_HEIGHT>, PLANE_COUNT> pixels{};
+
+    unsigned int get_width() const { return hires ? SCREEN_WIDTH : LORES_WIDTH; }
+    unsigned int get_height() const { return hires ? SCREEN_HEIGHT : LORES_HEIGHT; }
+    void set_hires(bool on) {
+        hires = on;
+        pixels = {};
+    }
+    void clear(uint8_t planes) {
+        for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+            if ((planes >> plane) & 1) {
+                pixels[plane] = {};
+            }
+        }
+    }
+    bool draw(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, uint8_t planes, bool wrap) {
+        unsigned int rows = (n == 0) ? 16 : n;
+        unsigned int columns = (n == 0) ? 16 : 8;
+        bool collision = false;
+        for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+            if (!((planes >> plane) & 1)) {
+                continue;
+            }
+            for (unsigned int row = 0; row < rows; row++) {
+                for (unsigned int column = 0; column < columns; column++) {
+                    if (!((sprite[(row * columns + column) / 8] >> (7 - column % 8)) & 1)) {
+                        continue;
+                    }
+                    unsigned int pixel_x = x + column, pixel_y = y + row;
+                    if (wrap) {
+                        pixel_x %= get_width();
+                        pixel_y %= get_height();
+                    }
+                    else if (pixel_x >= get_width() || pixel_y >= get_height()) {
+                        continue;
+                    }
+                    bool& pixel = pixels[plane][pixel_y][pixel_x];
+                    collision = collision || pixel;
+                    pixel = !pixel;
+                }
+            }
+            sprite += rows * columns / 8;
+        }
+        return collision;
+    }
+    void scroll(int dx, int dy, uint8_t planes) {
+        for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+            if (!((planes >> plane) & 1)) {
+                continue;
+            }
+            auto old = pixels[plane];
+            for (int y = 0; y < int(get_height()); y++) {
+                for (int x = 0; x < int(get_width()); x++) {
+                    int from_x = x - dx, from_y = y - dy;
+                    bool inside = from_x >= 0 && from_x < int(get_width()) && from_y >= 0 && from_y < int(get_height());
+                    pixels[plane][y][x] = inside && old[from_y][from_x];
+                }
+            }
+        }
+    }
+    void scroll_down(unsigned int n, uint8_t planes) { scroll(0, n, planes); }
+    void scroll_up(unsigned int n, uint8_t planes) { scroll(0, -int(n), planes); }
+    void scroll_right(uint8_t planes) { scroll(4, 0, planes); }
+    void scroll_left(uint8_t planes) { scroll(-4, 0, planes); }
+};
+
+bool same_screen(const Framebuffer& framebuffer, const PixelScreen& screen) {
+    if (framebuffer.is_hires() != screen.hires) {
+        return false;
+    }
+    for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+        for (unsigned int y = 0; y < SCREEN_HEIGHT; y++) {
+            for (unsigned int x = 0; x < SCREEN_WIDTH; x++) {
+                if (framebuffer.get_pixel_is_on(x, y, plane) != screen.pixels[plane][y][x]) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+enum class ScreenOpKind { draw, scroll_down, scroll_up, scroll_right, scroll_left, clear, resolution };
+
+// one of the display instructions, with its operands
+struct ScreenOp {
+    ScreenOpKind kind;
+    uint8_t x, y, n, planes;
+    bool flag; // wrap, for a draw; hi-res, for a change of resolution
+    std::array<uint8_t, MAX_SPRITE_BYTES> sprite;
+};
+
+template <class Screen>
+bool apply_screen_op(Screen& screen, const ScreenOp& op) {
+    switch (op.kind) {
+        case ScreenOpKind::draw:
+            return screen.draw(op.x & (screen.get_width() - 1), op.y & (screen.get_height() - 1), op.sprite.data(), op.n, op.planes, op.flag);
+        case ScreenOpKind::scroll_down:
+            screen.scroll_down(op.n, op.planes);
+            break;
+        case ScreenOpKind::scroll_up:
+            screen.scroll_up(op.n, op.planes);
+            break;
+        case ScreenOpKind::scroll_right:
+            screen.scroll_right(op.planes);
+            break;
+        case ScreenOpKind::scroll_left:
+            screen.scroll_left(op.planes);
+            break;
+        case ScreenOpKind::clear:
+            screen.clear(op.planes);
+            break;
+        case ScreenOpKind::resolution:
+            screen.set_hires(op.flag);
+            break;
+    }
+    return false;
+}
+
+std::vector<ScreenOp> make_screen_ops(int count, bool scrolls_only) {
+    std::mt19937 rng(0x23);
+    std::vector<ScreenOp> ops(count);
+    for (ScreenOp& op : ops) {
+        // mostly draws and scrolls, the odd clear and (rarer still, as it wipes the screen) change of resolution
+        unsigned int pick = rng() % 100;
+        if (scrolls_only) {
+            op.kind = static_cast<ScreenOpKind>(1 + pick % 4);
+        }
+        else {
+            op.kind = (pick < 45) ? ScreenOpKind::draw : (pick < 93) ? static_cast<ScreenOpKind>(1 + pick % 4) : (pick < 98) ? ScreenOpKind::clear : ScreenOpKind::resolution;
+        }
+        op.x = rng();
+        op.y = rng();
+        op.n = rng() % 16;
+        op.planes = rng() % (1 << PLANE_COUNT);
+        op.flag = rng() & 1;
+        for (uint8_t& byte : op.sprite) {
+            byte = rng();
+        }
+    }
+    return ops;
+}
+
+// a program using each SUPER-CHIP / XO-CHIP instruction: hi-res, a 16x16 sprite straddling the bottom right corner
+// (clipped, or wrapped for XO-CHIP), the four scrolls, a large digit on the second plane, registers through memory above
+// 4KB (5XY2 / 5XY3) and the user flags (FX75 / FX85), then a skip over F000 NNNN which only XO-CHIP takes in one go
+// (elsewhere the skip lands on NNNN = 6A01), then 00FD
+const std::array<uint16_t, 32> HIRES_PROGRAM = {
+    0x00ff, 0x6078, 0x6138, 0xf000, 0x0300, 0xd010, 0x00c3, 0x00fb, 0x00fc, 0x00d1, 0xf201, 0x6205, 0xf230, 0xd22a, 0xf301, 0x6311,
+    0x6422, 0x6533, 0xf000, 0x8000, 0x5352, 0x6300, 0x6400, 0x6500, 0x5533, 0xf575, 0x6000, 0xf085, 0x3078, 0xf000, 0x6a01, 0x00fd,
+};
+#define HIRES_SPRITE 0x300
+
+struct HiresResult {
+    double packed_mops; // scrolls a second on the packed framebuffer, in millions
+    double pixel_mops; // the same scrolls on the pixel at a time reference
+    std::string check;
+};
+
+// the packed framebuffer's draws, scrolls, clears and changes of resolution against the pixel at a time reference, then
+// the scrolls timed on each. then the program above through every engine and quirk profile, against what the reference
+// draws and each other, and through the lockstep engine and a save state
+HiresResult run_hires() {
+    HiresResult result;
+    result.check = "ok";
+
+    Framebuffer framebuffer;
+    PixelScreen screen;
+    std::vector<ScreenOp> ops = make_screen_ops(SCREEN_OPS, false);
+    for (size_t i = 0; i < ops.size() && result.check == "ok"; i++) {
+        bool collision = apply_screen_op(framebuffer, ops[i]);
+        if (collision != apply_screen_op(screen, ops[i]) || !same_screen(framebuffer, screen)) {
+            result.check = "screen op " + std::to_string(i);
+        }
+    }
+
+    std::vector<ScreenOp> scrolls = make_screen_ops(SCROLL_OPS, true);
+    framebuffer.set_hires(true);
+    screen.set_hires(true);
+    auto start = std::chrono::steady_clock::now();
+    for (const ScreenOp& op : scrolls) {
+        apply_screen_op(framebuffer, op);
+    }
+    std::chrono::duration<double> packed_elapsed = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for (const ScreenOp& op : scrolls) {
+        apply_screen_op(screen, op);
+    }
+    std::chrono::duration<double> pixel_elapsed = std::chrono::steady_clock::now() - start;
+    result.packed_mops = SCROLL_OPS / packed_elapsed.count() / 1e6;
+    result.pixel_mops = SCROLL_OPS / pixel_elapsed.count() / 1e6;
+    if (!same_screen(framebuffer, screen) && result.check == "ok") {
+        result.check = "scroll timing run";
+    }
+
+    // the program as a ROM file, for the lockstep engine
+    std::string file_path = (std::filesystem::temp_directory_path() / "chip8bench_hires.ch8").string();
+    std::vector<uint8_t> rom(HIRES_SPRITE + 32 - ROM_START);
+    for (size_t i = 0; i < HIRES_PROGRAM.size(); i++) {
+        rom[2 * i] = HIRES_PROGRAM[i] >> 8;
+        rom[2 * i + 1] = HIRES_PROGRAM[i] & 0xff;
+    }
+    std::mt19937 rng(0x24);
+    for (size_t i = HIRES_SPRITE - ROM_START; i < rom.size(); i++) {
+        rom[i] = rng();
+    }
+    {
+        std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(rom.data()), rom.size());
+    }
+
+    for (int index = 0; index < QUIRK_PROFILE_COUNT && result.check == "ok"; index++) {
+        QuirkProfile profile = static_cast<QuirkProfile>(index);
+        bool wrap = with_quirks(profile, [](auto quirks) { return decltype(quirks)::wrap_sprites; });
+        bool long_skip = with_quirks(profile, [](auto quirks) { return decltype(quirks)::long_skip; });
+
+        // what the program draws, and leaves in the registers
+        Memory memory;
+        PixelScreen expected_screen;
+        expected_screen.set_hires(true);
+        expected_screen.draw(0x78, 0x38, rom.data() + HIRES_SPRITE - ROM_START, 0, 1, wrap);
+        expected_screen.scroll_down(3, 1);
+        expected_screen.scroll_right(1);
+        expected_screen.scroll_left(1);
+        expected_screen.scroll_up(1, 1);
+        uint8_t digit[10];
+        for (int i = 0; i < 10; i++) {
+            digit[i] = memory.get_from_memory(BIG_FONT_START + 5 * 10 + i);
+        }
+        bool collision = expected_screen.draw(5, 5, digit, 10, 2, wrap);
+        Registers expected{};
+        expected.pc = 0x23e;
+        expected.i = 0x8000;
+        expected.v = {0x78, 0x38, 0x05, 0x33, 0x22, 0x11};
+        expected.v[0xa] = long_skip ? 0 : 1;
+        expected.v[0xf] = collision ? 1 : 0;
+
+        for (int engine = 0; engine < ENGINE_COUNT && result.check == "ok"; engine++) {
+            Machine machine;
+            machine.memory.load_ROM(file_path);
+            machine.cpu.set_quirks(profile);
+            machine.cpu.set_jit_enabled(static_cast<Engine>(engine) == Engine::jit);
+            with_quirks(profile, [&](auto quirks) {
+                using Quirks = decltype(quirks);
+                switch (static_cast<Engine>(engine)) {
+                    case Engine::nested_switch:
+                        machine.cpu.run_cycles_using<&CPU::cycle_switch<Quirks>>(BENCH_INSTRUCTIONS_PER_FRAME);
+                        break;
+                    case Engine::table:
+                        machine.cpu.run_cycles_using<&CPU::cycle_table<Quirks>>(BENCH_INSTRUCTIONS_PER_FRAME);
+                        break;
+                    case Engine::threaded:
+                        machine.cpu.run_cycles_threaded(BENCH_INSTRUCTIONS_PER_FRAME);
+                        break;
+                    case Engine::cached:
+                        machine.cpu.run_cycles_using<&CPU::cycle_cached<Quirks>>(BENCH_INSTRUCTIONS_PER_FRAME);
+                        break;
+                    case Engine::jit:
+                        machine.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+                        break;
+                }
+            });
+            std::string where = std::string(get_quirk_profile_name(profile)) + " " + ENGINE_NAMES[engine];
+            if (!(machine.cpu.get_registers() == expected) || !same_screen(machine.framebuffer, expected_screen) || !machine.cpu.is_stopped()) {
+                result.check = where + " mismatch";
+                break;
+            }
+
+            // everything the program set up survives a save state into a fresh machine
+            SaveState state;
+            machine.cpu.save_state(state);
+            Machine restored;
+            restored.cpu.load_state(state);
+            SaveState resaved;
+            restored.cpu.save_state(resaved);
+            if (!(restored.framebuffer == machine.framebuffer) || std::memcmp(&state, &resaved, sizeof(state)) != 0) {
+                result.check = where + " save state";
+            }
+            // and a state with less memory in use (one at power on) loaded over it clears the memory past that
+            Machine power_on;
+            power_on.cpu.save_state(state);
+            machine.cpu.load_state(state);
+            if (machine.memory.get_used_size() != power_on.memory.get_used_size()
+                || std::memcmp(machine.memory.get_contents(), power_on.memory.get_contents(), MEMORY_SIZE) != 0) {
+                result.check = where + " smaller save state";
+            }
+        }
+
+        if (profile == QuirkProfile::chip8 && result.check == "ok") {
+            LockstepEngine lockstep(1);
+            lockstep.load_ROM(file_path);
+            lockstep.run_frame(BENCH_INSTRUCTIONS_PER_FRAME);
+            if (!(lockstep.get_registers(0) == expected) || !same_screen(lockstep.get_framebuffer(0), expected_screen)) {
+                result.check = "lockstep mismatch";
+            }
+        }
+    }
+    std::filesystem::remove(file_path);
+    return result;
+}
+
+// keys held down in a lockstep lane: none in the even lanes, one key each in the odd lanes, so that ROMs which read the
+// keypad diverge
+uint16_t lane_keys(int lane) {
+    return (lane % 2 == 0) ? 0 : 1 << ((lane / 2) % 16);
+}
+
+struct LockstepResult {
+    double mips; // lane-instructions per second over all lanes
+    double vector_share; // fraction of lane-instructions which were executed as vector operations
+    std::string check;
+};
+
+LockstepResult run_lockstep(const std::string& rom_path) {
+    LockstepResult result;
+    LockstepEngine engine(LOCKSTEP_LANES);
+    engine.load_ROM(rom_path);
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        engine.set_input(lane, {lane_keys(lane), 0});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < LOCKSTEP_FRAMES; frame++) {
+        engine.run_frame(BENCH_INSTRUCTIONS_PER_FRAME);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double lane_steps = engine.get_vector_lane_steps() + engine.get_scalar_lane_steps();
+    result.mips = lane_steps / elapsed.count() / 1e6;
+    result.vector_share = engine.get_vector_lane_steps() / lane_steps;
+
+    // differential test of the first few lanes against cpus holding the same keys (and with the same default seed), after
+    // every frame
+    LockstepEngine checked(LOCKSTEP_CHECKED_LANES);
+    checked.load_ROM(rom_path);
+    std::vector<Machine> machines(LOCKSTEP_CHECKED_LANES);
+    for (int lane = 0; lane < LOCKSTEP_CHECKED_LANES; lane++) {
+        checked.set_input(lane, {lane_keys(lane), 0});
+        machines[lane].cpu.set_input({lane_keys(lane), 0});
+        machines[lane].memory.load_ROM(rom_path);
+    }
+    result.check = "ok";
+    for (int frame = 0; frame < LOCKSTEP_FRAMES && result.check == "ok"; frame++) {
+        checked.run_frame(BENCH_INSTRUCTIONS_PER_FRAME);
+        for (int lane = 0; lane < LOCKSTEP_CHECKED_LANES; lane++) {
+            Machine& machine = machines[lane];
+            machine.cpu.run_cycles_using<&CPU::cycle_switch<>>(BENCH_INSTRUCTIONS_PER_FRAME);
+            machine.cpu.decrement_timer();
+            if (!(checked.get_registers(lane) == machine.cpu.get_registers()) || !(checked.get_framebuffer(lane) == machine.framebuffer)) {
+                result.check = "frame " + std::to_string(frame);
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+struct SaveStateResult {
+    double save_ns;
+    double restore_ns;
+    std::string check;
+};
+
+void run_frames(Machine& machine, int first_frame, int frames) {
+    for (int frame = first_frame; frame < first_frame + frames; frame++) {
+        machine.cpu.run_cycles(BENCH_INSTRUCTIONS_PER_FRAME);
+        machine.cpu.decrement_timer();
+    }
+}
+
+// time snapshots and restores, and check that a restored machine (in memory and via disk) replays identically
+SaveStateResult run_save_state(const std::string& rom_path) {
+    SaveStateResult result;
+    Machine machine;
+    machine.memory.load_ROM(rom_path);
+    run_frames(machine, 0, SAVE_STATE_FRAMES);
+    SaveState before;
+    machine.cpu.save_state(before);
+    run_frames(machine, SAVE_STATE_FRAMES, SAVE_STATE_FRAMES);
+    SaveState after;
+    machine.cpu.save_state(after);
+
+    SaveState scratch;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SAVE_STATE_REPEATS; i++) {
+        machine.cpu.save_state(scratch);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    result.save_ns = elapsed.count() / SAVE_STATE_REPEATS;
+
+    // alternate between two states, so that each restore really changes the machine
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SAVE_STATE_REPEATS; i++) {
+        machine.cpu.load_state(i % 2 ? after : before);
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    result.restore_ns = elapsed.count() / SAVE_STATE_REPEATS;
+
+    // rewinding to the first snapshot and running the same frames again must arrive at the second
+    machine.cpu.load_state(before);
+    run_frames(machine, SAVE_STATE_FRAMES, SAVE_STATE_FRAMES);
+    SaveState replayed;
+    machine.cpu.save_state(replayed);
+
+    std::string file_path = (std::filesystem::temp_directory_path() / "chip8bench.state").string();
+    SaveState from_disk;
+    bool disk_ok = write_save_state(after, file_path) && read_save_state(from_disk, file_path) && std::memcmp(&from_disk, &after, sizeof(after)) == 0;
+    std::filesystem::remove(file_path);
+
+    if (std::memcmp(&replayed, &after, sizeof(after)) != 0) {
+        result.check = "replay differs";
+    }
+    else {
+        result.check = disk_ok ? "ok" : "disk differs";
+    }
+    return result;
+}
+
+struct RewindResult {
+    double kb_per_minute; // history size per minute of emulated time
+    double step_back_ns;
+    std::string check;
+};
+
+// record a minute of frames at the normal clock, then step all the way back, checking every frame against a hash of a
+// full copy
+RewindResult run_rewind(const std::string& rom_path) {
+    RewindResult result;
+    NullDisplay display;
+    NullAudio audio;
+    NullKeypad keypad;
+    auto chip8 = std::make_unique<Chip8>(&display, &audio, &keypad);
+    chip8->set_rewind(true);
+    chip8->load_ROM(rom_path);
+
+    // hashes rather than the states themselves, which at up to ~66KB apiece would take a quarter of a gigabyte. only the
+    // bytes in use are hashed, as every byte past them is zero
+    auto state_hash = [](const SaveState& state) { return hash_rom(reinterpret_cast<const uint8_t*>(&state), state.get_used_bytes()); };
+    std::vector<uint64_t> expected(REWIND_FRAMES + 1);
+    SaveState recorded;
+    chip8->save_state(recorded);
+    expected[0] = state_hash(recorded);
+    for (int frame = 1; frame <= REWIND_FRAMES; frame++) {
+        chip8->run_frame();
+        chip8->save_state(recorded);
+        expected[frame] = state_hash(recorded);
+    }
+    result.kb_per_minute = chip8->get_rewind()->get_bytes_used() / 1024.0 * (60.0 * FRAME_RATE / REWIND_FRAMES);
+
+    result.check = "ok";
+    std::chrono::duration<double, std::nano> elapsed{0};
+    for (int frame = REWIND_FRAMES - 1; frame >= 0; frame--) {
+        auto start = std::chrono::steady_clock::now();
+        bool stepped = chip8->rewind_frame();
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        SaveState state;
+        chip8->save_state(state);
+        if (!stepped || state_hash(state) != expected[frame]) {
+            result.check = "frame " + std::to_string(frame);
+            break;
+        }
+    }
+    if (result.check == "ok" && chip8->rewind_frame()) {
+        result.check = "ran past start";
+    }
+    result.step_back_ns = elapsed.count() / REWIND_FRAMES;
+
+    // the smallest history still holds the largest frame: all of memory in use, every other byte of it set
+    if (result.check == "ok") {
+        Rewind smallest(0);
+        auto worst = std::make_unique<SaveState>();
+        for (int loc = 0; loc < MEMORY_SIZE; loc += 2) {
+            worst->memory[loc] = 0xff;
+        }
+        worst->memory_size = MEMORY_SIZE;
+        smallest.record(*worst);
+        auto next = std::make_unique<SaveState>(*worst);
+        next->memory[1] = 1;
+        smallest.record(*next);
+        if (!smallest.step_back(*next) || std::memcmp(next.get(), worst.get(), sizeof(SaveState)) != 0) {
+            result.check = "largest frame";
+        }
+    }
+    return result;
+}
+
+// hand a stream of numbered frames from one thread to another through a TripleBuffer for TRIPLE_BUFFER_MS. every
+// frame the reader takes must be whole (all words from the same write) and newer than the last. returns how many it
+// took, or -1 on a bad one
+long run_triple_buffer() {
+    TripleBuffer<std::array<uint64_t, SCREEN_HEIGHT>> buffer;
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (uint64_t frame = 1; !done; frame++) {
+            buffer.get_back().fill(frame);
+            buffer.publish();
+        }
+    });
+
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(TRIPLE_BUFFER_MS);
+    long taken = 0;
+    uint64_t last = 0;
+    bool ok = true;
+    while (ok && std::chrono::steady_clock::now() < end) {
+        if (!buffer.update()) {
+            // let the writer run, in case they share a core
+            std::this_thread::yield();
+            continue;
+        }
+        const auto& frame = buffer.get_front();
+        ok = frame[0] > last && std::all_of(frame.begin(), frame.end(), [&](uint64_t word) { return word == frame[0]; });
+        last = frame[0];
+        taken++;
+    }
+    done = true;
+    writer.join();
+    return ok ? taken : -1;
+}
+
+// asks to quit once its time is up
+class TimedKeypad : public NullKeypad {
+    public:
+        TimedKeypad(std::chrono::milliseconds time) : deadline_(std::chrono::steady_clock::now() + time) {}
+        bool poll_events() override { return std::chrono::steady_clock::now() < deadline_; }
+
+    private:
+        std::chrono::steady_clock::time_point deadline_;
+};
+
+// remembers every frame it was given to show
+class RecordingDisplay : public Display {
+    public:
+        void render(const Framebuffer& framebuffer) override { hashes.push_back(framebuffer.hash()); }
+
+        std::vector<uint64_t> hashes;
+};
+
+struct ThreadedResult {
+    double frames_per_second; // emulated frames, in turbo
+    size_t presents;
+    std::string check;
+};
+
+// Chip8::run in turbo for a moment, with the core on its own thread. every frame the host presented must be one the
+// core produced, in order, and the core must end up where running the same number of frames on one thread does
+ThreadedResult run_threaded(const std::string& rom_path) {
+    ThreadedResult result;
+    RecordingDisplay display;
+    NullAudio audio;
+    TimedKeypad keypad{std::chrono::milliseconds(THREADED_RUN_MS)};
+    auto chip8 = std::make_unique<Chip8>(&display, &audio, &keypad);
+    chip8->set_turbo(true);
+
+    Rom rom;
+    read_rom(rom_path, rom);
+    auto start = std::chrono::steady_clock::now();
+    chip8->run(rom);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.frames_per_second = chip8->get_frame_count() / elapsed.count();
+    result.presents = display.hashes.size();
+
+    NullDisplay null_display;
+    NullKeypad null_keypad;
+    auto reference = std::make_unique<Chip8>(&null_display, &audio, &null_keypad);
+    reference->load_ROM(rom_path);
+    size_t presented = 0;
+    for (uint64_t frame = 0; frame < chip8->get_frame_count(); frame++) {
+        reference->run_frame();
+        // a greedy match is enough to tell whether the presented frames are a subsequence of the produced ones
+        if (presented < display.hashes.size() && display.hashes[presented] == reference->get_framebuffer().hash()) {
+            presented++;
+        }
+    }
+
+    if (presented != display.hashes.size()) {
+        result.check = "present " + std::to_string(presented);
+    }
+    else if (!(reference->get_framebuffer() == chip8->get_framebuffer())) {
+        result.check = "final frame";
+    }
+    else {
+        result.check = (result.presents > 0) ? "ok" : "no presents";
+    }
+    return result;
+}
+
+// releases key once, after release_time, then asks to quit at the end of its time
+class ReleasingKeypad : public TimedKeypad {
+    public:
+        ReleasingKeypad(std::chrono::milliseconds release_time, std::chrono::milliseconds time, uint8_t key)
+            : TimedKeypad(time), release_at_(std::chrono::steady_clock::now() + release_time), key_(key) {}
+        bool get_key_released(uint8_t& key) override {
+            if (released_ || std::chrono::steady_clock::now() < release_at_) {
+                return false;
+            }
+            key = key_;
+            released_ = true;
+            return true;
+        }
+
+    private:
+        std::chrono::steady_clock::time_point release_at_;
+        uint8_t key_;
+        bool released_ = false;
+};
+
+struct KeyWaitResult {
+    double ns_per_frame; // a frame of the cpu waiting on FX0A
+    uint64_t frames; // emulated by Chip8::run in turbo over KEY_WAIT_MS, most of it waiting
+    double cpu_ms; // process time used over the run
+    std::string check;
+};
+
+// FX0A: the cpu must halt (so waiting frames cost next to nothing) and take the key into VX once one is released, and
+// Chip8::run must park rather than spin through frames while waiting, even in turbo. a key let go a frame before FX0A
+// runs mustn't count, on the cpu or in a lockstep lane
+KeyWaitResult run_key_wait() {
+    KeyWaitResult result;
+    // VF = 0xaa, V3 = key, V4 = key (which never comes)
+    const std::array<uint16_t, 4> program = {0x6faa, 0xf30a, 0xf40a, 0x1206};
+    Machine machine;
+    for (size_t i = 0; i < program.size(); i++) {
+        set_instruction(machine.memory, 0x200 + 2 * i, program[i]);
+    }
+
+    // key 7 is released in a frame which stops short of the first FX0A
+    machine.cpu.set_input(InputFrame{0, 1 << 7});
+    machine.cpu.run_cycles(1);
+    machine.cpu.set_input(InputFrame{});
+    machine.cpu.run_cycles(DEFAULT_INSTRUCTIONS_PER_FRAME);
+    bool halted = machine.cpu.is_waiting_for_key() && machine.cpu.get_registers().pc == 0x202;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < KEY_WAIT_FRAMES; frame++) {
+        machine.cpu.run_cycles(DEFAULT_INSTRUCTIONS_PER_FRAME);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    result.ns_per_frame = elapsed.count() / KEY_WAIT_FRAMES;
+    machine.cpu.set_input(InputFrame{0, 1 << 5});
+    machine.cpu.run_cycles(DEFAULT_INSTRUCTIONS_PER_FRAME);
+    Registers registers = machine.cpu.get_registers();
+    bool took_key = registers.v[3] == 5 && registers.v[0xf] == 0xaa && registers.pc == 0x204 && machine.cpu.is_waiting_for_key();
+
+    std::string file_path = (std::filesystem::temp_directory_path() / "chip8bench_key_wait.ch8").string();
+    std::ofstream file(file_path, std::ios::binary);
+    for (uint16_t instruction : program) {
+        file.put(instruction >> 8);
+        file.put(instruction & 0xff);
+    }
+    file.close();
+
+    LockstepEngine lockstep(1);
+    lockstep.load_ROM(file_path);
+    lockstep.set_input(0, InputFrame{0, 1 << 7});
+    lockstep.run_frame(1);
+    lockstep.set_input(0, InputFrame{});
+    lockstep.run_frame(DEFAULT_INSTRUCTIONS_PER_FRAME);
+    bool lane_waited = lockstep.get_registers(0).pc == 0x202 && lockstep.get_registers(0).v[3] == 0;
+    lockstep.set_input(0, InputFrame{0, 1 << 5});
+    lockstep.run_frame(DEFAULT_INSTRUCTIONS_PER_FRAME);
+    bool lane_took_key = lockstep.get_registers(0).v[3] == 5 && lockstep.get_registers(0).pc == 0x204;
+
+    NullDisplay display;
+    NullAudio audio;
+    ReleasingKeypad keypad{std::chrono::milliseconds(KEY_WAIT_MS / 2), std::chrono::milliseconds(KEY_WAIT_MS), 5};
+    auto chip8 = std::make_unique<Chip8>(&display, &audio, &keypad);
+    chip8->set_turbo(true);
+    Rom rom;
+    read_rom(file_path, rom);
+    std::clock_t cpu_start = std::clock();
+    chip8->run(rom);
+    result.cpu_ms = 1000.0 * (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    std::filesystem::remove(file_path);
+    result.frames = chip8->get_frame_count();
+    SaveState state;
+    chip8->save_state(state);
+
+    if (!halted || !took_key) {
+        result.check = "cpu didn't wait";
+    }
+    else if (state.v[3] != 5 || state.v[0xf] != 0xaa) {
+        result.check = "key not taken";
+    }
+    else if (!lane_waited || !lane_took_key) {
+        result.check = "lockstep lane didn't wait";
+    }
+    else {
+        // one frame up to the first FX0A and one taking the key, give or take the frame running as the release arrives
+        result.check = (result.frames <= 4) ? "ok" : "spun";
+    }
+    return result;
+}
+
+// made up play: every half second or so a random set of keys is pressed, then let go of a little later
+InputLog make_input_log(uint32_t seed) {
+    std::mt19937 rng(seed);
+    InputLog log;
+    log.set_seed(seed);
+    uint16_t keys = 0;
+    for (int frame = 0; frame < REPLAY_FRAMES; frame++) {
+        InputFrame input;
+        if (rng() % 30 == 0) {
+            input.keys = (keys == 0) ? rng() & 0xffff : 0;
+        }
+        else {
+            input.keys = keys;
+        }
+        input.released = keys & ~input.keys;
+        keys = input.keys;
+        log.append(input);
+    }
+    return log;
+}
+
+// play the log from the start of the ROM, returning the whole machine at the end
+SaveState replay(const std::string& rom_path, const InputLog& log, bool jit) {
+    NullDisplay display;
+    NullAudio audio;
+    NullKeypad keypad;
+    auto chip8 = std::make_unique<Chip8>(&display, &audio, &keypad);
+    chip8->set_jit(jit);
+    chip8->play_input(&log);
+    chip8->load_ROM(rom_path);
+    while (!chip8->is_playback_finished()) {
+        chip8->run_frame();
+    }
+    SaveState state;
+    chip8->save_state(state);
+    return state;
+}
+
+// a recorded run must replay bit for bit: on another thread, through the JIT and after a round trip through a file
+std::string run_replay(const std::string& rom_path) {
+    InputLog log = make_input_log(0x1234);
+    std::string file_path = (std::filesystem::temp_directory_path() / "chip8bench.input").string();
+    InputLog from_disk;
+    bool disk_ok = log.save(file_path) && from_disk.load(file_path);
+
+    // a frame count far past the end of the file must be turned away rather than allocated (its message isn't wanted)
+    {
+        std::fstream file(file_path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(12);
+        file.write("\xff\xff\xff\x7f", 4);
+    }
+    std::streambuf* cout_buffer = std::cout.rdbuf(nullptr);
+    InputLog corrupt;
+    bool corrupt_rejected = !corrupt.load(file_path);
+    std::cout.rdbuf(cout_buffer);
+    std::filesystem::remove(file_path);
+    if (!disk_ok) {
+        return "disk failed";
+    }
+    if (!corrupt_rejected) {
+        return "corrupt log loaded";
+    }
+
+    SaveState expected = replay(rom_path, log, false);
+    SaveState threaded, jit;
+    std::thread thread([&] { threaded = replay(rom_path, from_disk, false); });
+    jit = replay(rom_path, from_disk, true);
+    thread.join();
+
+    if (std::memcmp(&threaded, &expected, sizeof(expected)) != 0) {
+        return "thread differs";
+    }
+    if (std::memcmp(&jit, &expected, sizeof(expected)) != 0) {
+        return "jit differs";
+    }
+    return "ok";
+}
+
+// the same log played through libchip8's C API (the ROM loaded from a buffer, the keys set as a mask each frame) must end
+// where Chip8 does, read through the views the library hands out. then again after a reset, with the views where they were
+std::string run_library(const std::string& rom_path) {
+    InputLog log = make_input_log(0x1234);
+    SaveState expected = replay(rom_path, log, false);
+    Rom rom;
+    if (!read_rom(rom_path, rom)) {
+        return "unreadable";
+    }
+
+    std::unique_ptr<chip8_t, decltype(&chip8_destroy)> chip8(chip8_create(), chip8_destroy);
+    if (chip8 == nullptr || chip8_get_api_version() != CHIP8_API_VERSION) {
+        return "create failed";
+    }
+    chip8_set_seed(chip8.get(), log.get_seed());
+    if (chip8_load_rom(chip8.get(), rom.data.data(), rom.size) != CHIP8_OK || chip8_load_rom(chip8.get(), rom.data.data(), 0) != CHIP8_ERROR_ROM_EMPTY) {
+        return "load failed";
+    }
+    const uint8_t* memory = chip8_get_memory(chip8.get());
+    const uint64_t* framebuffer = chip8_get_framebuffer(chip8.get());
+
+    for (int run = 0; run < 2; run++) {
+        for (size_t frame = 0; frame < log.size(); frame++) {
+            chip8_set_keys(chip8.get(), log.get_frame(frame).keys);
+            chip8_run_frames(chip8.get(), 1);
+        }
+        chip8_registers_t registers;
+        chip8_get_registers(chip8.get(), &registers);
+        bool same_registers = registers.pc == expected.pc && registers.i == expected.i && std::memcmp(registers.v, expected.v, sizeof(registers.v)) == 0
+                              && registers.delay_timer == expected.delay_timer && registers.sound_timer == expected.sound_timer;
+        if (!same_registers || chip8_get_frame_count(chip8.get()) != expected.frame_count) {
+            return "registers differ";
+        }
+        if (std::memcmp(memory, expected.memory, sizeof(expected.memory)) != 0 || std::memcmp(framebuffer, expected.framebuffer, sizeof(expected.framebuffer)) != 0) {
+            return "screen or memory differs";
+        }
+        if (chip8_get_memory(chip8.get()) != memory || chip8_get_framebuffer(chip8.get()) != framebuffer) {
+            return "views moved";
+        }
+        chip8_set_keys(chip8.get(), 0);
+        chip8_reset(chip8.get());
+    }
+    return "ok";
+}
+
+struct VectorEnvResult {
+    double msteps; // environment steps a second (each of DEFAULT_FRAME_SKIP frames), in millions, on one thread
+    std::string check;
+};
+
+// made up reward and end of episode for the checks, from memory alone: the sum of a couple of bytes near the end of the
+// 4KB CHIP-8 ROMs use (where some keep their variables), and an episode ending every so many frames, a different number
+// for each instance
+float checksum_reward(int instance, const uint8_t* memory, void* /*context*/) {
+    return memory[0xea0 + instance % 16] + memory[0xfff];
+}
+
+struct EpisodeFrames {
+    std::vector<int> frames; // run so far in each instance's episode
+};
+
+bool episode_over(int instance, const uint8_t* /*memory*/, void* context) {
+    std::vector<int>& frames = static_cast<EpisodeFrames*>(context)->frames;
+    return ++frames[instance] % (40 + 7 * instance) == 0;
+}
+
+// steps of the vector environment, on one thread and on two, must match each other and a Machine per instance stepped
+// by hand (episodes restarting from a fresh machine), observations included. then the environment's speed on one thread
+VectorEnvResult run_vector_env(const std::string& rom_path) {
+    VectorEnvResult result;
+    result.check = "ok";
+    Rom rom;
+    if (!read_rom(rom_path, rom)) {
+        result.check = "unreadable";
+        return result;
+    }
+
+    const int instances = VECTOR_ENV_CHECKED_INSTANCES;
+    std::vector<uint32_t> seeds(instances);
+    for (int i = 0; i < instances; i++) {
+        seeds[i] = 7 * i + 1;
+    }
+    std::mt19937 rng(0x25);
+    std::vector<uint16_t> actions(VECTOR_ENV_CHECKED_STEPS * instances);
+    for (uint16_t& action : actions) {
+        action = (rng() % 4 == 0) ? 1 << (rng() % 16) : 0;
+    }
+
+    // both environments, stepped side by side
+    std::array<std::unique_ptr<VectorEnv>, 2> envs = {std::make_unique<VectorEnv>(instances, 1), std::make_unique<VectorEnv>(instances, 2)};
+    std::array<EpisodeFrames, 2> env_frames;
+    std::array<std::vector<uint8_t>, 2> observations;
+    std::array<std::vector<float>, 2> rewards;
+    std::array<std::vector<uint8_t>, 2> dones;
+    for (int e = 0; e < 2; e++) {
+        env_frames[e].frames.assign(instances, 0);
+        observations[e].assign(instances * OBSERVATION_BYTES, 0xff);
+        rewards[e].assign(instances, 0);
+        dones[e].assign(instances, 0);
+        envs[e]->load_ROM(rom);
+        envs[e]->set_reward(checksum_reward);
+        envs[e]->set_done(episode_over, &env_frames[e]);
+        envs[e]->reset(seeds.data(), observations[e].data());
+    }
+
+    // the reference: a machine per instance
+    std::vector<std::unique_ptr<Machine>> machines(instances);
+    std::vector<uint64_t> episodes(instances, 0);
+    std::vector<uint16_t> held(instances, 0);
+    EpisodeFrames machine_frames;
+    machine_frames.frames.assign(instances, 0);
+    auto start_episode = [&](int i) {
+        machines[i] = std::make_unique<Machine>();
+        machines[i]->memory.load_ROM(rom);
+        machines[i]->cpu.set_seed(seeds[i] + static_cast<uint32_t>(episodes[i]));
+        held[i] = 0;
+    };
+    auto same_observation = [&](int i, const uint8_t* observation) {
+        for (unsigned int y = 0; y < OBSERVATION_HEIGHT; y++) {
+            for (unsigned int x = 0; x < OBSERVATION_WIDTH; x++) {
+                if (observation[y * OBSERVATION_WIDTH + x] != machines[i]->framebuffer.get_color(x, y)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    for (int i = 0; i < instances; i++) {
+        start_episode(i);
+    }
+
+    for (int step = 0; step <= VECTOR_ENV_CHECKED_STEPS && result.check == "ok"; step++) {
+        if (step > 0) {
+            const uint16_t* step_actions = &actions[(step - 1) * instances];
+            for (int e = 0; e < 2; e++) {
+                envs[e]->step(step_actions, observations[e].data(), rewards[e].data(), dones[e].data());
+            }
+            for (int i = 0; i < instances; i++) {
+                Machine& machine = *machines[i];
+                InputFrame input{step_actions[i], static_cast<uint16_t>(held[i] & ~step_actions[i])};
+                held[i] = step_actions[i];
+                float reward = 0;
+                bool done = false;
+                for (int frame = 0; frame < DEFAULT_FRAME_SKIP && !done; frame++) {
+                    machine.cpu.set_input(input);
+                    input.released = 0;
+                    machine.cpu.run_cycles(DEFAULT_INSTRUCTIONS_PER_FRAME);
+                    machine.cpu.decrement_timer();
+                    reward += checksum_reward(i, machine.memory.get_contents(), nullptr);
+                    done = episode_over(i, machine.memory.get_contents(), &machine_frames) || machine.cpu.is_stopped();
+                }
+                if (rewards[0][i] != reward || dones[0][i] != done) {
+                    result.check = "step " + std::to_string(step) + " reward differs";
+                }
+                if (done) {
+                    episodes[i]++;
+                    start_episode(i);
+                }
+            }
+        }
+        if (observations[0] != observations[1] || rewards[0] != rewards[1] || dones[0] != dones[1]) {
+            result.check = "step " + std::to_string(step) + " threads differ";
+        }
+        for (int i = 0; i < instances && result.check == "ok"; i++) {
+            bool same = envs[0]->get_registers(i) == machines[i]->cpu.get_registers() && envs[0]->get_episode(i) == episodes[i]
+                        && std::memcmp(envs[0]->get_memory(i), machines[i]->memory.get_contents(), MEMORY_SIZE) == 0;
+            if (!same || !same_observation(i, &observations[0][i * OBSERVATION_BYTES])) {
+                result.check = "step " + std::to_string(step) + " instance " + std::to_string(i) + " differs";
+            }
+        }
+    }
+
+    // timing: every instance a step at a time, with a reward read each frame but episodes only ending with the ROM
+    VectorEnv env(VECTOR_ENV_INSTANCES, 1);
+    env.load_ROM(rom);
+    env.set_reward(checksum_reward);
+    std::vector<uint32_t> timed_seeds(VECTOR_ENV_INSTANCES, 1);
+    std::vector<uint8_t> timed_observations(VECTOR_ENV_INSTANCES * OBSERVATION_BYTES);
+    std::vector<float> timed_rewards(VECTOR_ENV_INSTANCES);
+    std::vector<uint8_t> timed_dones(VECTOR_ENV_INSTANCES);
+    std::vector<uint16_t> timed_actions(VECTOR_ENV_STEPS * VECTOR_ENV_INSTANCES);
+    for (uint16_t& action : timed_actions) {
+        action = (rng() % 4 == 0) ? 1 << (rng() % 16) : 0;
+    }
+    env.reset(timed_seeds.data(), timed_observations.data());
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < VECTOR_ENV_STEPS; step++) {
+        env.step(&timed_actions[step * VECTOR_ENV_INSTANCES], timed_observations.data(), timed_rewards.data(), timed_dones.data());
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.msteps = double(VECTOR_ENV_STEPS) * VECTOR_ENV_INSTANCES / elapsed.count() / 1e6;
+    return result;
+}
+
+struct ToneResult {
+    double frequency; // of the default tone, from its zero crossings
+    double latency_ms; // from the sound timer being set to the first sound, at the worst case buffer boundary
+    double ns_per_sample;
+    std::string check;
+};
+
+// a second of the tone, as the audio callback would ask for it, then silence once the sound timer stops
+ToneResult run_tone() {
+    ToneResult result;
+    ToneGenerator tone;
+    std::vector<int16_t> samples(AUDIO_SAMPLE_RATE);
+
+    // silent until the timer is set; then it must be heard within the next buffer
+    tone.generate(samples.data(), AUDIO_BUFFER_SAMPLES);
+    bool silent_before = std::all_of(samples.begin(), samples.begin() + AUDIO_BUFFER_SAMPLES, [](int16_t sample) { return sample == 0; });
+    tone.set_sound_timer(60);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < AUDIO_SAMPLE_RATE; i += AUDIO_BUFFER_SAMPLES) {
+        tone.generate(samples.data() + i, std::min(AUDIO_BUFFER_SAMPLES, AUDIO_SAMPLE_RATE - i));
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    result.ns_per_sample = elapsed.count() / AUDIO_SAMPLE_RATE;
+    int first = std::find_if(samples.begin(), samples.end(), [](int16_t sample) { return sample != 0; }) - samples.begin();
+    // the timer can be set just after a buffer was asked for, so add a whole buffer
+    result.latency_ms = (first + AUDIO_BUFFER_SAMPLES) * 1000.0 / AUDIO_SAMPLE_RATE;
+
+    int crossings = 0;
+    for (int i = 1; i < AUDIO_SAMPLE_RATE; i++) {
+        crossings += (samples[i - 1] < 0) != (samples[i] < 0);
+    }
+    result.frequency = crossings / 2.0;
+
+    tone.set_sound_timer(0);
+    tone.generate(samples.data(), AUDIO_BUFFER_SAMPLES);
+    tone.generate(samples.data(), AUDIO_BUFFER_SAMPLES);
+    bool silent_after = std::all_of(samples.begin(), samples.begin() + AUDIO_BUFFER_SAMPLES, [](int16_t sample) { return sample == 0; });
+
+    bool in_tune = std::abs(result.frequency - 500) < 5;
+    result.check = (silent_before && silent_after && in_tune && result.latency_ms < 15) ? "ok" : "wrong";
+    return result;
+}
+
+// blit a fixed random sequence of sprites with the scalar or SIMD path, returning millions of sprites / second
+double run_sprites(bool simd, Framebuffer& framebuffer) {
+    std::mt19937 rng(0x6);
+    std::vector<std::array<uint8_t, MAX_SPRITE_HEIGHT + 3>> sprites(1024);
+    for (auto& sprite : sprites) {
+        for (uint8_t& byte : sprite) {
+            byte = rng() & 0xff;
+        }
+    }
+
+    const int count = 4000000;
+    auto start = std::chrono::steady_clock::now();
+    unsigned int collisions = 0;
+    for (int i = 0; i < count; i++) {
+        const auto& sprite = sprites[i & 1023];
+        // the last three bytes pick the position and height
+        unsigned int x = sprite[MAX_SPRITE_HEIGHT] % LORES_WIDTH, y = sprite[MAX_SPRITE_HEIGHT + 1] % LORES_HEIGHT;
+        unsigned int n = sprite[MAX_SPRITE_HEIGHT + 2] % (MAX_SPRITE_HEIGHT + 1);
+        collisions += simd ? framebuffer.draw_sprite_simd(x, y, sprite.data(), n) : framebuffer.draw_sprite_scalar(x, y, sprite.data(), n);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    // fold the collisions into the framebuffer so the loop cannot be optimized away
+    framebuffer.set_pixel(0, 0, collisions & 1);
+    return count / elapsed.count() / 1e6;
+}
+
+// everything measured for one ROM
+struct RomResult {
+    std::string name;
+    std::array<double, ENGINE_COUNT> mips;
+    std::string jit_check;
+    double headless_fps;
+    double load_rom_us;
+    ProfilerResult profiler;
+    TraceResult trace;
+    ThreadedResult threaded;
+    LockstepResult lockstep;
+    SaveStateResult save_state;
+    RewindResult rewind;
+    std::string replay_check;
+    std::string library_check;
+    VectorEnvResult vector_env;
+    IdleResult idle;
+    uint64_t allocations;
+    std::string known; // name in the ROM database, or "-"
+};
+
+void write_engines(JsonWriter& json, const std::array<double, ENGINE_COUNT>& mips) {
+    json.key("mips");
+    json.begin_object();
+    for (int engine = 0; engine < ENGINE_COUNT; engine++) {
+        json.key(ENGINE_NAMES[engine]);
+        json.value(mips[engine]);
+    }
+    json.end_object();
+}
+
+void write_rom(JsonWriter& json, const RomResult& result) {
+    json.begin_object();
+    json.key("rom");
+    json.value(result.name);
+    write_engines(json, result.mips);
+    json.key("jit_check");
+    json.value(result.jit_check);
+    json.key("headless_frames_per_second");
+    json.value(result.headless_fps);
+    json.key("load_rom_us");
+    json.value(result.load_rom_us);
+
+    json.key("profiler");
+    json.begin_object();
+    json.key("overhead");
+    json.value(result.profiler.overhead);
+    json.key("check");
+    json.value(result.profiler.check);
+    json.end_object();
+
+    json.key("trace");
+    json.begin_object();
+    json.key("overhead");
+    json.value(result.trace.overhead);
+    json.key("check");
+    json.value(result.trace.check);
+    json.end_object();
+
+    json.key("threaded");
+    json.begin_object();
+    json.key("frames_per_second");
+    json.value(result.threaded.frames_per_second);
+    json.key("presents");
+    json.value(static_cast<double>(result.threaded.presents));
+    json.key("check");
+    json.value(result.threaded.check);
+    json.end_object();
+
+    json.key("lockstep");
+    json.begin_object();
+    json.key("mips");
+    json.value(result.lockstep.mips);
+    json.key("vector_share");
+    json.value(result.lockstep.vector_share);
+    json.key("check");
+    json.value(result.lockstep.check);
+    json.end_object();
+
+    json.key("save_state");
+    json.begin_object();
+    json.key("save_ns");
+    json.value(result.save_state.save_ns);
+    json.key("restore_ns");
+    json.value(result.save_state.restore_ns);
+    json.key("check");
+    json.value(result.save_state.check);
+    json.end_object();
+
+    json.key("rewind");
+    json.begin_object();
+    json.key("kb_per_minute");
+    json.value(result.rewind.kb_per_minute);
+    json.key("step_back_ns");
+    json.value(result.rewind.step_back_ns);
+    json.key("check");
+    json.value(result.rewind.check);
+    json.end_object();
+
+    json.key("replay_check");
+    json.value(result.replay_check);
+    json.key("library_check");
+    json.value(result.library_check);
+
+    json.key("vector_env");
+    json.begin_object();
+    json.key("msteps");
+    json.value(result.vector_env.msteps);
+    json.key("check");
+    json.value(result.vector_env.check);
+    json.end_object();
+
+    json.key("idle");
+    json.begin_object();
+    json.key("speedup");
+    json.value(result.idle.speedup);
+    json.key("check");
+    json.value(result.idle.check);
+    json.end_object();
+
+    json.key("heap_allocations");
+    json.value(static_cast<int>(result.allocations));
+    json.key("rom_database_name");
+    json.value(result.known);
+    json.end_object();
+}
+
+void print_usage() {
+    std::cout << "Usage: chip8bench [--json <results file>] <ROM or directory of ROMs>..." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string json_path;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        }
+        else {
+            paths.push_back(argv[i]);
+        }
+    }
+    std::vector<std::string> roms = find_roms(paths);
+    if (roms.empty()) {
+        print_usage();
+        exit(-1);
+    }
+    std::vector<RomResult> results(roms.size());
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        results[rom].name = std::filesystem::path(roms[rom]).filename().string();
+    }
+
+    // micro benchmarks: fetch, decode and execute of each opcode family on its own, through the build's dispatch
+    std::vector<double> family_ns;
+    std::cout << std::left << std::setw(24) << "opcode family" << std::right << std::setw(14) << "ns / instr" << std::setw(14) << "MIPS" << std::endl;
+    for (const OpcodeFamily& family : OPCODE_FAMILIES) {
+        family_ns.push_back(run_family(family));
+        std::cout << std::left << std::setw(24) << family.name << std::right << std::fixed << std::setprecision(2) << std::setw(14) << family_ns.back()
+                  << std::setprecision(1) << std::setw(14) << 1000 / family_ns.back() << std::endl;
+    }
+
+    // DXYN through the cpu, by sprite height
+    std::vector<double> sprite_ns;
+    std::cout << std::endl << std::left << std::setw(24) << "DXYN height" << std::right << std::setw(14) << "ns / draw" << std::endl;
+    for (int height : SPRITE_HEIGHTS) {
+        sprite_ns.push_back(run_sprite_height(height));
+        std::cout << std::left << std::setw(24) << height << std::right << std::fixed << std::setprecision(2) << std::setw(14) << sprite_ns.back() << std::endl;
+    }
+
+    // the scalar and SIMD sprite blits must leave identical framebuffers after the same sequence of draws
+    Framebuffer scalar_framebuffer, simd_framebuffer;
+    double scalar_sprites = run_sprites(false, scalar_framebuffer);
+    double simd_sprites = run_sprites(true, simd_framebuffer);
+    bool sprites_match = scalar_framebuffer == simd_framebuffer;
+    std::cout << std::endl << std::left << std::setw(24) << "(DXYN sprite blits)" << std::right << std::setprecision(1) << "scalar " << scalar_sprites
+              << " M/s, simd " << simd_sprites << " M/s, " << (sprites_match ? "ok" : "mismatch") << std::endl;
+
+    // the beeper, synthesized in the audio callback
+    ToneResult tone = run_tone();
+    bool tone_ok = tone.check == "ok";
+    std::cout << std::left << std::setw(24) << "(tone generator)" << std::right << std::setprecision(1) << tone.frequency << " Hz, "
+              << tone.latency_ms << " ms worst latency, " << std::setprecision(2) << tone.ns_per_sample << " ns / sample, " << tone.check << std::endl;
+
+    // a ROM waiting on FX0A for a key
+    KeyWaitResult key_wait = run_key_wait();
+    bool key_wait_ok = key_wait.check == "ok";
+    std::cout << std::left << std::setw(24) << "(FX0A key wait)" << std::right << std::setprecision(2) << key_wait.ns_per_frame << " ns / waiting frame, "
+              << key_wait.frames << " frames and " << std::setprecision(1) << key_wait.cpu_ms << " ms cpu in " << KEY_WAIT_MS << "ms of turbo, "
+              << key_wait.check << std::endl;
+
+    // idle loops skipped to the end of the frame
+    IdleResult idle_loops = run_idle_loops();
+    bool idle_ok = idle_loops.check == "ok";
+    std::cout << std::left << std::setw(24) << "(idle loops)" << std::right << std::setprecision(1) << idle_loops.speedup << "x faster skipped, "
+              << idle_loops.check << std::endl;
+
+    // ROM files which don't fit
+    std::string loader_check = run_rom_loader();
+    bool loader_ok = loader_check == "ok";
+    std::cout << std::left << std::setw(24) << "(ROM loader)" << std::right << loader_check << std::endl;
+
+    // call stack over / underflow
+    std::string stack_check = run_stack();
+    bool stack_ok = stack_check == "ok";
+    std::cout << std::left << std::setw(24) << "(call stack)" << std::right << stack_check << std::endl;
+
+    // the trace file left by a crash
+    std::string trace_crash_check = run_trace_crash(roms[0]);
+    bool trace_crash_ok = trace_crash_check == "ok";
+    std::cout << std::left << std::setw(24) << "(trace on crash)" << std::right << trace_crash_check << std::endl;
+
+    // each quirk profile's behaviour and speed
+    QuirksResult quirks = run_quirks();
+    bool quirks_ok = quirks.check == "ok";
+    std::cout << std::left << std::setw(24) << "(quirk profiles)" << std::right << std::setprecision(1);
+    for (int profile = 0; profile < QUIRK_PROFILE_COUNT; profile++) {
+        std::cout << get_quirk_profile_name(static_cast<QuirkProfile>(profile)) << " " << quirks.mips[profile] << " MIPS, ";
+    }
+    std::cout << quirks.check << std::endl;
+
+    // SUPER-CHIP / XO-CHIP screen operations and instructions
+    HiresResult hires = run_hires();
+    bool hires_ok = hires.check == "ok";
+    std::cout << std::left << std::setw(24) << "(hi-res)" << std::right << std::setprecision(1) << "scrolls " << hires.packed_mops
+              << "M/s packed, " << hires.pixel_mops << "M/s by pixel (" << hires.packed_mops / hires.pixel_mops << "x), " << hires.check << std::endl;
+
+    // macro benchmarks: every dispatch engine on the mixed opcode program and on each ROM, headless frame rate at the
+    // normal clock and ROM load time
+    auto print_engines = [](const std::string& name, const std::array<double, ENGINE_COUNT>& mips) {
+        std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1);
+        for (double m : mips) {
+            std::cout << std::setw(14) << m;
+        }
+    };
+    std::cout << std::endl << std::left << std::setw(24) << "ROM" << std::right;
+    for (const char* name : ENGINE_NAMES) {
+        std::cout << std::setw(14) << std::string(name) + " MIPS";
+    }
+    std::cout << std::setw(12) << "jit check" << std::setw(14) << "headless fps" << std::setw(12) << "load us" << std::setw(12) << "profiler %"
+              << std::setw(16) << "profiler check" << std::setw(12) << "trace %" << std::setw(14) << "trace check" << std::endl;
+
+    std::array<double, ENGINE_COUNT> mixed_mips = {run_mixed(Engine::nested_switch), run_mixed(Engine::table), run_mixed(Engine::threaded),
+                                                   run_mixed(Engine::cached), run_mixed(Engine::jit)};
+    print_engines("(mixed opcodes)", mixed_mips);
+    std::cout << std::endl;
+
+    bool jit_matches = true;
+    bool profiles_match = true;
+    bool traces_match = true;
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        RomResult& result = results[rom];
+        result.mips = {run_rom(roms[rom], Engine::nested_switch), run_rom(roms[rom], Engine::table), run_rom(roms[rom], Engine::threaded),
+                       run_rom(roms[rom], Engine::cached), run_rom(roms[rom], Engine::jit)};
+        int mismatch = compare_jit(roms[rom]);
+        jit_matches = jit_matches && mismatch < 0;
+        result.jit_check = (mismatch < 0) ? "ok" : "frame " + std::to_string(mismatch);
+        result.headless_fps = run_headless(roms[rom]);
+        result.load_rom_us = run_load_rom(roms[rom]);
+        result.profiler = run_profiler(roms[rom]);
+        profiles_match = profiles_match && result.profiler.check == "ok";
+        result.trace = run_trace(roms[rom]);
+        traces_match = traces_match && result.trace.check == "ok";
+
+        print_engines(result.name, result.mips);
+        std::cout << std::setw(12) << result.jit_check << std::setprecision(0) << std::setw(14) << result.headless_fps << std::setprecision(2) << std::setw(12)
+                  << result.load_rom_us << std::setprecision(1) << std::setw(12) << result.profiler.overhead * 100 << std::setw(16)
+                  << result.profiler.check << std::setw(12) << result.trace.overhead * 100 << std::setw(14) << result.trace.check << std::endl;
+    }
+
+    // the core on its own thread, handing frames to the host through a triple buffer
+    long triple_buffer_taken = run_triple_buffer();
+    bool threads_match = triple_buffer_taken >= 0;
+    std::cout << std::endl << std::left << std::setw(24) << "(triple buffer)" << std::right;
+    if (threads_match) {
+        std::cout << triple_buffer_taken << " frames taken in " << TRIPLE_BUFFER_MS << "ms, ok" << std::endl;
+    }
+    else {
+        std::cout << "torn or out of order frame" << std::endl;
+    }
+    std::cout << std::left << std::setw(24) << "ROM" << std::right << std::setw(16) << "threaded fps" << std::setw(12) << "presents"
+              << std::setw(16) << "threaded check" << "   (turbo, " << THREADED_RUN_MS << "ms)" << std::endl;
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        const ThreadedResult& threaded = results[rom].threaded = run_threaded(roms[rom]);
+        threads_match = threads_match && threaded.check == "ok";
+        std::cout << std::left << std::setw(24) << results[rom].name << std::right << std::fixed << std::setprecision(0) << std::setw(16)
+                  << threaded.frames_per_second << std::setw(12) << threaded.presents << std::setw(16) << threaded.check << std::endl;
+    }
+
+    // many instances of each ROM in lockstep, as a structure-of-arrays machine
+    bool lockstep_matches = true;
+    std::cout << std::endl << std::left << std::setw(24) << "ROM" << std::right << std::setw(18) << "lockstep MIPS" << std::setw(12) << "vector %"
+              << std::setw(16) << "lockstep check" << "   (" << LOCKSTEP_LANES << " lanes)" << std::endl;
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        const LockstepResult& lockstep = results[rom].lockstep = run_lockstep(roms[rom]);
+        lockstep_matches = lockstep_matches && lockstep.check == "ok";
+        std::cout << std::left << std::setw(24) << results[rom].name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(18) << lockstep.mips << std::setw(12) << lockstep.vector_share * 100 << std::setw(16) << lockstep.check << std::endl;
+    }
+
+    // save states
+    bool save_states_match = true;
+    std::cout << std::endl << std::left << std::setw(24) << "ROM" << std::right << std::setw(12) << "save ns" << std::setw(12) << "restore ns"
+              << std::setw(18) << "save state check" << std::endl;
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        const SaveStateResult& save_state = results[rom].save_state = run_save_state(roms[rom]);
+        save_states_match = save_states_match && save_state.check == "ok";
+        std::cout << std::left << std::setw(24) << results[rom].name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << save_state.save_ns << std::setw(12) << save_state.restore_ns << std::setw(18) << save_state.check << std::endl;
+    }
+
+    // rewind history
+    bool rewinds_match = true;
+    std::cout << std::endl << std::left << std::setw(24) << "ROM" << std::right << std::setw(14) << "rewind KB/min" << std::setw(14) << "step back ns"
+              << std::setw(14) << "rewind check" << std::endl;
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        const RewindResult& rewind = results[rom].rewind = run_rewind(roms[rom]);
+        rewinds_match = rewinds_match && rewind.check == "ok";
+        std::cout << std::left << std::setw(24) << results[rom].name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << rewind.kb_per_minute << std::setw(14) << rewind.step_back_ns << std::setw(14) << rewind.check << std::endl;
+    }
+
+    // recorded input, replayed by Chip8 and through libchip8
+    bool replays_match = true;
+    bool library_matches = true;
+    std::cout << std::endl << std::left << std::setw(24) << "ROM" << std::right << std::setw(14) << "replay check" << std::setw(26)
+              << "library check" << "   (" << REPLAY_FRAMES << " frames of input)" << std::endl;
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        const std::string& check = results[rom].replay_check = run_replay(roms[rom]);
+        const std::string& library_check = results[rom].library_check = run_library(roms[rom]);
+        replays_match = replays_match && check == "ok";
+        library_matches = library_matches && library_check == "ok";
+        std::cout << std::left << std::setw(24) << results[rom].name << std::right << std::setw(14) << check << std::setw(26) << library_check << std::endl;
+    }
+
+    // many instances stepped as an environment for automated play
+    bool vector_envs_match = true;
+    std::cout << std::endl << std::left << std::setw(24) << "ROM" << std::right << std::setw(16) << "env Msteps/s" << std::setw(26)
+              << "env check" << "   (" << VECTOR_ENV_INSTANCES << " instances, " << DEFAULT_FRAME_SKIP << " frames a step, one thread)" << std::endl;
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        const VectorEnvResult& vector_env = results[rom].vector_env = run_vector_env(roms[rom]);
+        vector_envs_match = vector_envs_match && vector_env.check == "ok";
+        std::cout << std::left << std::setw(24) << results[rom].name << std::right << std::fixed << std::setprecision(2) << std::setw(16)
+                  << vector_env.msteps << std::setw(26) << vector_env.check << std::endl;
+    }
+
+    // fast forward through idle loops
+    // and heap allocations once running
+    std::cout << std::endl << std::left << std::setw(24) << "ROM" << std::right << std::setw(14) << "idle speedup" << std::setw(14) << "idle check"
+              << std::setw(14) << "heap allocs" << "  " << "ROM database" << std::endl;
+    bool allocation_free = true;
+    for (size_t rom = 0; rom < roms.size(); rom++) {
+        const IdleResult& idle = results[rom].idle = run_idle(roms[rom]);
+        idle_ok = idle_ok && idle.check == "ok";
+        results[rom].allocations = run_allocations(roms[rom]);
+        allocation_free = allocation_free && results[rom].allocations == 0;
+        results[rom].known = find_known_rom(roms[rom]);
+        std::cout << std::left << std::setw(24) << results[rom].name << std::right << std::fixed << std::setprecision(1) << std::setw(14)
+                  << idle.speedup << std::setw(14) << idle.check << std::setw(14) << results[rom].allocations << "  " << results[rom].known << std::endl;
+    }
+
+    // a JIT, SIMD path, threaded run, lockstep engine, save state, rewind, replay, libchip8 run, vector environment or idle
+    // loop skip which disagrees with the plain interpreter, a profile or trace which misses instructions, a trace lost in a
+    // crash, a tone which is late or out of tune, a key wait which spins, a quirk profile which misbehaves, a hi-res screen
+    // or SUPER-CHIP / XO-CHIP instruction which disagrees with its reference, a call stack or ROM size which isn't checked
+    // or a heap allocation while a ROM runs, is a failure, whatever its speed
+    bool passed = jit_matches && profiles_match && traces_match && trace_crash_ok && sprites_match && tone_ok && key_wait_ok && idle_ok && quirks_ok && hires_ok && stack_ok && loader_ok
+                  && allocation_free && threads_match && lockstep_matches
+                  && save_states_match && rewinds_match && replays_match && library_matches && vector_envs_match;
+
+    // the same results as JSON, for tracking regressions between builds
+    if (!json_path.empty()) {
+        JsonWriter json;
+        json.begin_object();
+        json.key("dispatch");
+        json.value(CHIP8_DISPATCH_NAME);
+        json.key("passed");
+        json.value(passed);
+
+        json.key("opcodes");
+        json.begin_array();
+        for (size_t family = 0; family < OPCODE_FAMILIES.size(); family++) {
+            json.begin_object();
+            json.key("family");
+            json.value(OPCODE_FAMILIES[family].name);
+            json.key("ns_per_instruction");
+            json.value(family_ns[family]);
+            json.end_object();
+        }
+        json.end_array();
+
+        json.key("sprites");
+        json.begin_array();
+        for (size_t height = 0; height < SPRITE_HEIGHTS.size(); height++) {
+            json.begin_object();
+            json.key("height");
+            json.value(SPRITE_HEIGHTS[height]);
+            json.key("ns_per_draw");
+            json.value(sprite_ns[height]);
+            json.end_object();
+        }
+        json.end_array();
+
+        json.key("triple_buffer_check");
+        json.value(threads_match ? "ok" : "torn or out of order");
+
+        json.key("blits");
+        json.begin_object();
+        json.key("scalar_msprites_per_second");
+        json.value(scalar_sprites);
+        json.key("simd_msprites_per_second");
+        json.value(simd_sprites);
+        json.key("check");
+        json.value(sprites_match ? "ok" : "mismatch");
+        json.end_object();
+
+        json.key("tone");
+        json.begin_object();
+        json.key("frequency");
+        json.value(tone.frequency);
+        json.key("latency_ms");
+        json.value(tone.latency_ms);
+        json.key("ns_per_sample");
+        json.value(tone.ns_per_sample);
+        json.key("check");
+        json.value(tone.check);
+        json.end_object();
+
+        json.key("idle_loops");
+        json.begin_object();
+        json.key("speedup");
+        json.value(idle_loops.speedup);
+        json.key("check");
+        json.value(idle_loops.check);
+        json.end_object();
+
+        json.key("stack_check");
+        json.value(stack_check);
+
+        json.key("loader_check");
+        json.value(loader_check);
+        json.key("trace_crash_check");
+        json.value(trace_crash_check);
+
+        json.key("allocation_check");
+        json.value(allocation_free ? "ok" : "allocated while running");
+
+        json.key("quirks");
+        json.begin_object();
+        for (int profile = 0; profile < QUIRK_PROFILE_COUNT; profile++) {
+            json.key(std::string(get_quirk_profile_name(static_cast<QuirkProfile>(profile))) + "_mips");
+            json.value(quirks.mips[profile]);
+        }
+        json.key("check");
+        json.value(quirks.check);
+        json.end_object();
+
+        json.key("hires");
+        json.begin_object();
+        json.key("scroll_packed_mops");
+        json.value(hires.packed_mops);
+        json.key("scroll_pixel_mops");
+        json.value(hires.pixel_mops);
+        json.key("check");
+        json.value(hires.check);
+        json.end_object();
+
+        json.key("key_wait");
+        json.begin_object();
+        json.key("ns_per_frame");
+        json.value(key_wait.ns_per_frame);
+        json.key("frames");
+        json.value(static_cast<int>(key_wait.frames));
+        json.key("cpu_ms");
+        json.value(key_wait.cpu_ms);
+        json.key("check");
+        json.value(key_wait.check);
+        json.end_object();
+
+        json.key("mixed");
+        json.begin_object();
+        write_engines(json, mixed_mips);
+        json.end_object();
+
+        json.key("roms");
+        json.begin_array();
+        for (const RomResult& result : results) {
+            write_rom(json, result);
+        }
+        json.end_array();
+        json.end_object();
+
+        if (!json.save(json_path)) {
+            return 1;
+        }
+    }
+    return passed ? 0 : 1;
+}
@@ -1,79 +1,385 @@
-#include <SDL_events.h>
-#include <SDL_keyboard.h>
-#include <SDL_timer.h>
 #include <cstdio>
 #include <iomanip>
 #include <iostream>
-#include <SDL2/SDL.h>
 #include <chrono>
 #include <thread>
 
 #include "chip8.h"
-#include "renderer.h"
 #include "cpu.h"
-#include "sound.h"
+#include "rom.h"
 
-void Chip8::run(std::string file_path) {
+Chip8::Chip8(Display* display, Audio* audio, Keypad* keypad) : display_(display), audio_(audio), keypad_(keypad) {}
+
+bool Chip8::load_ROM(const std::string& file_path) {
+    Rom rom;
+    if (!read_rom(file_path, rom)) {
+        return false;
+    }
+    load_ROM(rom);
+    return true;
+}
+
+void Chip8::load_ROM(const Rom& rom) {
+    memory_.load_ROM(rom);
+
+    // history from before the ROM was loaded is of no use
+    if (rewind_) {
+        rewind_->clear();
+        save_state(rewind_state_);
+        rewind_->record(rewind_state_);
+    }
+}
+
+void Chip8::run(const Rom& rom) {
     // load in the ROM provided as a command line argument
-    memory_.load_ROM(file_path);
-    // show the contents of memory in the terminal
-    std::cout << memory_ << std::endl;
-
-    // define clocks so they are valid
-    std::chrono::duration<double> sleep_time(0);
-    std::chrono::duration<double> between_frames(0);
-    const std::chrono::duration<double> cpu_rate(1.0 / 700.0); // corresponds to 1/700 instructions / second
-    const std::chrono::duration<double> frame_rate(1.0 / 60.0); // render only every 60 frames per second
-    auto last_render = std::chrono::high_resolution_clock::now();
-    // main emulation loop
-    // running starts intialized as true
+    load_ROM(rom);
+    if (dump_memory_) {
+        // show the contents of memory in the terminal
+        std::cout << memory_ << std::endl;
+    }
+
+    // the core runs on its own thread, handing finished frames over through frames_ and taking input from the atomics
+    // this thread fills in, so that a slow present or a stalled event queue no longer holds up emulation
+    running_ = true;
+    std::thread emulation(&Chip8::emulation_loop, this);
+
+    // this (the host's main) thread only pumps events, passes the input on and presents frames as they arrive
     while (running_) {
-        // run a single cycle of the CPU (read one 16 byte instruction)
-        cpu_.cycle(); 
-        // time when we finished the last cpu cycle
-        auto cycle_timepoint_1 = std::chrono::high_resolution_clock::now();
-
-
-        // event handling
-        SDL_Event event; 
-        while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-                case SDL_QUIT:
-                    running_ = false;
-                    break;
-                default:
-                    break;
+        {
+            StageTimer timer(profiler_.get(), Stage::events);
+            if (!keypad_->poll_events()) {
+                running_ = false;
+                wake();
+            }
+            read_keypad();
+            if (keypad_->is_rewind_held() != rewind_held_) {
+                rewind_held_ = !rewind_held_;
+                wake();
+            }
+            if (keypad_->take_profile_request()) {
+                profile_requested_ = true;
+                wake();
             }
         }
 
-        // check if the time between when we finished the last render and now has or has not exceeded the render frame rate
-        auto time_before_render = std::chrono::high_resolution_clock::now();
-        between_frames = time_before_render - last_render;
-        if (between_frames > frame_rate) {
-            renderer_.clear_screen(); // fill the screen with black
-            renderer_.render(); // load the updated texture to the blank screen
-            last_render = std::chrono::high_resolution_clock::now(); 
-
-            // decrement sound and delay timer at 60Hz
-            cpu_.decrement_timer();
-            sound_.decrement_timer();
+        if (frames_.update()) {
+            StageTimer timer(profiler_.get(), Stage::render);
+            display_->render(frames_.get_front());
         }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(HOST_POLL_MS));
+        }
+    }
 
+    emulation.join();
+    audio_->set_sound_timer(0);
+    if (profiler_) {
+        report_profile();
+    }
+    if (tracer_) {
+        set_tracing(false);
+    }
+}
 
-        // delay so that game runs at reasonable frame rate
-        auto cycle_timepoint_2 = std::chrono::high_resolution_clock::now();
+void Chip8::emulation_loop() {
+    const std::chrono::nanoseconds frame_time(1000000000 / FRAME_RATE);
+    auto next_frame = std::chrono::steady_clock::now() + frame_time;
 
-        // check the time between the last completion of a cpu cycle and now, if insufficient time has passed for an effective
-        // cpu clock speed of 700 instructions / second, then delay
-        sleep_time = (cpu_rate - (cycle_timepoint_2 - cycle_timepoint_1));
+    // one iteration per 60Hz frame (or as fast as possible in turbo)
+    while (running_) {
+        if (profile_requested_.exchange(false)) {
+            report_profile();
+        }
 
-        // sleep for enough time so that no more than 7000 instructions will be completed every second
-        if (sleep_time > std::chrono::seconds(0)) {
-            std::this_thread::sleep_for(sleep_time);
+        bool rewinding = rewind_ && rewind_held_;
+        if (!rewinding && is_idle()) {
+            // nothing would change until a key is released (or ever, at a jump to itself), so rather than spin through
+            // empty frames wait for one. the skipped frames aren't emulated at all, so recordings (and the frame count)
+            // are as if they never were
+            {
+                StageTimer timer(profiler_.get(), Stage::sleep);
+                park();
+            }
+            continue;
+        }
+        if (rewinding) {
+            // play the history backwards at the normal frame rate, then carry on from wherever it was let go
+            rewind_frame();
+            audio_->set_sound_timer(0);
         }
+        else {
+            emulate_frame();
+        }
+        frames_.get_back() = framebuffer_;
+        frames_.publish();
+
+        if (turbo_ && !rewinding) {
+            // uncapped: emulated frames run back to back, and the host shows whichever is newest when it gets round to it
+            continue;
+        }
+
+        // sleep once for the rest of the frame, rather than after every instruction
+        {
+            StageTimer timer(profiler_.get(), Stage::sleep);
+            std::this_thread::sleep_until(next_frame);
+        }
+        next_frame += frame_time;
+
+        // if emulation fell more than a few frames behind (or is coming back from turbo, where next_frame isn't kept up
+        // to date) don't try to catch up
+        auto now = std::chrono::steady_clock::now();
+        if (now - next_frame > 4 * frame_time) {
+            next_frame = now + frame_time;
+        }
+    }
+}
+
+void Chip8::read_keypad() {
+    host_keys_.store(keypad_->get_keys(), std::memory_order_relaxed);
+
+    // releases are kept until the emulation thread takes them, so that none are lost between its frames
+    uint16_t released = keypad_->take_released_keys();
+    if (released != 0) {
+        host_released_.fetch_or(released, std::memory_order_relaxed);
+        wake();
+    }
+}
+
+bool Chip8::is_idle() const {
+    // timers still counting down, a release not yet taken (or input still to play back) mean frames still have work in them
+    Registers registers = cpu_.get_registers();
+    return (cpu_.is_waiting_for_key() || cpu_.is_stopped()) && registers.delay_timer == 0 && registers.sound_timer == 0 && !playback_
+           && host_released_.load(std::memory_order_relaxed) == 0;
+}
+
+void Chip8::park() {
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    park_.wait(lock, [this] {
+        return !running_ || host_released_.load(std::memory_order_relaxed) != 0 || (rewind_ && rewind_held_) || profile_requested_;
+    });
+}
+
+void Chip8::wake() {
+    // taking the lock orders this against the emulation thread's check of the condition, so the notify can't be lost
+    { std::lock_guard<std::mutex> lock(park_mutex_); }
+    park_.notify_one();
+}
+
+void Chip8::run_frame() {
+    read_keypad();
+    emulate_frame();
+    render();
+}
+
+void Chip8::render() {
+    StageTimer timer(profiler_.get(), Stage::render);
+    display_->render(framebuffer_);
+}
+
+void Chip8::emulate_frame() {
+    StageTimer timer(profiler_.get(), Stage::cpu);
+
+    // latch the keypad for the whole frame
+    InputFrame input = sample_input();
+    if (recording_) {
+        // frames which were rewound over are replaced
+        recording_->truncate(frame_count_ - input_start_frame_);
+        recording_->append(input);
+    }
+    cpu_.set_input(input);
+    if (tracer_) {
+        tracer_->set_frame(frame_count_);
     }
 
-    // quit sdl - close the renderer and window 
-    sound_.quit();
-    renderer_.quit();
-}
\ No newline at end of file
+    // run the frame's instructions as one batch
+    cpu_.run_cycles(instructions_per_frame_);
+    cycle_count_ += instructions_per_frame_;
+    if (cpu_.get_stack_fault() != StackFault::none && !stack_fault_reported_) [[unlikely]] {
+        report_stack_fault();
+    }
+
+    // every instructions_per_frame_ cycles, decrement sound and delay timer at 60Hz
+    cpu_.decrement_timer();
+    frame_count_++;
+    if (profiler_) {
+        profiler_->count_frame();
+    }
+
+    if (rewind_) {
+        save_state(rewind_state_);
+        rewind_->record(rewind_state_);
+    }
+}
+
+void Chip8::report_stack_fault() {
+    const char* fault = (cpu_.get_stack_fault() == StackFault::overflow) ? "overflow" : "underflow";
+    std::cout << "Error: call stack " << fault << " at 0x" << std::hex << cpu_.get_registers().pc << std::dec
+              << ", the ROM has stopped" << std::endl;
+    stack_fault_reported_ = true;
+}
+
+InputFrame Chip8::sample_input() {
+    InputFrame input;
+    if (playback_) {
+        // once the log runs out, carry on with nothing pressed
+        uint64_t frame = frame_count_ - input_start_frame_;
+        if (frame < playback_->size()) {
+            input = playback_->get_frame(frame);
+        }
+        return input;
+    }
+
+    input.keys = host_keys_.load(std::memory_order_relaxed);
+    input.released = host_released_.exchange(0, std::memory_order_relaxed);
+    return input;
+}
+
+void Chip8::set_instructions_per_frame(int instructions_per_frame) {
+    instructions_per_frame_ = instructions_per_frame;
+}
+
+void Chip8::set_turbo(bool turbo) {
+    turbo_ = turbo;
+}
+
+void Chip8::set_jit(bool jit) {
+    cpu_.set_jit_enabled(jit);
+}
+
+void Chip8::set_quirks(QuirkProfile profile) {
+    cpu_.set_quirks(profile);
+}
+
+uint64_t Chip8::get_cycle_count() const {
+    return cycle_count_;
+}
+
+uint64_t Chip8::get_frame_count() const {
+    return frame_count_;
+}
+
+const Framebuffer& Chip8::get_framebuffer() const {
+    return framebuffer_;
+}
+
+void Chip8::save_state(SaveState& state) const {
+    cpu_.save_state(state);
+    state.cycle_count = cycle_count_;
+    state.frame_count = frame_count_;
+}
+
+void Chip8::load_state(const SaveState& state) {
+    cpu_.load_state(state);
+    stack_fault_reported_ = false;
+    cycle_count_ = state.cycle_count;
+    frame_count_ = state.frame_count;
+}
+
+bool Chip8::save_state(const std::string& file_path) const {
+    SaveState state;
+    save_state(state);
+    return write_save_state(state, file_path);
+}
+
+bool Chip8::load_state(const std::string& file_path) {
+    SaveState state;
+    if (!read_save_state(state, file_path)) {
+        return false;
+    }
+    load_state(state);
+    return true;
+}
+
+void Chip8::set_rewind(bool enabled, size_t capacity_bytes) {
+    if (!enabled) {
+        rewind_.reset();
+        return;
+    }
+    rewind_ = std::make_unique<Rewind>(capacity_bytes);
+    // start the history from the current state
+    save_state(rewind_state_);
+    rewind_->record(rewind_state_);
+}
+
+bool Chip8::rewind_frame() {
+    if (!rewind_ || !rewind_->step_back(rewind_state_)) {
+        return false;
+    }
+    load_state(rewind_state_);
+    return true;
+}
+
+const Rewind* Chip8::get_rewind() const {
+    return rewind_.get();
+}
+
+void Chip8::set_seed(uint32_t seed) {
+    cpu_.set_seed(seed);
+}
+
+void Chip8::record_input(InputLog* log) {
+    recording_ = log;
+    input_start_frame_ = frame_count_;
+}
+
+void Chip8::play_input(const InputLog* log) {
+    playback_ = log;
+    input_start_frame_ = frame_count_;
+    if (log) {
+        cpu_.set_seed(log->get_seed());
+    }
+}
+
+bool Chip8::is_playback_finished() const {
+    return playback_ && frame_count_ - input_start_frame_ >= playback_->size();
+}
+
+void Chip8::set_profiling(bool enabled, const std::string& json_path) {
+    if (!enabled) {
+        cpu_.set_profiler(nullptr);
+        profiler_.reset();
+        return;
+    }
+    profiler_ = std::make_unique<Profiler>();
+    profile_path_ = json_path;
+    cpu_.set_profiler(profiler_.get());
+}
+
+Profiler* Chip8::get_profiler() {
+    return profiler_.get();
+}
+
+bool Chip8::set_tracing(bool enabled, const std::string& file_path) {
+    if (!enabled) {
+        cpu_.set_tracer(nullptr);
+        if (tracer_) {
+            tracer_->close();
+            std::cout << "Trace saved to " << trace_path_ << " (" << tracer_->get_written() << " instructions, " << tracer_->get_dropped() << " dropped)" << std::endl;
+            tracer_.reset();
+        }
+        return true;
+    }
+    set_tracing(false);
+    auto tracer = std::make_unique<Tracer>();
+    if (!tracer->open(file_path)) {
+        return false;
+    }
+    tracer_ = std::move(tracer);
+    trace_path_ = file_path;
+    cpu_.set_tracer(tracer_.get());
+    return true;
+}
+
+void Chip8::set_dump_memory(bool dump_memory) {
+    dump_memory_ = dump_memory;
+}
+
+void Chip8::report_profile() const {
+    if (!profiler_) {
+        return;
+    }
+    profiler_->write_report(std::cout);
+    if (profiler_->save_json(profile_path_)) {
+        std::cout << "Profile saved to " << profile_path_ << std::endl;
+    }
+}
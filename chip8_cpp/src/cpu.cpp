@@ -1,353 +1,1465 @@
-#include <SDL_events.h>
-#include <SDL_keyboard.h>
-#include <SDL_scancode.h>
+#include <algorithm>
 #include <climits>
 #include <cpu.h>
 #include <cstdint>
 #include <cstdlib>
-#include <stack>
-#include <SDL2/SDL.h>
+#include <cstring>
+#include <iostream>
     
 #include <memory.h>
-#include <renderer.h>
+#include <framebuffer.h>
+#include <profiler.h>
+#include <trace.h>
 
-CPU::CPU(Memory* chip8_memory, Renderer* chip8_renderer, Sound* chip8_sound) {
+CPU::CPU(Memory* chip8_memory, Framebuffer* chip8_framebuffer, Audio* chip8_audio) {
     pc_ = 0x200; // start the program counter at the beginning of the loaded ROM
     i_register_ = 0x0;
 
     CPU::memory_ = chip8_memory;
-    CPU::renderer_ = chip8_renderer;
-    CPU::sound_ = chip8_sound;
+    CPU::framebuffer_ = chip8_framebuffer;
+    CPU::audio_ = chip8_audio;
+
+    decode_cache_.resize(MEMORY_SIZE);
+    audio_pattern_.fill(DEFAULT_AUDIO_PATTERN_BYTE);
+
+    // hear about writes to memory, so that stale decoded instructions are dropped
+    memory_->set_watcher(this);
 }
 
 void CPU::decrement_timer() {
     if (delay_timer_ != 0) {
         delay_timer_--;
     }
+
+    // beep for as long as the sound timer is running
+    audio_->set_sound_timer(sound_timer_);
+    if (sound_timer_ != 0) {
+        sound_timer_--;
+    }
+}
+
+namespace {
+    // indices into handlers_, in the same order
+    enum HandlerIndex : uint8_t {
+        OP_NOP, OP_00E0, OP_00EE, OP_1NNN, OP_2NNN, OP_3XNN, OP_4XNN, OP_5XY0, OP_6XNN, OP_7XNN, OP_8XY0, OP_8XY1,
+        OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5, OP_8XY6, OP_8XY7, OP_8XYE, OP_9XY0, OP_ANNN, OP_BNNN, OP_CXNN, OP_DXYN,
+        OP_EX9E, OP_EXA1, OP_FX07, OP_FX0A, OP_FX15, OP_FX18, OP_FX1E, OP_FX29, OP_FX33, OP_FX55, OP_FX65,
+        // SUPER-CHIP
+        OP_00CN, OP_00FB, OP_00FC, OP_00FD, OP_00FE, OP_00FF, OP_FX30, OP_FX75, OP_FX85,
+        // XO-CHIP
+        OP_00DN, OP_5XY2, OP_5XY3, OP_F000, OP_FN01, OP_F002, OP_FX3A,
+    };
 }
 
 void CPU::cycle() {
+    with_quirks(quirks_, [this](auto quirks) { step<decltype(quirks)>(); });
+}
+
+template <class Quirks>
+void CPU::step() {
+#if defined(CHIP8_DISPATCH_SWITCH)
+    cycle_switch<Quirks>();
+#elif defined(CHIP8_DISPATCH_TABLE)
+    cycle_table<Quirks>();
+#else
+    cycle_cached<Quirks>();
+#endif
+}
+
+template <class Quirks>
+void CPU::cycle_cached() {
+    // look the instruction up in the decode cache, only decoding it the first time it is run from this address
+    Instruction& instruction = decode_cache_[pc_ & (MEMORY_SIZE - 1)];
+    if (instruction.handler == HANDLER_COUNT) [[unlikely]] {
+        instruction = decode(fetch());
+    }
+    else {
+        pc_ += 2;
+    }
+
+    // an instruction overwriting itself (FX33, FX55) only clears the cached handler, so its operands stay valid here
+    (this->*handlers_<Quirks>[instruction.handler])(instruction);
+}
+
+template <class Quirks>
+void CPU::cycle_table() {
+    // a single indexed load instead of the chain of switch branches, then one jump on the handler's index. the handlers
+    // are inlined into the switch, where a call through handlers_ would stop them being
+    const Instruction& instruction = decoded_opcodes_[fetch()];
+    switch (instruction.handler) {
+        case OP_NOP: op_nop(instruction); break;
+        case OP_00E0: op_00e0(instruction); break;
+        case OP_00EE: op_00ee(instruction); break;
+        case OP_1NNN: op_1nnn(instruction); break;
+        case OP_2NNN: op_2nnn(instruction); break;
+        case OP_3XNN: op_3xnn<Quirks>(instruction); break;
+        case OP_4XNN: op_4xnn<Quirks>(instruction); break;
+        case OP_5XY0: op_5xy0<Quirks>(instruction); break;
+        case OP_6XNN: op_6xnn(instruction); break;
+        case OP_7XNN: op_7xnn(instruction); break;
+        case OP_8XY0: op_8xy0(instruction); break;
+        case OP_8XY1: op_8xy1(instruction); break;
+        case OP_8XY2: op_8xy2(instruction); break;
+        case OP_8XY3: op_8xy3(instruction); break;
+        case OP_8XY4: op_8xy4(instruction); break;
+        case OP_8XY5: op_8xy5(instruction); break;
+        case OP_8XY6: op_8xy6<Quirks>(instruction); break;
+        case OP_8XY7: op_8xy7(instruction); break;
+        case OP_8XYE: op_8xye<Quirks>(instruction); break;
+        case OP_9XY0: op_9xy0<Quirks>(instruction); break;
+        case OP_ANNN: op_annn(instruction); break;
+        case OP_BNNN: op_bnnn<Quirks>(instruction); break;
+        case OP_CXNN: op_cxnn(instruction); break;
+        case OP_DXYN: op_dxyn<Quirks>(instruction); break;
+        case OP_EX9E: op_ex9e<Quirks>(instruction); break;
+        case OP_EXA1: op_exa1<Quirks>(instruction); break;
+        case OP_FX07: op_fx07(instruction); break;
+        case OP_FX0A: op_fx0a(instruction); break;
+        case OP_FX15: op_fx15(instruction); break;
+        case OP_FX18: op_fx18(instruction); break;
+        case OP_FX1E: op_fx1e(instruction); break;
+        case OP_FX29: op_fx29(instruction); break;
+        case OP_FX33: op_fx33(instruction); break;
+        case OP_FX55: op_fx55<Quirks>(instruction); break;
+        case OP_FX65: op_fx65<Quirks>(instruction); break;
+        case OP_00CN: op_00cn(instruction); break;
+        case OP_00FB: op_00fb(instruction); break;
+        case OP_00FC: op_00fc(instruction); break;
+        case OP_00FD: op_00fd(instruction); break;
+        case OP_00FE: op_00fe(instruction); break;
+        case OP_00FF: op_00ff(instruction); break;
+        case OP_FX30: op_fx30(instruction); break;
+        case OP_FX75: op_fx75(instruction); break;
+        case OP_FX85: op_fx85(instruction); break;
+        case OP_00DN: op_00dn(instruction); break;
+        case OP_5XY2: op_5xy2(instruction); break;
+        case OP_5XY3: op_5xy3(instruction); break;
+        case OP_F000: op_f000(instruction); break;
+        case OP_FN01: op_fn01(instruction); break;
+        case OP_F002: op_f002(instruction); break;
+        case OP_FX3A: op_fx3a(instruction); break;
+    }
+}
+
+void CPU::run_cycles_threaded(int cycles) {
+    with_quirks(quirks_, [&](auto quirks) { run_threaded<ThreadedMode::fast_forward, decltype(quirks)>(cycles); });
+}
+
+template <CPU::ThreadedMode mode, class Quirks>
+void CPU::run_threaded(int cycles) {
+#if defined(__GNUC__)
+    // one label per handler, in the same order as handlers_
+    static const void* const labels[] = {
+        &&l_op_nop,
+        &&l_op_00e0,
+        &&l_op_00ee,
+        &&l_op_1nnn,
+        &&l_op_2nnn,
+        &&l_op_3xnn,
+        &&l_op_4xnn,
+        &&l_op_5xy0,
+        &&l_op_6xnn,
+        &&l_op_7xnn,
+        &&l_op_8xy0,
+        &&l_op_8xy1,
+        &&l_op_8xy2,
+        &&l_op_8xy3,
+        &&l_op_8xy4,
+        &&l_op_8xy5,
+        &&l_op_8xy6,
+        &&l_op_8xy7,
+        &&l_op_8xye,
+        &&l_op_9xy0,
+        &&l_op_annn,
+        &&l_op_bnnn,
+        &&l_op_cxnn,
+        &&l_op_dxyn,
+        &&l_op_ex9e,
+        &&l_op_exa1,
+        &&l_op_fx07,
+        &&l_op_fx0a,
+        &&l_op_fx15,
+        &&l_op_fx18,
+        &&l_op_fx1e,
+        &&l_op_fx29,
+        &&l_op_fx33,
+        &&l_op_fx55,
+        &&l_op_fx65,
+        &&l_op_00cn,
+        &&l_op_00fb,
+        &&l_op_00fc,
+        &&l_op_00fd,
+        &&l_op_00fe,
+        &&l_op_00ff,
+        &&l_op_fx30,
+        &&l_op_fx75,
+        &&l_op_fx85,
+        &&l_op_00dn,
+        &&l_op_5xy2,
+        &&l_op_5xy3,
+        &&l_op_f000,
+        &&l_op_fn01,
+        &&l_op_f002,
+        &&l_op_fx3a,
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == HANDLER_COUNT);
+
+    uint16_t opcode;
+    // sampled: cycles only counts down the stretch of the batch up to the next sample (or its end), so that the
+    // profiler is only called at the end of each
+    if constexpr (mode == ThreadedMode::sampled) {
+        stretch_ = 0;
+        after_stretch_ = cycles;
+        cycles = 0;
+    }
+
+    // fetch the next instruction and jump straight to its handler through the opcode table. every handler ends in its
+    // own copy of this jump, so the host branch predictor learns which handler tends to follow which
+#define DISPATCH() \
+    if (cycles-- <= 0) [[unlikely]] { \
+        if constexpr (mode != ThreadedMode::sampled) { \
+            return; \
+        } \
+        else if ((cycles = next_stretch()) < 0) { \
+            return; \
+        } \
+    } \
+    opcode = fetch(); \
+    if constexpr (mode == ThreadedMode::instrumented) { \
+        instrument(pc_ - 2, opcode); \
+    } \
+    goto *labels[opcode_table_[opcode]]
+
+    DISPATCH();
+l_op_nop:
+    op_nop(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_00e0:
+    op_00e0(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_00ee:
+    op_00ee(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_1nnn:
+    {
+        uint16_t jump_address = pc_ - 2;
+        op_1nnn(decoded_opcodes_[opcode]);
+        // the profiler and tracer see every pass round an idle loop, so that they show the ROM as written
+        if constexpr (mode == ThreadedMode::fast_forward) {
+            if (skip_idle_loop<Quirks>(jump_address, cycles)) {
+                return;
+            }
+        }
+    }
+    DISPATCH();
+l_op_2nnn:
+    op_2nnn(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_3xnn:
+    op_3xnn<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_4xnn:
+    op_4xnn<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_5xy0:
+    op_5xy0<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_6xnn:
+    op_6xnn(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_7xnn:
+    op_7xnn(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_8xy0:
+    op_8xy0(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_8xy1:
+    op_8xy1(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_8xy2:
+    op_8xy2(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_8xy3:
+    op_8xy3(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_8xy4:
+    op_8xy4(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_8xy5:
+    op_8xy5(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_8xy6:
+    op_8xy6<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_8xy7:
+    op_8xy7(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_8xye:
+    op_8xye<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_9xy0:
+    op_9xy0<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_annn:
+    op_annn(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_bnnn:
+    op_bnnn<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_cxnn:
+    op_cxnn(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_dxyn:
+    op_dxyn<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_ex9e:
+    op_ex9e<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_exa1:
+    op_exa1<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx07:
+    op_fx07(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx0a:
+    op_fx0a(decoded_opcodes_[opcode]);
+    if (waiting_for_key_) {
+        if constexpr (mode == ThreadedMode::sampled) {
+            profiler_->count_run(stretch_ - cycles);
+            until_sample_ -= stretch_ - cycles;
+        }
+        return;
+    }
+    DISPATCH();
+l_op_fx15:
+    op_fx15(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx18:
+    op_fx18(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx1e:
+    op_fx1e(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx29:
+    op_fx29(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx33:
+    op_fx33(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx55:
+    op_fx55<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx65:
+    op_fx65<Quirks>(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_00cn:
+    op_00cn(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_00fb:
+    op_00fb(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_00fc:
+    op_00fc(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_00fd:
+    {
+        uint16_t exit_address = pc_ - 2;
+        op_00fd(decoded_opcodes_[opcode]);
+        if constexpr (mode == ThreadedMode::fast_forward) {
+            if (skip_idle_loop<Quirks>(exit_address, cycles)) {
+                return;
+            }
+        }
+    }
+    DISPATCH();
+l_op_00fe:
+    op_00fe(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_00ff:
+    op_00ff(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx30:
+    op_fx30(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx75:
+    op_fx75(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx85:
+    op_fx85(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_00dn:
+    op_00dn(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_5xy2:
+    op_5xy2(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_5xy3:
+    op_5xy3(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_f000:
+    op_f000(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fn01:
+    op_fn01(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_f002:
+    op_f002(decoded_opcodes_[opcode]);
+    DISPATCH();
+l_op_fx3a:
+    op_fx3a(decoded_opcodes_[opcode]);
+    DISPATCH();
+
+#undef DISPATCH
+#else
+    for (int i = 0; i < cycles; i++) {
+        if constexpr (mode == ThreadedMode::instrumented) {
+            uint16_t pc = pc_ & (MEMORY_SIZE - 1);
+            instrument(pc, (memory_->get_from_memory(pc) << 8) | memory_->get_from_memory((pc + 1) & (MEMORY_SIZE - 1)));
+        }
+        cycle_table<Quirks>();
+    }
+#endif
+}
+
+template <class Quirks>
+void CPU::cycle_switch() {
     // first get the instruction
     uint16_t instruction = fetch();
     // using the fetched instruction, run the proper function from linked hardware
-    decode_execute(instruction);
+    decode_execute<Quirks>(instruction);
+}
+
+void CPU::run_cycles(int cycles) {
+    // halted by FX0A: the cycles pass without anything to execute
+    if (waiting_for_key_) {
+        return;
+    }
+    // the quirks are picked here, once per batch, and are constants from then on
+    with_quirks(quirks_, [&](auto quirks) { run_batch<decltype(quirks)>(cycles); });
+}
+
+template <class Quirks>
+void CPU::run_batch(int cycles) {
+    if (tracer_ != nullptr) {
+        run_cycles_instrumented<Quirks>(cycles);
+        return;
+    }
+    if (profiler_ != nullptr) {
+        run_cycles_sampled<Quirks>(cycles);
+        return;
+    }
+    if (jit_enabled_) {
+        run_cycles_jit<Quirks>(cycles);
+        return;
+    }
+
+#if defined(CHIP8_DISPATCH_TABLE)
+    run_threaded<ThreadedMode::fast_forward, Quirks>(cycles);
+#else
+    while (cycles > 0 && !waiting_for_key_) {
+        uint16_t address = pc_;
+        step<Quirks>();
+        cycles--;
+        skip_idle_loop<Quirks>(address, cycles);
+    }
+#endif
+}
+
+template <class Quirks>
+void CPU::run_cycles_instrumented(int cycles) {
+    // always interpreted, as compiled blocks can't be counted or traced instruction by instruction
+#if defined(CHIP8_DISPATCH_TABLE)
+    run_threaded<ThreadedMode::instrumented, Quirks>(cycles);
+#else
+    for (int i = 0; i < cycles && !waiting_for_key_; i++) {
+        uint16_t pc = pc_ & (MEMORY_SIZE - 1);
+        uint16_t opcode = (memory_->get_from_memory(pc) << 8) | memory_->get_from_memory((pc + 1) & (MEMORY_SIZE - 1));
+        instrument(pc, opcode);
+        step<Quirks>();
+    }
+#endif
+}
+
+template <class Quirks>
+void CPU::run_cycles_sampled(int cycles) {
+    // interpreted as well, but only one instruction in so many goes to the profiler, as a sample standing for the stretch
+    // of instructions up to the next one. the stretches run at the interpreter's full speed, round idle loops as
+    // written, and are counted as a whole once they end
+#if defined(CHIP8_DISPATCH_TABLE)
+    run_threaded<ThreadedMode::sampled, Quirks>(cycles);
+#else
+    while (cycles > 0 && !waiting_for_key_) {
+        if (until_sample_ == 0) {
+            sample();
+        }
+        int stretch = std::min(cycles, until_sample_);
+        int ran = 0;
+        for (; ran < stretch && !waiting_for_key_; ran++) {
+            step<Quirks>();
+        }
+        profiler_->count_run(ran);
+        cycles -= ran;
+        until_sample_ -= ran;
+    }
+#endif
+}
+
+void CPU::sample() {
+    uint16_t pc = pc_ & (MEMORY_SIZE - 1);
+    uint16_t opcode = (memory_->get_from_memory(pc) << 8) | memory_->get_from_memory((pc + 1) & (MEMORY_SIZE - 1));
+    profiler_->sample(pc, opcode_table_[opcode]);
+    until_sample_ = profiler_->next_interval();
+}
+
+// out of line, so that it adds no more than a call to each handler's copy of DISPATCH
+[[gnu::noinline]] int CPU::next_stretch() {
+    profiler_->count_run(stretch_);
+    until_sample_ -= stretch_;
+    if (after_stretch_ == 0) {
+        return -1;
+    }
+    if (until_sample_ == 0) {
+        sample();
+    }
+    stretch_ = std::min(after_stretch_, until_sample_);
+    after_stretch_ -= stretch_;
+    // less the instruction about to run, which DISPATCH has already counted down
+    return stretch_ - 1;
+}
+
+template <class Quirks>
+void CPU::run_cycles_jit(int cycles) {
+#ifdef CHIP8_JIT
+    int remaining = cycles;
+    while (remaining > 0 && !waiting_for_key_) {
+        // run a compiled block if there is one here and it fits in the batch, otherwise interpret one instruction
+        const Block& block = jit_.get_block(memory_, pc_);
+        if (block.code != nullptr && block.length <= remaining) {
+            uint16_t last_address = pc_ + 2 * (block.length - 1);
+            pc_ = block.code(var_registers_.data(), &i_register_);
+            remaining -= block.length;
+            skip_idle_loop<Quirks>(last_address, remaining);
+            continue;
+        }
+        uint16_t address = pc_;
+        step<Quirks>();
+        remaining--;
+        skip_idle_loop<Quirks>(address, remaining);
+    }
+#endif
+}
+
+void CPU::set_fast_forward(bool enabled) {
+    fast_forward_ = enabled;
+}
+
+void CPU::set_quirks(QuirkProfile profile) {
+    quirks_ = profile;
+#ifdef CHIP8_JIT
+    // the JIT compiles 8XY6 / 8XYE and the skips, so blocks built for another profile are dropped
+    jit_.set_quirks(profile);
+#endif
+}
+
+QuirkProfile CPU::get_quirks() const {
+    return quirks_;
+}
+
+bool CPU::is_stopped() const {
+    return stack_fault_ != StackFault::none || idle_loop_length(pc_) == 1;
+}
+
+int CPU::idle_loop_length(uint16_t jump_address) const {
+    auto instruction_at = [this](uint16_t address) {
+        return (memory_->get_from_memory(address & (MEMORY_SIZE - 1)) << 8) | memory_->get_from_memory((address + 1) & (MEMORY_SIZE - 1));
+    };
+    uint16_t jump = instruction_at(jump_address);
+    if (jump == 0x00fd) {
+        return 1; // SUPER-CHIP's exit, which runs itself over and over
+    }
+    if ((jump & 0xf000) != 0x1000) {
+        return 0;
+    }
+    uint16_t target = jump & 0x0fff;
+    if (target == jump_address) {
+        return 1;
+    }
+    if (target + 4 != jump_address) {
+        return 0;
+    }
+
+    // FX07 / 3XNN or 4XNN on the same VX: idle only if VX already holds the delay timer (so that another pass changes
+    // nothing, which isn't so just after the timer ticks) and the skip which would leave the loop won't be taken
+    uint16_t read = instruction_at(target);
+    uint16_t test = instruction_at(target + 2);
+    if ((read & 0xf0ff) != 0xf007 || (test & 0x0f00) != (read & 0x0f00) || var_registers_[(read >> 8) & 0xf] != delay_timer_) {
+        return 0;
+    }
+    bool equal = delay_timer_ == (test & 0x00ff);
+    if (((test & 0xf000) == 0x3000 && !equal) || ((test & 0xf000) == 0x4000 && equal)) {
+        return 3;
+    }
+    return 0;
+}
+
+template <class Quirks>
+bool CPU::skip_idle_loop(uint16_t jump_address, int& cycles) {
+    // cheap test first, as this runs after every interpreted instruction: pc_ must have gone back to or just before the jump
+    if (!fast_forward_ || cycles <= 0 || (pc_ != jump_address && pc_ + 4 != jump_address)) {
+        return false;
+    }
+    int length = idle_loop_length(jump_address);
+    if (length == 0) {
+        return false;
+    }
+    // every pass round the loop is the same until the timers tick, so only where in the loop the batch ends matters
+    for (int i = cycles % length; i > 0; i--) {
+        step<Quirks>();
+    }
+    cycles = 0;
+    return true;
+}
+
+void CPU::set_profiler(Profiler* profiler) {
+    profiler_ = profiler;
+    until_sample_ = 0;
+}
+
+void CPU::set_tracer(Tracer* tracer) {
+    tracer_ = tracer;
+}
+
+int CPU::get_handler(uint16_t opcode) {
+    return opcode_table_[opcode];
+}
+
+void CPU::instrument(uint16_t pc, uint16_t opcode) {
+    // while tracing, every instruction is a sample
+    if (profiler_ != nullptr) {
+        profiler_->sample(pc, opcode_table_[opcode]);
+        profiler_->count_run(1);
+    }
+    if (tracer_ != nullptr) {
+        tracer_->record(pc, opcode, i_register_, var_registers_, delay_timer_, sound_timer_);
+    }
+}
+
+const char* CPU::get_handler_name(int handler) {
+    return handler_names_[handler];
+}
+
+void CPU::set_jit_enabled(bool enabled) {
+#ifdef CHIP8_JIT
+    if (enabled && !jit_.initialize()) {
+        std::cout << "Warning: could not allocate executable memory for the JIT, using the interpreter" << std::endl;
+        return;
+    }
+    jit_enabled_ = enabled;
+#else
+    if (enabled) {
+        std::cout << "Warning: built without the JIT (CHIP8_JIT), using the interpreter" << std::endl;
+    }
+#endif
+}
+
+Registers CPU::get_registers() const {
+    return Registers{pc_, i_register_, var_registers_, delay_timer_, sound_timer_};
+}
+
+void CPU::set_input(const InputFrame& input) {
+    keys_ = input.keys;
+    // FX0A takes the lowest of the keys released during the last frame. a key let go earlier is forgotten, so that it
+    // can't answer an FX0A which only runs later on
+    if (input.released != 0) {
+        released_key_ = __builtin_ctz(input.released);
+        waiting_for_key_ = false;
+    }
+    else {
+        released_key_ = -1;
+    }
+}
+
+void CPU::set_seed(uint32_t seed) {
+    random_.set_seed(seed);
+}
+
+void CPU::save_state(SaveState& state) const {
+    state.pc = pc_;
+    state.i = i_register_;
+    std::memcpy(state.v, var_registers_.data(), sizeof(state.v));
+    state.delay_timer = delay_timer_;
+    state.sound_timer = sound_timer_;
+    state.stack_pointer = stack_pointer_;
+    std::memcpy(state.stack, stack_.data(), sizeof(state.stack));
+    state.random_state = random_.get_state();
+    state.keys = keys_;
+    state.released_key = released_key_;
+    state.planes = plane_mask_;
+    std::memcpy(state.flags, flags_.data(), sizeof(state.flags));
+    std::memcpy(state.audio_pattern, audio_pattern_.data(), sizeof(state.audio_pattern));
+    state.pitch = pitch_;
+    state.hires = framebuffer_->is_hires();
+    std::memcpy(state.framebuffer, framebuffer_->get_words(), sizeof(state.framebuffer));
+    // only the memory in use, zeroing any the state held before past it, so that every byte past memory_size stays zero
+    uint32_t used = memory_->get_used_size();
+    std::memcpy(state.memory, memory_->get_contents(), used);
+    if (state.memory_size > used) {
+        std::memset(state.memory + used, 0, state.memory_size - used);
+    }
+    state.memory_size = used;
+}
+
+void CPU::load_state(const SaveState& state) {
+    pc_ = state.pc;
+    i_register_ = state.i;
+    std::memcpy(var_registers_.data(), state.v, sizeof(state.v));
+    delay_timer_ = state.delay_timer;
+    sound_timer_ = state.sound_timer;
+    stack_pointer_ = std::min<uint8_t>(state.stack_pointer, STACK_SIZE);
+    stack_fault_ = StackFault::none;
+    std::memcpy(stack_.data(), state.stack, sizeof(state.stack));
+    random_.set_state(state.random_state);
+    keys_ = state.keys;
+    released_key_ = state.released_key;
+    waiting_for_key_ = false; // a pending FX0A runs again and goes back to waiting
+    plane_mask_ = state.planes;
+    std::memcpy(flags_.data(), state.flags, sizeof(state.flags));
+    std::memcpy(audio_pattern_.data(), state.audio_pattern, sizeof(state.audio_pattern));
+    pitch_ = state.pitch;
+    audio_->set_pattern(audio_pattern_, pitch_);
+    framebuffer_->set_hires(state.hires != 0);
+    framebuffer_->set_words(&state.framebuffer[0][0][0]);
+    // through set_contents, so that decoded / compiled code for any bytes which differ is dropped
+    memory_->set_contents(state.memory, state.memory_size);
+}
+
+void CPU::memory_written(int memory_loc, int length) {
+    // an instruction is two bytes long, so the instruction starting one byte before the write is also stale
+    for (int loc = memory_loc - 1; loc < memory_loc + length; loc++) {
+        decode_cache_[loc & (MEMORY_SIZE - 1)].handler = HANDLER_COUNT;
+    }
+#ifdef CHIP8_JIT
+    jit_.invalidate(memory_loc, length);
+#endif
 }
 
 uint16_t CPU::fetch() {
     // read the instruction currently being pointed at by pc
-    uint8_t instruction_byte1 = memory_->get_from_memory(pc_);
-    uint8_t instruction_byte2 = memory_->get_from_memory(pc_ + 1);
+    uint8_t instruction_byte1 = memory_->get_from_memory(pc_ & (MEMORY_SIZE - 1));
+    uint8_t instruction_byte2 = memory_->get_from_memory((pc_ + 1) & (MEMORY_SIZE - 1));
     uint16_t instruction = (instruction_byte1 << 8) + (instruction_byte2);
     // after reading the instructions, increment the pc immediately
     pc_ += 2;
     return instruction; 
 }
 
+template <class Quirks>
 void CPU::decode_execute(uint16_t instruction) {
+    const Instruction decoded = decode(instruction);
+    (this->*handlers_<Quirks>[decoded.handler])(decoded);
+}
+
+constexpr Instruction CPU::decode(uint16_t instruction) {
+    Instruction decoded;
+    decoded.opcode = instruction;
+    decoded.nnn = instruction & 0x0fff;
+    decoded.nn = instruction & 0x00ff;
+    decoded.n = instruction & 0x000f;
+    decoded.x = (instruction & 0x0f00) >> 8;
+    decoded.y = (instruction & 0x00f0) >> 4;
+    decoded.handler = decode_handler(instruction);
+    return decoded;
+}
+
+constexpr uint8_t CPU::decode_handler(uint16_t instruction) {
+    uint8_t handler = OP_NOP;
+
     switch (instruction & 0xf000) {
         case 0x0000:
             if (instruction == 0x00e0) {
-                // 00e0: clear the screen
-                renderer_->clear_screen();
+                handler = OP_00E0;
             }
             else if (instruction == 0x00ee) {
-                // return from subroutine function
-                pc_ = stack_.top();
-                stack_.pop();
+                handler = OP_00EE;
+            }
+            else if ((instruction & 0xfff0) == 0x00c0) {
+                handler = OP_00CN;
+            }
+            else if ((instruction & 0xfff0) == 0x00d0) {
+                handler = OP_00DN;
+            }
+            else if (instruction == 0x00fb) {
+                handler = OP_00FB;
+            }
+            else if (instruction == 0x00fc) {
+                handler = OP_00FC;
+            }
+            else if (instruction == 0x00fd) {
+                handler = OP_00FD;
+            }
+            else if (instruction == 0x00fe) {
+                handler = OP_00FE;
+            }
+            else if (instruction == 0x00ff) {
+                handler = OP_00FF;
             }
             break; 
         case 0x1000:
-            // jump instruction to set PC to final bytes of hex 
-            pc_ = instruction & 0x0fff;
+            handler = OP_1NNN;
             break; 
         case 0x2000:
-            // call subroutine at address NNN from instruction 2NNN
-            // push the current pc to the stack so that we can return later
-            stack_.push(pc_);
-            pc_ = instruction & 0x0fff;
+            handler = OP_2NNN;
             break; 
         case 0x3000:
-            // skip instruction if val in register VX is equal to NN
-            {
-                uint8_t vx = var_registers_[(instruction & 0x0f00) >> 8];
-                if (vx == (instruction & 0x00ff)) {
-                    pc_ += 2;
-                }
-                break; 
-            } 
+            handler = OP_3XNN;
+            break; 
         case 0x4000:
-            // skip instruction if val in register VX is not equal to NN 
-            {
-                uint8_t vx = var_registers_[(instruction & 0x0f00) >> 8];
-                if (vx != (instruction & 0x00ff)) {
-                    pc_ += 2;
-                }
-                break; 
-            }
+            handler = OP_4XNN;
+            break; 
         case 0x5000:
-            {
-                uint8_t vx = var_registers_[(instruction & 0x0f00) >> 8];
-                uint8_t vy = var_registers_[(instruction & 0x00f0) >> 4];
-                if (vx == vy) {
-                    pc_ += 2;
-                }
-                break; 
+            if ((instruction & 0x000f) == 0x2) {
+                handler = OP_5XY2;
+            }
+            else if ((instruction & 0x000f) == 0x3) {
+                handler = OP_5XY3;
             }
+            else {
+                handler = OP_5XY0;
+            }
+            break; 
         case 0x6000:
-            // set register VX to NN, from instruction 6XNN
-            var_registers_[(instruction & 0x0f00) >> 8] = instruction & 0x00ff;
+            handler = OP_6XNN;
             break; 
         case 0x7000:
-            // add NN to value in register VX, from instruction 7XNN
-            // without setting the carry flag
-            var_registers_[(instruction & 0x0f00) >> 8] += instruction & 0x00ff;
+            handler = OP_7XNN;
             break; 
         case 0x8000:
-            {
-                uint8_t vx = var_registers_[(instruction & 0x0f00) >> 8]; 
-                uint8_t vy = var_registers_[(instruction & 0x00f0) >> 4]; 
-
-                switch (instruction & 0x000f) {
-                    case 0x0:
-                        // set vx = vy
-                        var_registers_[(instruction & 0x0f00) >> 8] = var_registers_[(instruction & 0x00f0) >> 4];
-                        break;
-                    case 0x1:
-                        // set vx to the bitwise OR of vx and vy
-                        var_registers_[(instruction & 0x0f00) >> 8] = vx | vy;
-                        break;
-                    case 0x2:
-                        // bitwise AND
-                        var_registers_[(instruction & 0x0f00) >> 8] = vx & vy;
-                        break;
-                    case 0x3:
-                        // bitwise XOR 
-                        var_registers_[(instruction & 0x0f00) >> 8] = vx ^ vy;
-                        break;
-                    case 0x4:
-                        {
-                            // ADD VX and VY and affect the overflow flag
-                            uint16_t total = vx + vy;
-                            // if there is an overflow, set the flag
-                            if (total > 255) {
-                                var_registers_[0xf] = 1;                            
-                            }
-                            else {
-                                var_registers_[0xf] = 0;
-                            }
-                            var_registers_[(instruction & 0x0f00) >> 8] = static_cast<uint8_t>(vx + vy);
-                            break;
-                        }
-                    case 0x5:
-                        // set the carry flag to 0 if we underflow
-                        if (vx > vy) {
-                            var_registers_[0xf] = 0;
-                        }
-                        else {
-                            var_registers_[0xf] = 1;
-                        }
-                        // subtract: vx = vx - vy
-                        var_registers_[(instruction & 0x0f00) >> 8] = vx - vy;
-                        break;
-                    case 0x6:
-                        // shift vx one bit to the right and set carry flag appropriately
-                        if (vy % 2 == 0) {
-                            // last bit is zero
-                            var_registers_[0xf] = 0;
-                        }
-                        else {
-                            var_registers_[0xf] = 1;
-                        }
-
-                        var_registers_[(instruction & 0x0f00) >> 8] = vy >> 1;
-
-                        break;
-                    case 0x7:
-                        // set the carry flag to 0 if we underflow
-                        if (vy > vx) {
-                            var_registers_[0xf] = 0;
-                        }
-                        else {
-                            var_registers_[0xf] = 1;
-                        }
-                        // subtract: vx = vx - vy
-                        var_registers_[(instruction & 0x0f00) >> 8] = vy - vx;
-                        break;
-                    case 0xe:
-                        if ((vy & 0x80) >> 7 == 0) {
-                            // last bit is 0
-                            var_registers_[0xf] = 0;
-                        }
-                        else {
-                            var_registers_[0xf] = 1;
-                        }
-
-                        // shift vx (= vy) to the right (crop to 8 bits)
-                        var_registers_[(instruction & 0x0f00) >> 8] = (vy << 1);
-                        break;
-                } 
-            }
+            switch (instruction & 0x000f) {
+                case 0x0:
+                    handler = OP_8XY0;
+                    break;
+                case 0x1:
+                    handler = OP_8XY1;
+                    break;
+                case 0x2:
+                    handler = OP_8XY2;
+                    break;
+                case 0x3:
+                    handler = OP_8XY3;
+                    break;
+                case 0x4:
+                    handler = OP_8XY4;
+                    break;
+                case 0x5:
+                    handler = OP_8XY5;
+                    break;
+                case 0x6:
+                    handler = OP_8XY6;
+                    break;
+                case 0x7:
+                    handler = OP_8XY7;
+                    break;
+                case 0xe:
+                    handler = OP_8XYE;
+                    break;
+            } 
             break; 
         case 0x9000:
-            {
-                uint8_t vx = var_registers_[(instruction & 0x0f00) >> 8];
-                uint8_t vy = var_registers_[(instruction & 0x00f0) >> 4];
-                if (vx != vy) {
-                    pc_ += 2;
-                }
-                break; 
-            }
+            handler = OP_9XY0;
+            break; 
         case 0xa000:
-            // set index register
-            i_register_ = instruction & 0x0fff;
+            handler = OP_ANNN;
             break; 
         case 0xb000:
-            // jump with NNN + offset stored in v0
-            pc_ = var_registers_[0x0] + (instruction & 0x0fff);
+            handler = OP_BNNN;
             break; 
         case 0xc000:
-            // vx = rand & NN
-            var_registers_[(instruction & 0x0f00) >> 8] = (instruction & 0x00ff) & static_cast<uint8_t>((rand() % instruction & 0x00ff));
+            handler = OP_CXNN;
             break; 
         case 0xd000:
-            {
-                // draw to display instruction
-                // get the X and Y coordinates from the VX and VY registers
-                uint8_t vx = var_registers_[(instruction & 0x0f00) >> 8] % SCREEN_WIDTH; 
-                uint8_t vy = var_registers_[(instruction & 0x00f0) >> 4] % SCREEN_HEIGHT; 
-
-                // set the VF register to 0
-                var_registers_[0xf] = 0x0;
-
-                // cap the columns/rows to be drawn if the rows/cols exceed the screen size
-                uint8_t row_len = 8;
-                if (row_len + vx >= SCREEN_WIDTH) {
-                    row_len = SCREEN_WIDTH - vx;
-                }
-
-                // sprite to be drawn has N bytes of data col_len = N
-                uint8_t col_len = instruction & 0x000f;
-                if (col_len + vy >= SCREEN_HEIGHT) {
-                    col_len = SCREEN_HEIGHT - vy;
-                }
-
-                // for every possible column val (every byte of the sprite)
-                for (int offset = 0; offset < col_len; offset++){
-                    uint8_t sprite_byte = memory_->get_from_memory(i_register_ + offset);
-                    // increment through each bit of byte of sprite data
-                    for (int bit = 0; bit < row_len; bit++) {
-                        // get one bit at a time, starting from the MSB
-                        uint8_t sprite_bit = (sprite_byte & (1 << (7 - bit))) >> (7 - bit); 
-                        uint8_t y = vy + offset; // y coordinate on display
-                        uint8_t x = vx + bit; // x coordinate on display
-
-                        if (sprite_bit == 1) {
-                            if (renderer_->get_pixel_is_on(x, y)) {
-                                renderer_->set_pixel(x, y, false);
-                                var_registers_[0xf] = 1;
-                            }
-                            else {
-                                renderer_->set_pixel(x, y, true);
-                            }
-                        }
-                    }
-                }
-                break; 
-            }
+            handler = OP_DXYN;
+            break; 
         case 0xe000:
-            {
-                // check if a key is being pressed, and if it is
-                // if the key that is being pressed is a valid key in the CHIP 8 system 
-                const uint8_t* state = SDL_GetKeyboardState(nullptr);
-                uint8_t scancode = memory_->hex_to_scancode_translation[(instruction & 0x0f00) >> 8];
-                if (((instruction & 0x000f) == 0xe) && state[scancode]) {
-                    // the key being queried is being pressed
-                    pc_ += 2;
-                } else if (((instruction & 0x000f) == 0x1) && !state[scancode]) {
-                    // TODO: this checks if the key is not being pressed, but not if it is a valid key on the CHIP-8 system
-                    pc_ += 2;
-                }
-                break;
+            if ((instruction & 0x000f) == 0xe) {
+                handler = OP_EX9E;
+            }
+            else if ((instruction & 0x000f) == 0x1) {
+                handler = OP_EXA1;
             }
+            break;
         case 0xf000:
             switch (instruction & 0x00ff) {
+                case 0x00:
+                    if (instruction == 0xf000) {
+                        handler = OP_F000;
+                    }
+                    break;
+                case 0x01:
+                    handler = OP_FN01;
+                    break;
+                case 0x02:
+                    if (instruction == 0xf002) {
+                        handler = OP_F002;
+                    }
+                    break;
                 case 0x07:
-                    // set the delay timer from the VX register
-                    delay_timer_ = var_registers_[(instruction & 0x0f00) >> 8];
+                    handler = OP_FX07;
                     break;
                 case 0x15:
-                    // get the delay timer into the VX register
-                    var_registers_[(instruction & 0x0f00) >> 8] = delay_timer_;
+                    handler = OP_FX15;
                     break;
                 case 0x18:
-                    // set the sound timer to the value in vx
-                    sound_->set_timer(var_registers_[(instruction & 0x0f00) >> 8]); 
+                    handler = OP_FX18;
                     break;
                 case 0x1e:
-                    // add value in vx to index register
-                    i_register_ += var_registers_[(instruction & 0x0f00) >> 8];
+                    handler = OP_FX1E;
                     break;
                 case 0x0a:
-                    // get key (blocking call)
-                    {
-                        bool key_up = false;
-                        SDL_Event event;
-                        while (SDL_PollEvent(&event)) {
-                            switch (event.type) {
-                                case SDL_QUIT:
-                                    renderer_->quit();
-                                    exit(0);
-                                case SDL_KEYUP:
-                                    uint8_t key_released_scancode = event.key.keysym.scancode;
-                                    if (memory_->scancode_to_hex_translation.find(key_released_scancode) != memory_->scancode_to_hex_translation.end()) {
-                                        // set register VX to the hex translation
-                                        var_registers_[0xf] = memory_->scancode_to_hex_translation[key_released_scancode];
-                                        key_up = true;
-                                        break;
-                                    }
-                            }
-                        }
-
-                        // made it through the event loop without triggering the SDL_KEYUP event, so made a blocking call
-                        if (!key_up) {
-                            pc_ -= 2;
-                        }
-                    }
+                    handler = OP_FX0A;
                     break;
                 case 0x29:
-                    // instruction : load font character
-                    // each font character is 5 bytes long, so take vx * 5 to find the appropriate character 
-                    i_register_ = memory_->get_from_memory(5 * var_registers_[(instruction & 0x0f00) >> 8]);
+                    handler = OP_FX29;
                     break;
                 case 0x33:
-                    // binary-coded decimal conversion (extract digits)
-                    {
-                        uint8_t vx = var_registers_[(instruction & 0x0f00) >> 8];
-                        memory_->set_memory(i_register_ + 0, static_cast<uint8_t>(vx / 100) % 10);
-                        memory_->set_memory(i_register_ + 1, static_cast<uint8_t>(vx / 10) % 10);
-                        memory_->set_memory(i_register_ + 2, static_cast<uint8_t>(vx / 1) % 10);
-                    }
+                    handler = OP_FX33;
                     break;
                 case 0x55:
-                    // store registers in memory up to register VX (inclusive) 
-                    {
-                        uint8_t x = (instruction & 0x0f00) >> 8;
-                        for (uint8_t i = 0; i <= x; i++) {
-                            uint8_t vx = var_registers_[(instruction & 0x0f00) >> 8];
-                            memory_->set_memory(i_register_ + i, vx);
-                        }
-                    }
+                    handler = OP_FX55;
                     break;
                 case 0x65:
-                    // load memory into registers
-                    {
-                        uint8_t x = (instruction & 0x0f00) >> 8;
-                        for (uint8_t i = 0; i <= x; i++) {
-                            var_registers_[i] = memory_->get_from_memory(i_register_ + i);
-                        }
-                    }
+                    handler = OP_FX65;
+                    break;
+                case 0x30:
+                    handler = OP_FX30;
+                    break;
+                case 0x3a:
+                    handler = OP_FX3A;
+                    break;
+                case 0x75:
+                    handler = OP_FX75;
+                    break;
+                case 0x85:
+                    handler = OP_FX85;
                     break;
             }
             break;
     }
+
+    return handler;
 }
+
+template <class Quirks>
+const std::array<Handler, HANDLER_COUNT> CPU::handlers_ = {
+    &CPU::op_nop,
+    &CPU::op_00e0,
+    &CPU::op_00ee,
+    &CPU::op_1nnn,
+    &CPU::op_2nnn,
+    &CPU::op_3xnn<Quirks>,
+    &CPU::op_4xnn<Quirks>,
+    &CPU::op_5xy0<Quirks>,
+    &CPU::op_6xnn,
+    &CPU::op_7xnn,
+    &CPU::op_8xy0,
+    &CPU::op_8xy1,
+    &CPU::op_8xy2,
+    &CPU::op_8xy3,
+    &CPU::op_8xy4,
+    &CPU::op_8xy5,
+    &CPU::op_8xy6<Quirks>,
+    &CPU::op_8xy7,
+    &CPU::op_8xye<Quirks>,
+    &CPU::op_9xy0<Quirks>,
+    &CPU::op_annn,
+    &CPU::op_bnnn<Quirks>,
+    &CPU::op_cxnn,
+    &CPU::op_dxyn<Quirks>,
+    &CPU::op_ex9e<Quirks>,
+    &CPU::op_exa1<Quirks>,
+    &CPU::op_fx07,
+    &CPU::op_fx0a,
+    &CPU::op_fx15,
+    &CPU::op_fx18,
+    &CPU::op_fx1e,
+    &CPU::op_fx29,
+    &CPU::op_fx33,
+    &CPU::op_fx55<Quirks>,
+    &CPU::op_fx65<Quirks>,
+    &CPU::op_00cn,
+    &CPU::op_00fb,
+    &CPU::op_00fc,
+    &CPU::op_00fd,
+    &CPU::op_00fe,
+    &CPU::op_00ff,
+    &CPU::op_fx30,
+    &CPU::op_fx75,
+    &CPU::op_fx85,
+    &CPU::op_00dn,
+    &CPU::op_5xy2,
+    &CPU::op_5xy3,
+    &CPU::op_f000,
+    &CPU::op_fn01,
+    &CPU::op_f002,
+    &CPU::op_fx3a,
+};
+
+// in the same order as handlers_ (op_nop is run for opcodes which aren't instructions)
+const std::array<const char*, HANDLER_COUNT> CPU::handler_names_ = {
+    "unknown", "00E0", "00EE", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN", "8XY0", "8XY1",
+    "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE", "9XY0", "ANNN", "BNNN", "CXNN", "DXYN",
+    "EX9E", "EXA1", "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX33", "FX55", "FX65",
+    "00CN", "00FB", "00FC", "00FD", "00FE", "00FF", "FX30", "FX75", "FX85",
+    "00DN", "5XY2", "5XY3", "F000", "FN01", "F002", "FX3A",
+};
+
+constexpr std::array<uint8_t, 0x10000> CPU::build_opcode_table() {
+    // run every opcode through the switch once, storing the index of its handler in handlers_
+    std::array<uint8_t, 0x10000> table{};
+    for (uint32_t opcode = 0; opcode < table.size(); opcode++) {
+        table[opcode] = decode_handler(opcode);
+    }
+    return table;
+}
+
+constexpr std::array<Instruction, 0x10000> CPU::build_decoded_opcodes() {
+    std::array<Instruction, 0x10000> table{};
+    for (uint32_t opcode = 0; opcode < table.size(); opcode++) {
+        table[opcode] = decode(opcode);
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 0x10000> CPU::opcode_table_ = CPU::build_opcode_table();
+constexpr std::array<Instruction, 0x10000> CPU::decoded_opcodes_ = CPU::build_decoded_opcodes();
+
+void CPU::op_nop(const Instruction& instruction) {
+    // unknown instruction (or 0NNN machine code routine), ignored
+}
+
+void CPU::op_00e0(const Instruction& instruction) {
+    // 00e0: clear the screen (the planes selected, for XO-CHIP)
+    framebuffer_->clear(plane_mask_);
+}
+
+void CPU::op_00ee(const Instruction& instruction) {
+    // return from subroutine function
+    if (stack_pointer_ == 0) [[unlikely]] {
+        // nothing to return to: stop here
+        stack_fault_ = StackFault::underflow;
+        pc_ -= 2;
+        return;
+    }
+    stack_pointer_--;
+    pc_ = stack_[stack_pointer_];
+}
+
+void CPU::op_1nnn(const Instruction& instruction) {
+    // jump instruction to set PC to final bytes of hex 
+    pc_ = instruction.nnn;
+}
+
+void CPU::op_2nnn(const Instruction& instruction) {
+    // call subroutine at address NNN from instruction 2NNN
+    // push the current pc to the stack so that we can return later
+    if (stack_pointer_ == STACK_SIZE) [[unlikely]] {
+        // the stack is full (runaway recursion): stop here, rather than overwriting the oldest return address
+        stack_fault_ = StackFault::overflow;
+        pc_ -= 2;
+        return;
+    }
+    stack_[stack_pointer_] = pc_;
+    stack_pointer_++;
+    pc_ = instruction.nnn;
+}
+
+template <class Quirks>
+void CPU::skip() {
+    // XO-CHIP steps over both words of an F000 NNNN
+    if constexpr (Quirks::long_skip) {
+        if (memory_->get_from_memory(pc_) == 0xf0 && memory_->get_from_memory(pc_ + 1) == 0x00) {
+            pc_ += 4;
+            return;
+        }
+    }
+    pc_ += 2;
+}
+
+template <class Quirks>
+void CPU::op_3xnn(const Instruction& instruction) {
+    // skip instruction if val in register VX is equal to NN
+    if (var_registers_[instruction.x] == instruction.nn) {
+        skip<Quirks>();
+    }
+}
+
+template <class Quirks>
+void CPU::op_4xnn(const Instruction& instruction) {
+    // skip instruction if val in register VX is not equal to NN 
+    if (var_registers_[instruction.x] != instruction.nn) {
+        skip<Quirks>();
+    }
+}
+
+template <class Quirks>
+void CPU::op_5xy0(const Instruction& instruction) {
+    // skip instruction if val in register VX is equal to val in register VY
+    if (var_registers_[instruction.x] == var_registers_[instruction.y]) {
+        skip<Quirks>();
+    }
+}
+
+void CPU::op_6xnn(const Instruction& instruction) {
+    // set register VX to NN, from instruction 6XNN
+    var_registers_[instruction.x] = instruction.nn;
+}
+
+void CPU::op_7xnn(const Instruction& instruction) {
+    // add NN to value in register VX, from instruction 7XNN
+    // without setting the carry flag
+    var_registers_[instruction.x] += instruction.nn;
+}
+
+void CPU::op_8xy0(const Instruction& instruction) {
+    // set vx = vy
+    var_registers_[instruction.x] = var_registers_[instruction.y];
+}
+
+void CPU::op_8xy1(const Instruction& instruction) {
+    // set vx to the bitwise OR of vx and vy
+    var_registers_[instruction.x] = var_registers_[instruction.x] | var_registers_[instruction.y];
+}
+
+void CPU::op_8xy2(const Instruction& instruction) {
+    // bitwise AND
+    var_registers_[instruction.x] = var_registers_[instruction.x] & var_registers_[instruction.y];
+}
+
+void CPU::op_8xy3(const Instruction& instruction) {
+    // bitwise XOR 
+    var_registers_[instruction.x] = var_registers_[instruction.x] ^ var_registers_[instruction.y];
+}
+
+void CPU::op_8xy4(const Instruction& instruction) {
+    uint8_t vx = var_registers_[instruction.x]; 
+    uint8_t vy = var_registers_[instruction.y]; 
+
+    // ADD VX and VY and affect the overflow flag
+    uint16_t total = vx + vy;
+    // if there is an overflow, set the flag
+    if (total > 255) {
+        var_registers_[0xf] = 1;                            
+    }
+    else {
+        var_registers_[0xf] = 0;
+    }
+    var_registers_[instruction.x] = static_cast<uint8_t>(vx + vy);
+}
+
+void CPU::op_8xy5(const Instruction& instruction) {
+    uint8_t vx = var_registers_[instruction.x]; 
+    uint8_t vy = var_registers_[instruction.y]; 
+
+    // set the carry flag to 0 if we underflow
+    if (vx > vy) {
+        var_registers_[0xf] = 0;
+    }
+    else {
+        var_registers_[0xf] = 1;
+    }
+    // subtract: vx = vx - vy
+    var_registers_[instruction.x] = vx - vy;
+}
+
+template <class Quirks>
+void CPU::op_8xy6(const Instruction& instruction) {
+    // SUPER-CHIP shifts VX in place, ignoring VY
+    uint8_t vy = var_registers_[Quirks::shift_vx ? instruction.x : instruction.y];
+
+    // shift vx one bit to the right and set carry flag appropriately
+    if (vy % 2 == 0) {
+        // last bit is zero
+        var_registers_[0xf] = 0;
+    }
+    else {
+        var_registers_[0xf] = 1;
+    }
+
+    var_registers_[instruction.x] = vy >> 1;
+}
+
+void CPU::op_8xy7(const Instruction& instruction) {
+    uint8_t vx = var_registers_[instruction.x]; 
+    uint8_t vy = var_registers_[instruction.y]; 
+
+    // set the carry flag to 0 if we underflow
+    if (vy > vx) {
+        var_registers_[0xf] = 0;
+    }
+    else {
+        var_registers_[0xf] = 1;
+    }
+    // subtract: vx = vx - vy
+    var_registers_[instruction.x] = vy - vx;
+}
+
+template <class Quirks>
+void CPU::op_8xye(const Instruction& instruction) {
+    uint8_t vy = var_registers_[Quirks::shift_vx ? instruction.x : instruction.y];
+
+    if ((vy & 0x80) >> 7 == 0) {
+        // last bit is 0
+        var_registers_[0xf] = 0;
+    }
+    else {
+        var_registers_[0xf] = 1;
+    }
+
+    // shift vx (= vy) to the right (crop to 8 bits)
+    var_registers_[instruction.x] = (vy << 1);
+}
+
+template <class Quirks>
+void CPU::op_9xy0(const Instruction& instruction) {
+    // skip instruction if val in register VX is not equal to val in register VY
+    if (var_registers_[instruction.x] != var_registers_[instruction.y]) {
+        skip<Quirks>();
+    }
+}
+
+void CPU::op_annn(const Instruction& instruction) {
+    // set index register
+    i_register_ = instruction.nnn;
+}
+
+template <class Quirks>
+void CPU::op_bnnn(const Instruction& instruction) {
+    if constexpr (Quirks::jump_vx) {
+        // BXNN: jump with XNN + offset stored in vx
+        pc_ = var_registers_[instruction.x] + instruction.nnn;
+    }
+    else {
+        // jump with NNN + offset stored in v0
+        pc_ = var_registers_[0x0] + instruction.nnn;
+    }
+}
+
+void CPU::op_cxnn(const Instruction& instruction) {
+    // vx = random byte & NN, from this cpu's own generator
+    var_registers_[instruction.x] = instruction.nn & random_.next_byte();
+}
+
+template <class Quirks>
+void CPU::op_dxyn(const Instruction& instruction) {
+    // draw to display instruction
+    // get the X and Y coordinates from the VX and VY registers, wrapped to the screen at its current resolution (a
+    // power of two either way)
+    unsigned int vx = var_registers_[instruction.x] & (framebuffer_->get_width() - 1);
+    unsigned int vy = var_registers_[instruction.y] & (framebuffer_->get_height() - 1);
+
+    // sprite to be drawn has N bytes of data, one byte per row (DXY0: 32, a 16x16 sprite), for each plane selected
+    uint8_t sprite[MAX_SPRITE_BYTES];
+    unsigned int bytes = Framebuffer::sprite_bytes(instruction.n, plane_mask_);
+    for (unsigned int offset = 0; offset < bytes; offset++) {
+        sprite[offset] = memory_->get_from_memory(i_register_ + offset);
+    }
+
+    // each row is shifted into place and XORed into its words of the framebuffer, clipping at the edges of the screen
+    // (or wrapping round them, for XO-CHIP). VF is set if any pixel was turned off
+    var_registers_[0xf] = framebuffer_->draw(vx, vy, sprite, instruction.n, plane_mask_, Quirks::wrap_sprites) ? 1 : 0;
+}
+
+template <class Quirks>
+void CPU::op_ex9e(const Instruction& instruction) {
+    // skip the next instruction if the key in VX is being pressed
+    if ((keys_ >> instruction.x) & 1) {
+        skip<Quirks>();
+    }
+}
+
+template <class Quirks>
+void CPU::op_exa1(const Instruction& instruction) {
+    // skip the next instruction if the key in VX is not being pressed
+    // TODO: this checks if the key is not being pressed, but not if it is a valid key on the CHIP-8 system
+    if (!((keys_ >> instruction.x) & 1)) {
+        skip<Quirks>();
+    }
+}
+
+void CPU::op_fx07(const Instruction& instruction) {
+    // get the delay timer into the VX register
+    var_registers_[instruction.x] = delay_timer_;
+}
+
+void CPU::op_fx0a(const Instruction& instruction) {
+    // get key (blocking call)
+    if (released_key_ >= 0) {
+        // set register VX to the released key
+        var_registers_[instruction.x] = released_key_;
+        released_key_ = -1;
+    }
+    else {
+        // no key has been released yet: stop here until one is (set_input), then run this instruction again
+        pc_ -= 2;
+        waiting_for_key_ = true;
+    }
+}
+
+void CPU::op_fx15(const Instruction& instruction) {
+    // set the delay timer from the VX register
+    delay_timer_ = var_registers_[instruction.x];
+}
+
+void CPU::op_fx18(const Instruction& instruction) {
+    // set the sound timer to the value in vx
+    sound_timer_ = var_registers_[instruction.x];
+}
+
+void CPU::op_fx1e(const Instruction& instruction) {
+    // add value in vx to index register
+    i_register_ += var_registers_[instruction.x];
+}
+
+void CPU::op_fx29(const Instruction& instruction) {
+    // instruction : load font character
+    // each font character is 5 bytes long, so take vx * 5 to find the appropriate character 
+    i_register_ = memory_->get_from_memory(5 * var_registers_[instruction.x]);
+}
+
+void CPU::op_fx33(const Instruction& instruction) {
+    // binary-coded decimal conversion (extract digits)
+    uint8_t vx = var_registers_[instruction.x];
+    memory_->set_memory(i_register_ + 0, static_cast<uint8_t>(vx / 100) % 10);
+    memory_->set_memory(i_register_ + 1, static_cast<uint8_t>(vx / 10) % 10);
+    memory_->set_memory(i_register_ + 2, static_cast<uint8_t>(vx / 1) % 10);
+}
+
+template <class Quirks>
+void CPU::op_fx55(const Instruction& instruction) {
+    // store registers in memory up to register VX (inclusive) 
+    for (uint8_t i = 0; i <= instruction.x; i++) {
+        memory_->set_memory(i_register_ + i, var_registers_[i]);
+    }
+    if constexpr (Quirks::increment_i) {
+        // the VIP's interpreter left I past the last register stored
+        i_register_ += instruction.x + 1;
+    }
+}
+
+template <class Quirks>
+void CPU::op_fx65(const Instruction& instruction) {
+    // load memory into registers
+    for (uint8_t i = 0; i <= instruction.x; i++) {
+        var_registers_[i] = memory_->get_from_memory(i_register_ + i);
+    }
+    if constexpr (Quirks::increment_i) {
+        i_register_ += instruction.x + 1;
+    }
+}
+
+void CPU::op_00cn(const Instruction& instruction) {
+    // scroll the screen down N pixels
+    framebuffer_->scroll_down(instruction.n, plane_mask_);
+}
+
+void CPU::op_00fb(const Instruction& instruction) {
+    // scroll the screen right 4 pixels
+    framebuffer_->scroll_right(plane_mask_);
+}
+
+void CPU::op_00fc(const Instruction& instruction) {
+    // scroll the screen left 4 pixels
+    framebuffer_->scroll_left(plane_mask_);
+}
+
+void CPU::op_00fd(const Instruction& instruction) {
+    // exit the interpreter: stop here, running this instruction again and again
+    pc_ -= 2;
+}
+
+void CPU::op_00fe(const Instruction& instruction) {
+    // lo-res, 64x32
+    framebuffer_->set_hires(false);
+}
+
+void CPU::op_00ff(const Instruction& instruction) {
+    // hi-res, 128x64
+    framebuffer_->set_hires(true);
+}
+
+void CPU::op_fx30(const Instruction& instruction) {
+    // point I at the large (10 byte) font character for the digit in vx
+    i_register_ = BIG_FONT_START + 10 * (var_registers_[instruction.x] & 0xf);
+}
+
+void CPU::op_fx75(const Instruction& instruction) {
+    // save v0 to vx in the user flags (the HP 48's RPL flags)
+    for (uint8_t i = 0; i <= instruction.x; i++) {
+        flags_[i] = var_registers_[i];
+    }
+}
+
+void CPU::op_fx85(const Instruction& instruction) {
+    // load v0 to vx from the user flags
+    for (uint8_t i = 0; i <= instruction.x; i++) {
+        var_registers_[i] = flags_[i];
+    }
+}
+
+void CPU::op_00dn(const Instruction& instruction) {
+    // scroll the screen up N pixels
+    framebuffer_->scroll_up(instruction.n, plane_mask_);
+}
+
+void CPU::op_5xy2(const Instruction& instruction) {
+    // store vx to vy (in that order, so backwards if y < x) in memory from I, leaving I as it is
+    int step = instruction.x <= instruction.y ? 1 : -1;
+    int count = std::abs(instruction.y - instruction.x) + 1;
+    for (int i = 0; i < count; i++) {
+        memory_->set_memory(i_register_ + i, var_registers_[instruction.x + i * step]);
+    }
+}
+
+void CPU::op_5xy3(const Instruction& instruction) {
+    // load vx to vy from memory at I
+    int step = instruction.x <= instruction.y ? 1 : -1;
+    int count = std::abs(instruction.y - instruction.x) + 1;
+    for (int i = 0; i < count; i++) {
+        var_registers_[instruction.x + i * step] = memory_->get_from_memory(i_register_ + i);
+    }
+}
+
+void CPU::op_f000(const Instruction& instruction) {
+    // set I to the 16 bit address in the word after this instruction, and step over it
+    i_register_ = (memory_->get_from_memory(pc_) << 8) | memory_->get_from_memory(pc_ + 1);
+    pc_ += 2;
+}
+
+void CPU::op_fn01(const Instruction& instruction) {
+    // select the planes (bit p for plane p) drawn on, cleared and scrolled
+    plane_mask_ = instruction.x & ALL_PLANES;
+}
+
+void CPU::op_f002(const Instruction& instruction) {
+    // load the 16 byte audio pattern from memory at I
+    for (int i = 0; i < AUDIO_PATTERN_BYTES; i++) {
+        audio_pattern_[i] = memory_->get_from_memory(i_register_ + i);
+    }
+    audio_->set_pattern(audio_pattern_, pitch_);
+}
+
+void CPU::op_fx3a(const Instruction& instruction) {
+    // set the pitch the audio pattern plays at to vx
+    pitch_ = var_registers_[instruction.x];
+    audio_->set_pattern(audio_pattern_, pitch_);
+}
+
+// the dispatchers bench and run_cycles_using take the address of, for every profile
+#define INSTANTIATE_QUIRKS(QUIRKS) \
+    template void CPU::cycle_cached<QUIRKS>(); \
+    template void CPU::cycle_table<QUIRKS>(); \
+    template void CPU::cycle_switch<QUIRKS>();
+
+INSTANTIATE_QUIRKS(Chip8Quirks)
+INSTANTIATE_QUIRKS(VipQuirks)
+INSTANTIATE_QUIRKS(SchipQuirks)
+INSTANTIATE_QUIRKS(XoChipQuirks)
@@ -0,0 +1,278 @@
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+void Framebuffer::clear(uint8_t planes) {
+    // only the words in use at this resolution: the rest stay off in lo-res, as nothing draws or scrolls there
+    for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+        if ((planes >> plane) & 1) {
+            for (unsigned int column = 0; column < get_width() / 64; column++) {
+                std::fill_n(words_[plane][column].begin(), get_height(), 0);
+            }
+        }
+    }
+}
+
+void Framebuffer::set_hires(bool hires) {
+    hires_ = hires;
+    words_ = {};
+}
+
+bool Framebuffer::get_pixel_is_on(unsigned int x, unsigned int y, unsigned int plane) const {
+    return (words_[plane][x / 64][y] >> (63 - x % 64)) & 1;
+}
+
+void Framebuffer::set_pixel(unsigned int x, unsigned int y, bool status, unsigned int plane) {
+    uint64_t mask = uint64_t(1) << (63 - x % 64);
+    if (status) {
+        words_[plane][x / 64][y] |= mask;
+    }
+    else {
+        words_[plane][x / 64][y] &= ~mask;
+    }
+}
+
+uint8_t Framebuffer::get_color(unsigned int x, unsigned int y) const {
+    uint8_t color = 0;
+    for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+        color |= get_pixel_is_on(x, y, plane) << plane;
+    }
+    return color;
+}
+
+void Framebuffer::set_words(const uint64_t* words) {
+    std::memcpy(words_.data(), words, sizeof(words_));
+}
+
+uint64_t Framebuffer::hash() const {
+    uint64_t hash = 0xcbf29ce484222325;
+    hash ^= hires_;
+    hash *= 0x100000001b3;
+    const uint64_t* words = get_words();
+    for (size_t i = 0; i < sizeof(words_) / sizeof(uint64_t); i++) {
+        for (int byte = 0; byte < 8; byte++) {
+            hash ^= (words[i] >> (byte * 8)) & 0xff;
+            hash *= 0x100000001b3;
+        }
+    }
+    return hash;
+}
+
+unsigned int Framebuffer::sprite_bytes(unsigned int n, uint8_t planes) {
+    return std::popcount(unsigned(planes & ALL_PLANES)) * (n == 0 ? 32 : n);
+}
+
+bool Framebuffer::draw(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, uint8_t planes, bool wrap) {
+    bool collision = false;
+    for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!((planes >> plane) & 1)) {
+            continue;
+        }
+        bool hit;
+        if (n == 0) {
+            hit = wrap ? draw_split<true>(x, y, sprite, 16, 2, plane) : draw_split<false>(x, y, sprite, 16, 2, plane);
+            sprite += 32;
+        }
+        else {
+            hit = wrap ? draw_sprite_wrapped(x, y, sprite, n, plane) : draw_sprite(x, y, sprite, n, plane);
+            sprite += n;
+        }
+        collision = collision || hit;
+    }
+    return collision;
+}
+
+bool Framebuffer::draw_sprite(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, unsigned int plane) {
+    // in hi-res a sprite starting in the last 7 columns of the left word straddles the two words of its rows
+    if (x % 64 > 64 - 8 && x / 64 + 1 < get_width() / 64) [[unlikely]] {
+        return draw_split<false>(x, y, sprite, n, 1, plane);
+    }
+    // two rows per SSE2 vector is no faster than the scalar loop, so only take the vector path with AVX2 / NEON
+#if defined(__AVX2__) || defined(__ARM_NEON)
+    return draw_sprite_simd(x, y, sprite, n, plane);
+#else
+    return draw_sprite_scalar(x, y, sprite, n, plane);
+#endif
+}
+
+bool Framebuffer::draw_sprite_scalar(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, unsigned int plane) {
+    // rows past the bottom of the screen are clipped, columns past the right edge are shifted out of the word
+    unsigned int rows = (y + n > get_height()) ? get_height() - y : n;
+    uint64_t* target = words_[plane][x / 64].data() + y;
+    x %= 64;
+    uint64_t collision = 0;
+    for (unsigned int row = 0; row < rows; row++) {
+        uint64_t line = (uint64_t(sprite[row]) << (64 - 8)) >> x;
+        collision |= target[row] & line;
+        target[row] ^= line;
+    }
+    return collision != 0;
+}
+
+bool Framebuffer::draw_sprite_simd(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, unsigned int plane) {
+    unsigned int rows = (y + n > get_height()) ? get_height() - y : n;
+    uint64_t* target = words_[plane][x / 64].data() + y;
+    x %= 64;
+    unsigned int row = 0;
+    uint64_t collision = 0;
+#if defined(__AVX2__)
+    // widen four sprite bytes at a time into the top byte of four 64 bit lanes, then shift them across to column x
+    __m128i shift = _mm_cvtsi32_si128(x);
+    __m256i hits = _mm256_setzero_si256();
+    for (; row + 4 <= rows; row += 4) {
+        uint32_t bytes;
+        __builtin_memcpy(&bytes, sprite + row, sizeof(bytes));
+        __m256i line = _mm256_srl_epi64(_mm256_slli_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bytes)), 64 - 8), shift);
+        __m256i screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(target + row));
+        hits = _mm256_or_si256(hits, _mm256_and_si256(screen, line));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + row), _mm256_xor_si256(screen, line));
+    }
+    collision = !_mm256_testz_si256(hits, hits);
+#elif defined(__SSE2__)
+    // two rows per vector: place each sprite byte in the top byte of a 64 bit lane, then shift it across to column x
+    __m128i shift = _mm_cvtsi32_si128(x);
+    __m128i hits = _mm_setzero_si128();
+    for (; row + 2 <= rows; row += 2) {
+        __m128i line = _mm_set_epi64x(int64_t(uint64_t(sprite[row + 1]) << (64 - 8)), int64_t(uint64_t(sprite[row]) << (64 - 8)));
+        line = _mm_srl_epi64(line, shift);
+        __m128i screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(target + row));
+        hits = _mm_or_si128(hits, _mm_and_si128(screen, line));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + row), _mm_xor_si128(screen, line));
+    }
+    collision = _mm_movemask_epi8(_mm_cmpeq_epi8(hits, _mm_setzero_si128())) != 0xffff;
+#elif defined(__ARM_NEON)
+    int64x2_t shift = vdupq_n_s64(-int64_t(x));
+    uint64x2_t hits = vdupq_n_u64(0);
+    for (; row + 2 <= rows; row += 2) {
+        uint64_t pair[2] = {uint64_t(sprite[row]) << (64 - 8), uint64_t(sprite[row + 1]) << (64 - 8)};
+        uint64x2_t line = vshlq_u64(vld1q_u64(pair), shift);
+        uint64x2_t screen = vld1q_u64(target + row);
+        hits = vorrq_u64(hits, vandq_u64(screen, line));
+        vst1q_u64(target + row, veorq_u64(screen, line));
+    }
+    collision = vgetq_lane_u64(hits, 0) | vgetq_lane_u64(hits, 1);
+#endif
+    // whatever rows are left over after the last full vector
+    for (; row < rows; row++) {
+        uint64_t line = (uint64_t(sprite[row]) << (64 - 8)) >> x;
+        collision |= target[row] & line;
+        target[row] ^= line;
+    }
+    return collision != 0;
+}
+
+bool Framebuffer::draw_sprite_wrapped(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int n, unsigned int plane) {
+    return draw_split<true>(x, y, sprite, n, 1, plane);
+}
+
+template <bool wrap>
+bool Framebuffer::draw_split(unsigned int x, unsigned int y, const uint8_t* sprite, unsigned int rows, unsigned int row_bytes, unsigned int plane) {
+    unsigned int height = get_height();
+    unsigned int columns = get_width() / 64;
+    unsigned int column = x / 64;
+    unsigned int shift = x % 64;
+    // the pixels shifted out of the right of a row's word go into the next column's word: the left edge's when
+    // wrapping round from the last column (in lo-res, the same word), or nowhere when clipping there
+    unsigned int next = (column + 1 == columns) ? 0 : column + 1;
+    bool spills = shift + 8 * row_bytes > 64 && (wrap || column + 1 < columns);
+    if (!wrap && y + rows > height) {
+        rows = height - y;
+    }
+
+    uint64_t collision = 0;
+    for (unsigned int row = 0; row < rows; row++) {
+        uint64_t line = uint64_t(sprite[row * row_bytes]) << (64 - 8);
+        if (row_bytes == 2) {
+            line |= uint64_t(sprite[row * 2 + 1]) << (64 - 16);
+        }
+        unsigned int target_y = (wrap && y + row >= height) ? y + row - height : y + row;
+        uint64_t& first = words_[plane][column][target_y];
+        uint64_t bits = line >> shift;
+        collision |= first & bits;
+        first ^= bits;
+        if (spills) {
+            uint64_t& second = words_[plane][next][target_y];
+            bits = line << (64 - shift);
+            collision |= second & bits;
+            second ^= bits;
+        }
+    }
+    return collision != 0;
+}
+
+void Framebuffer::scroll_down(unsigned int n, uint8_t planes) {
+    // the rows of a column are contiguous, so a vertical scroll is a move of each column's words
+    unsigned int height = get_height();
+    n = std::min(n, height);
+    for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!((planes >> plane) & 1)) {
+            continue;
+        }
+        for (unsigned int column = 0; column < get_width() / 64; column++) {
+            uint64_t* words = words_[plane][column].data();
+            std::memmove(words + n, words, (height - n) * sizeof(uint64_t));
+            std::memset(words, 0, n * sizeof(uint64_t));
+        }
+    }
+}
+
+void Framebuffer::scroll_up(unsigned int n, uint8_t planes) {
+    unsigned int height = get_height();
+    n = std::min(n, height);
+    for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!((planes >> plane) & 1)) {
+            continue;
+        }
+        for (unsigned int column = 0; column < get_width() / 64; column++) {
+            uint64_t* words = words_[plane][column].data();
+            std::memmove(words, words + n, (height - n) * sizeof(uint64_t));
+            std::memset(words + height - n, 0, n * sizeof(uint64_t));
+        }
+    }
+}
+
+void Framebuffer::scroll_right(uint8_t planes) {
+    // a horizontal scroll shifts every word, carrying the pixels shifted out of one column into the next. the columns
+    // are done right to left, so each reads its left neighbour before that is shifted
+    unsigned int height = get_height();
+    unsigned int columns = get_width() / 64;
+    for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!((planes >> plane) & 1)) {
+            continue;
+        }
+        for (unsigned int column = columns; column-- > 0;) {
+            uint64_t* words = words_[plane][column].data();
+            const uint64_t* left = column > 0 ? words_[plane][column - 1].data() : nullptr;
+            for (unsigned int y = 0; y < height; y++) {
+                words[y] = (words[y] >> 4) | (left != nullptr ? left[y] << 60 : 0);
+            }
+        }
+    }
+}
+
+void Framebuffer::scroll_left(uint8_t planes) {
+    unsigned int height = get_height();
+    unsigned int columns = get_width() / 64;
+    for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!((planes >> plane) & 1)) {
+            continue;
+        }
+        for (unsigned int column = 0; column < columns; column++) {
+            uint64_t* words = words_[plane][column].data();
+            const uint64_t* right = column + 1 < columns ? words_[plane][column + 1].data() : nullptr;
+            for (unsigned int y = 0; y < height; y++) {
+                words[y] = (words[y] << 4) | (right != nullptr ? right[y] >> 60 : 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#include "inputlog.h"
+
+#include <fstream>
+#include <ios>
+#include <iostream>
+
+namespace {
+
+    void write_u32(std::ostream& stream, uint32_t value) {
+        for (int byte = 0; byte < 4; byte++) {
+            stream.put(static_cast<char>((value >> (byte * 8)) & 0xff));
+        }
+    }
+
+    uint32_t read_u32(std::istream& stream) {
+        uint32_t value = 0;
+        for (int byte = 0; byte < 4; byte++) {
+            value |= uint32_t(static_cast<uint8_t>(stream.get())) << (byte * 8);
+        }
+        return value;
+    }
+
+    void write_u16(std::ostream& stream, uint16_t value) {
+        stream.put(static_cast<char>(value & 0xff));
+        stream.put(static_cast<char>(value >> 8));
+    }
+
+    uint16_t read_u16(std::istream& stream) {
+        uint16_t value = static_cast<uint8_t>(stream.get());
+        return value | (uint16_t(static_cast<uint8_t>(stream.get())) << 8);
+    }
+
+}
+
+void InputLog::clear() {
+    frames_.clear();
+}
+
+void InputLog::append(const InputFrame& input) {
+    frames_.push_back(input);
+}
+
+void InputLog::truncate(size_t frames) {
+    if (frames < frames_.size()) {
+        frames_.resize(frames);
+    }
+}
+
+size_t InputLog::size() const {
+    return frames_.size();
+}
+
+const InputFrame& InputLog::get_frame(size_t frame) const {
+    return frames_[frame];
+}
+
+void InputLog::set_seed(uint32_t seed) {
+    seed_ = seed;
+}
+
+uint32_t InputLog::get_seed() const {
+    return seed_;
+}
+
+bool InputLog::save(const std::string& file_path) const {
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    write_u32(file, INPUT_LOG_MAGIC);
+    write_u32(file, INPUT_LOG_VERSION);
+    write_u32(file, seed_);
+    write_u32(file, static_cast<uint32_t>(frames_.size()));
+    for (const InputFrame& input : frames_) {
+        write_u16(file, input.keys);
+        write_u16(file, input.released);
+    }
+    if (!file) {
+        std::cout << "Error: could not write input log to " << file_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool InputLog::load(const std::string& file_path) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file) {
+        std::cout << "Error: could not find input log file " << file_path << std::endl;
+        return false;
+    }
+
+    if (read_u32(file) != INPUT_LOG_MAGIC) {
+        std::cout << "Error: " << file_path << " is not an input log" << std::endl;
+        return false;
+    }
+    uint32_t version = read_u32(file);
+    if (version != INPUT_LOG_VERSION) {
+        std::cout << "Error: " << file_path << " is a version " << version << " input log, expected version " << INPUT_LOG_VERSION << std::endl;
+        return false;
+    }
+    uint32_t seed = read_u32(file);
+    uint32_t count = read_u32(file);
+
+    // the frames must all be in the file before they are allocated, as a corrupt count could ask for gigabytes
+    std::streampos frames_start = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff frame_bytes = file.tellg() - frames_start;
+    file.seekg(frames_start);
+    if (!file || frame_bytes < static_cast<std::streamoff>(count) * INPUT_FRAME_BYTES) {
+        std::cout << "Error: " << file_path << " is truncated" << std::endl;
+        return false;
+    }
+
+    std::vector<InputFrame> frames(count);
+    for (InputFrame& input : frames) {
+        input.keys = read_u16(file);
+        input.released = read_u16(file);
+    }
+    if (!file) {
+        std::cout << "Error: " << file_path << " is truncated" << std::endl;
+        return false;
+    }
+
+    seed_ = seed;
+    frames_ = std::move(frames);
+    return true;
+}
@@ -0,0 +1,502 @@
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "jit.h"
+
+namespace {
+
+// x86-64 register numbers
+enum : uint8_t { RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// block arguments (System V calling convention): rdi points at V0-VF, rsi at the index register.
+// rax and rcx are scratch, and rax holds the returned pc.
+// V registers are given host registers from this pool, caller saved ones first so that small blocks don't save anything
+const std::array<uint8_t, 11> register_pool = {RDX, R8, R9, R10, R11, RBX, RBP, R12, R13, R14, R15};
+
+bool is_callee_saved(uint8_t reg) {
+    return reg == RBX || reg == RBP || reg >= R12;
+}
+
+// condition codes, for cmovcc / setcc
+enum : uint8_t { CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6 };
+
+// opcodes of the two operand alu instructions (op r/m32, r32) and the /digit of their immediate forms (op r/m32, imm32)
+enum : uint8_t { ALU_ADD = 0x01, ALU_OR = 0x09, ALU_AND = 0x21, ALU_SUB = 0x29, ALU_XOR = 0x31, ALU_CMP = 0x39, ALU_MOV = 0x89 };
+enum : uint8_t { IMM_ADD = 0, IMM_AND = 4, IMM_CMP = 7, SHIFT_LEFT = 4, SHIFT_RIGHT = 5 };
+
+// just enough of an x86-64 assembler for the instructions the JIT emits. all register operations are 32 bit
+class Assembler {
+    public:
+        const uint8_t* data() const { return buffer_.data(); }
+        size_t size() const { return size_; }
+
+        void mov_imm(uint8_t dst, uint32_t imm) {
+            rex(0, dst);
+            byte(0xb8 + (dst & 7));
+            imm32(imm);
+        }
+        // op dst, src
+        void alu(uint8_t opcode, uint8_t dst, uint8_t src) {
+            rex(src, dst);
+            byte(opcode);
+            modrm(3, src, dst);
+        }
+        // op dst, imm
+        void alu_imm(uint8_t digit, uint8_t dst, uint32_t imm) {
+            rex(0, dst);
+            byte(0x81);
+            modrm(3, digit, dst);
+            imm32(imm);
+        }
+        void shift_imm(uint8_t digit, uint8_t dst, uint8_t amount) {
+            rex(0, dst);
+            byte(0xc1);
+            modrm(3, digit, dst);
+            byte(amount);
+        }
+        // cmovcc dst, src
+        void cmov(uint8_t condition, uint8_t dst, uint8_t src) {
+            rex(dst, src);
+            byte(0x0f);
+            byte(0x40 + condition);
+            modrm(3, dst, src);
+        }
+        // setcc then zero extend, dst = condition ? 1 : 0. dst must be rax or rcx
+        void set(uint8_t condition, uint8_t dst) {
+            byte(0x0f);
+            byte(0x90 + condition);
+            modrm(3, 0, dst);
+            byte(0x0f);
+            byte(0xb6);
+            modrm(3, dst, dst);
+        }
+        // movzx dst, byte [base + disp]
+        void load_byte(uint8_t dst, uint8_t base, uint8_t disp) {
+            rex(dst, base);
+            byte(0x0f);
+            byte(0xb6);
+            modrm(1, dst, base);
+            byte(disp);
+        }
+        // mov byte [base + disp], src. always has a REX prefix so that the low byte of rsi / rdi / rbp can be used
+        void store_byte(uint8_t base, uint8_t disp, uint8_t src) {
+            byte(0x40 | ((src >> 3) << 2) | (base >> 3));
+            byte(0x88);
+            modrm(1, src, base);
+            byte(disp);
+        }
+        // movzx dst, word [base]
+        void load_word(uint8_t dst, uint8_t base) {
+            rex(dst, base);
+            byte(0x0f);
+            byte(0xb7);
+            modrm(0, dst, base);
+        }
+        // mov word [base], src
+        void store_word(uint8_t base, uint8_t src) {
+            byte(0x66);
+            rex(src, base);
+            byte(0x89);
+            modrm(0, src, base);
+        }
+        // mov word [base], imm
+        void store_word_imm(uint8_t base, uint16_t imm) {
+            byte(0x66);
+            rex(0, base);
+            byte(0xc7);
+            modrm(0, 0, base);
+            byte(imm & 0xff);
+            byte(imm >> 8);
+        }
+        void push(uint8_t reg) {
+            rex(0, reg);
+            byte(0x50 + (reg & 7));
+        }
+        void pop(uint8_t reg) {
+            rex(0, reg);
+            byte(0x58 + (reg & 7));
+        }
+        void ret() {
+            byte(0xc3);
+        }
+
+    private:
+        void rex(uint8_t reg, uint8_t rm) {
+            uint8_t bits = ((reg >> 3) << 2) | (rm >> 3);
+            if (bits != 0) {
+                byte(0x40 | bits);
+            }
+        }
+        void modrm(uint8_t mod, uint8_t reg, uint8_t rm) {
+            byte((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+        }
+        void imm32(uint32_t imm) {
+            for (int i = 0; i < 4; i++) {
+                byte(imm >> (8 * i));
+            }
+        }
+        void byte(uint8_t b) {
+            buffer_[size_++] = b;
+        }
+
+    private:
+        // worst case block: prologue / epilogue of ~200 bytes plus ~30 bytes per instruction
+        std::array<uint8_t, 2048> buffer_{};
+        size_t size_ = 0;
+};
+
+enum class Kind { unsupported, straight, jump, skip };
+
+Kind classify(uint16_t instruction) {
+    switch (instruction & 0xf000) {
+        case 0x1000:
+            return Kind::jump;
+        case 0x3000:
+        case 0x4000:
+        case 0x9000:
+            return Kind::skip;
+        case 0x5000:
+            // 5XY2 / 5XY3 (XO-CHIP register save / load) access memory
+            if ((instruction & 0x000f) == 0x2 || (instruction & 0x000f) == 0x3) {
+                return Kind::unsupported;
+            }
+            return Kind::skip;
+        case 0x6000:
+        case 0x7000:
+        case 0xa000:
+            return Kind::straight;
+        case 0x8000:
+            switch (instruction & 0x000f) {
+                case 0x0: case 0x1: case 0x2: case 0x3: case 0x4: case 0x5: case 0x6: case 0x7: case 0xe:
+                    return Kind::straight;
+            }
+            return Kind::unsupported;
+        case 0xf000:
+            if ((instruction & 0x00ff) == 0x1e) {
+                return Kind::straight;
+            }
+            return Kind::unsupported;
+    }
+    return Kind::unsupported;
+}
+
+// bitmask of the V registers an instruction reads or writes
+uint16_t registers_used(uint16_t instruction) {
+    uint16_t x = 1 << ((instruction & 0x0f00) >> 8);
+    uint16_t y = 1 << ((instruction & 0x00f0) >> 4);
+    uint16_t f = 1 << 0xf;
+    switch (instruction & 0xf000) {
+        case 0x3000:
+        case 0x4000:
+        case 0x6000:
+        case 0x7000:
+        case 0xf000:
+            return x;
+        case 0x5000:
+        case 0x9000:
+            return x | y;
+        case 0x8000:
+            if ((instruction & 0x000f) <= 0x3) {
+                return x | y;
+            }
+            return x | y | f;
+    }
+    return 0;
+}
+
+}
+
+Jit::Jit() {}
+
+Jit::~Jit() {
+    if (code_ != nullptr) {
+        munmap(code_, JIT_CODE_SIZE);
+    }
+}
+
+bool Jit::initialize() {
+    // only map the executable memory (and allocate a block per address) once the JIT is actually used, as most cpus
+    // never enable it
+    if (code_ == nullptr) {
+        void* code = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code != MAP_FAILED) {
+            code_ = static_cast<uint8_t*>(code);
+            blocks_.resize(MEMORY_SIZE);
+        }
+    }
+    return code_ != nullptr;
+}
+
+const Block& Jit::get_block(Memory* memory, uint16_t pc) {
+    Block& block = blocks_[pc & (MEMORY_SIZE - 1)];
+    if (!block.compiled) {
+        compile(memory, pc & (MEMORY_SIZE - 1), block);
+    }
+    return block;
+}
+
+void Jit::invalidate(int memory_loc, int length) {
+    // a block can start up to two bytes per instruction before the write and still overlap it, plus two more as a
+    // block ending in a skip also depends on the instruction after it (whether it is a 4 byte F000 NNNN)
+    if (blocks_.empty()) {
+        return;
+    }
+    int first = std::max(memory_loc - 2 * JIT_MAX_BLOCK_INSTRUCTIONS - 1, 0);
+    int last = std::min(memory_loc + length, MEMORY_SIZE);
+    for (int start = first; start < last; start++) {
+        Block& block = blocks_[start];
+        if (!block.compiled) {
+            continue;
+        }
+        // uncompilable addresses depend on the instruction there too, which may now be one the JIT handles
+        int span = block.code != nullptr ? 2 * block.length + 2 : 2;
+        if (start + span > memory_loc) {
+            block = Block{};
+        }
+    }
+}
+
+void Jit::set_quirks(QuirkProfile profile) {
+    with_quirks(profile, [this](auto quirks) {
+        using Quirks = decltype(quirks);
+        if (Quirks::shift_vx != shift_vx_ || Quirks::long_skip != long_skip_) {
+            shift_vx_ = Quirks::shift_vx;
+            long_skip_ = Quirks::long_skip;
+            flush();
+        }
+    });
+}
+
+void Jit::flush() {
+    std::fill(blocks_.begin(), blocks_.end(), Block{});
+    code_used_ = 0;
+}
+
+void Jit::compile(Memory* memory, uint16_t pc, Block& block) {
+    block.compiled = true;
+    block.code = nullptr;
+    if (code_ == nullptr) {
+        return;
+    }
+
+    // first pass: find where the block ends, and give every V register it uses a host register
+    std::array<uint16_t, JIT_MAX_BLOCK_INSTRUCTIONS> instructions{};
+    std::array<uint8_t, 16> host{}; // host register of each allocated V register
+    uint16_t allocated = 0; // bitmask of the V registers with a host register
+    size_t pool_used = 0;
+    int length = 0;
+    Kind last_kind = Kind::straight;
+
+    for (uint32_t address = pc; length < JIT_MAX_BLOCK_INSTRUCTIONS && address + 1 < MEMORY_SIZE; address += 2) {
+        uint16_t instruction = (memory->get_from_memory(address) << 8) | memory->get_from_memory(address + 1);
+        Kind kind = classify(instruction);
+        if (kind == Kind::unsupported) {
+            break;
+        }
+
+        // end the block here if the instruction needs more host registers than are left
+        uint16_t needed = registers_used(instruction) & ~allocated;
+        if (pool_used + std::popcount(needed) > register_pool.size()) {
+            break;
+        }
+        for (int v = 0; v < 16; v++) {
+            if (needed & (1 << v)) {
+                host[v] = register_pool[pool_used++];
+                allocated |= 1 << v;
+            }
+        }
+
+        instructions[length++] = instruction;
+        last_kind = kind;
+        if (kind != Kind::straight) {
+            break;
+        }
+    }
+
+    if (length == 0) {
+        // the block would start with an instruction left to the interpreter
+        return;
+    }
+
+    // second pass: emit the block
+    Assembler assembler;
+    uint16_t dirty = 0; // bitmask of the V registers written by the block
+
+    for (size_t i = 0; i < pool_used; i++) {
+        if (is_callee_saved(register_pool[i])) {
+            assembler.push(register_pool[i]);
+        }
+    }
+    for (int v = 0; v < 16; v++) {
+        if (allocated & (1 << v)) {
+            assembler.load_byte(host[v], RDI, v);
+        }
+    }
+
+    for (int k = 0; k < length; k++) {
+        uint16_t instruction = instructions[k];
+        uint16_t address = pc + 2 * k;
+        uint8_t x = (instruction & 0x0f00) >> 8;
+        uint8_t y = (instruction & 0x00f0) >> 4;
+        uint8_t nn = instruction & 0x00ff;
+        uint16_t nnn = instruction & 0x0fff;
+        uint8_t rx = host[x];
+        uint8_t ry = host[y];
+        uint8_t rf = host[0xf];
+
+        switch (instruction & 0xf000) {
+            case 0x1000:
+                assembler.mov_imm(RAX, nnn);
+                break;
+            case 0x3000:
+            case 0x4000:
+            case 0x5000:
+            case 0x9000:
+                {
+                    // pc = condition ? address + 4 : address + 2
+                    uint16_t opcode = instruction & 0xf000;
+                    if (opcode == 0x3000 || opcode == 0x4000) {
+                        assembler.alu_imm(IMM_CMP, rx, nn);
+                    }
+                    else {
+                        assembler.alu(ALU_CMP, rx, ry);
+                    }
+                    // XO-CHIP skips both words of an F000 NNNN (read now, so invalidate treats the block as two bytes longer)
+                    uint16_t next = (memory->get_from_memory(address + 2) << 8) | memory->get_from_memory(address + 3);
+                    uint16_t skipped = address + ((long_skip_ && next == 0xf000) ? 6 : 4);
+                    assembler.mov_imm(RAX, static_cast<uint16_t>(address + 2));
+                    assembler.mov_imm(RCX, skipped);
+                    assembler.cmov((opcode == 0x3000 || opcode == 0x5000) ? CC_E : CC_NE, RAX, RCX);
+                }
+                break;
+            case 0x6000:
+                assembler.mov_imm(rx, nn);
+                dirty |= 1 << x;
+                break;
+            case 0x7000:
+                assembler.alu_imm(IMM_ADD, rx, nn);
+                assembler.alu_imm(IMM_AND, rx, 0xff);
+                dirty |= 1 << x;
+                break;
+            case 0x8000:
+                // the flag is written before VX, so VX wins when X is F, as in the interpreter
+                switch (instruction & 0x000f) {
+                    case 0x0:
+                        assembler.alu(ALU_MOV, rx, ry);
+                        break;
+                    case 0x1:
+                        assembler.alu(ALU_OR, rx, ry);
+                        break;
+                    case 0x2:
+                        assembler.alu(ALU_AND, rx, ry);
+                        break;
+                    case 0x3:
+                        assembler.alu(ALU_XOR, rx, ry);
+                        break;
+                    case 0x4:
+                        // vf = carry out of vx + vy
+                        assembler.alu(ALU_MOV, RAX, rx);
+                        assembler.alu(ALU_ADD, RAX, ry);
+                        assembler.alu(ALU_MOV, RCX, RAX);
+                        assembler.shift_imm(SHIFT_RIGHT, RCX, 8);
+                        assembler.alu_imm(IMM_AND, RAX, 0xff);
+                        assembler.alu(ALU_MOV, rf, RCX);
+                        assembler.alu(ALU_MOV, rx, RAX);
+                        break;
+                    case 0x5:
+                        // vf = vx <= vy ? 1 : 0, vx = vx - vy
+                        assembler.alu(ALU_MOV, RAX, rx);
+                        assembler.alu(ALU_CMP, RAX, ry);
+                        assembler.set(CC_BE, RCX);
+                        assembler.alu(ALU_SUB, RAX, ry);
+                        assembler.alu_imm(IMM_AND, RAX, 0xff);
+                        assembler.alu(ALU_MOV, rf, RCX);
+                        assembler.alu(ALU_MOV, rx, RAX);
+                        break;
+                    case 0x6:
+                        // vf = lowest bit of vy, vx = vy >> 1 (or of vx in place, with the SUPER-CHIP quirk)
+                        assembler.alu(ALU_MOV, RAX, shift_vx_ ? rx : ry);
+                        assembler.alu(ALU_MOV, RCX, RAX);
+                        assembler.alu_imm(IMM_AND, RCX, 1);
+                        assembler.shift_imm(SHIFT_RIGHT, RAX, 1);
+                        assembler.alu(ALU_MOV, rf, RCX);
+                        assembler.alu(ALU_MOV, rx, RAX);
+                        break;
+                    case 0x7:
+                        // vf = vy <= vx ? 1 : 0, vx = vy - vx
+                        assembler.alu(ALU_MOV, RAX, ry);
+                        assembler.alu(ALU_CMP, RAX, rx);
+                        assembler.set(CC_BE, RCX);
+                        assembler.alu(ALU_SUB, RAX, rx);
+                        assembler.alu_imm(IMM_AND, RAX, 0xff);
+                        assembler.alu(ALU_MOV, rf, RCX);
+                        assembler.alu(ALU_MOV, rx, RAX);
+                        break;
+                    case 0xe:
+                        // vf = highest bit of vy, vx = vy << 1
+                        assembler.alu(ALU_MOV, RAX, shift_vx_ ? rx : ry);
+                        assembler.alu(ALU_MOV, RCX, RAX);
+                        assembler.shift_imm(SHIFT_RIGHT, RCX, 7);
+                        assembler.shift_imm(SHIFT_LEFT, RAX, 1);
+                        assembler.alu_imm(IMM_AND, RAX, 0xff);
+                        assembler.alu(ALU_MOV, rf, RCX);
+                        assembler.alu(ALU_MOV, rx, RAX);
+                        break;
+                }
+                dirty |= 1 << x;
+                if ((instruction & 0x000f) >= 0x4) {
+                    dirty |= 1 << 0xf;
+                }
+                break;
+            case 0xa000:
+                assembler.store_word_imm(RSI, nnn);
+                break;
+            case 0xf000:
+                // FX1E: I += VX, wrapping at 16 bits
+                assembler.load_word(RCX, RSI);
+                assembler.alu(ALU_ADD, RCX, rx);
+                assembler.store_word(RSI, RCX);
+                break;
+        }
+    }
+
+    if (last_kind == Kind::straight) {
+        // fall through to the instruction after the block
+        assembler.mov_imm(RAX, static_cast<uint16_t>(pc + 2 * length));
+    }
+
+    // write back the V registers the block changed, then return the next pc in rax
+    for (int v = 0; v < 16; v++) {
+        if (dirty & (1 << v)) {
+            assembler.store_byte(RDI, v, host[v]);
+        }
+    }
+    for (size_t i = pool_used; i-- > 0;) {
+        if (is_callee_saved(register_pool[i])) {
+            assembler.pop(register_pool[i]);
+        }
+    }
+    assembler.ret();
+
+    // copy into executable memory, which is only writable while the copy is made
+    size_t size = (assembler.size() + 15) & ~size_t(15);
+    if (code_used_ + size > JIT_CODE_SIZE) {
+        flush();
+        block.compiled = true;
+    }
+    if (mprotect(code_, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        return;
+    }
+    std::memcpy(code_ + code_used_, assembler.data(), assembler.size());
+    mprotect(code_, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+
+    block.code = reinterpret_cast<BlockFunction>(code_ + code_used_);
+    block.length = length;
+    code_used_ += size;
+}
@@ -0,0 +1,87 @@
+#include <SDL2/SDL.h>
+#include <SDL_events.h>
+#include <SDL_keyboard.h>
+#include <cstdint>
+
+#include "keyboard.h"
+
+Keyboard::Keyboard() {
+    // flip the hex to scancode table, so that each event is a single lookup
+    scancode_to_hex_.fill(-1);
+    for (uint8_t key = 0; key < hex_to_scancode.size(); key++) {
+        scancode_to_hex_[hex_to_scancode[key]] = key;
+    }
+}
+
+bool Keyboard::poll_events() {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        switch (event.type) {
+            case SDL_QUIT:
+                return false;
+            case SDL_KEYDOWN:
+                {
+                    SDL_Scancode scancode = event.key.keysym.scancode;
+                    if (scancode == SDL_SCANCODE_F10 && !event.key.repeat) {
+                        profile_requested_ = true;
+                    }
+                    else if (scancode == SDL_SCANCODE_BACKSPACE) {
+                        rewind_held_ = true;
+                    }
+                    else if (scancode < SDL_NUM_SCANCODES && scancode_to_hex_[scancode] >= 0) {
+                        keys_ |= 1 << scancode_to_hex_[scancode];
+                    }
+                }
+                break;
+            case SDL_KEYUP:
+                {
+                    SDL_Scancode scancode = event.key.keysym.scancode;
+                    if (scancode == SDL_SCANCODE_BACKSPACE) {
+                        rewind_held_ = false;
+                    }
+                    else if (scancode < SDL_NUM_SCANCODES && scancode_to_hex_[scancode] >= 0) {
+                        // remember the released key until the cpu asks for it
+                        keys_ &= ~(1 << scancode_to_hex_[scancode]);
+                        released_keys_ |= 1 << scancode_to_hex_[scancode];
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+bool Keyboard::is_key_pressed(uint8_t key) {
+    return (keys_ >> (key & 0xf)) & 1;
+}
+
+bool Keyboard::get_key_released(uint8_t& key) {
+    if (released_keys_ == 0) {
+        return false;
+    }
+    key = __builtin_ctz(released_keys_);
+    released_keys_ &= released_keys_ - 1;
+    return true;
+}
+
+uint16_t Keyboard::get_keys() {
+    return keys_;
+}
+
+uint16_t Keyboard::take_released_keys() {
+    uint16_t released = released_keys_;
+    released_keys_ = 0;
+    return released;
+}
+
+bool Keyboard::take_profile_request() {
+    bool requested = profile_requested_;
+    profile_requested_ = false;
+    return requested;
+}
+
+bool Keyboard::is_rewind_held() {
+    return rewind_held_;
+}
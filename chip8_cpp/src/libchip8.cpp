@@ -0,0 +1,302 @@
+#include "libchip8.h"
+
+#include <algorithm>
+#include <exception>
+#include <new>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "framebuffer.h"
+#include "headless.h"
+#include "inputlog.h"
+#include "memory.h"
+#include "quirks.h"
+#include "rom.h"
+#include "savestate.h"
+#include "vectorenv.h"
+
+// the header is plain C, so its sizes are spelled out rather than taken from the core's headers
+static_assert(CHIP8_MEMORY_SIZE == MEMORY_SIZE && CHIP8_ROM_START == ROM_START && CHIP8_MAX_ROM_SIZE == MAX_ROM_SIZE);
+static_assert(CHIP8_SCREEN_WIDTH == SCREEN_WIDTH && CHIP8_SCREEN_HEIGHT == SCREEN_HEIGHT && CHIP8_ROW_WORDS == ROW_WORDS
+              && CHIP8_PLANE_COUNT == PLANE_COUNT);
+static_assert(CHIP8_QUIRKS_CHIP8 == static_cast<int>(QuirkProfile::chip8) && CHIP8_QUIRKS_VIP == static_cast<int>(QuirkProfile::vip)
+              && CHIP8_QUIRKS_SCHIP == static_cast<int>(QuirkProfile::schip) && CHIP8_QUIRKS_XOCHIP == static_cast<int>(QuirkProfile::xochip)
+              && QUIRK_PROFILE_COUNT == 4);
+static_assert(CHIP8_OBSERVATION_WIDTH == OBSERVATION_WIDTH && CHIP8_OBSERVATION_HEIGHT == OBSERVATION_HEIGHT);
+
+// a headless machine, as in chip8bench, plus what the C API keeps between calls. allocated once by chip8_create, and
+// never reallocated, so the views handed out stay put
+struct chip8 {
+    Memory memory;
+    Framebuffer framebuffer;
+    NullAudio audio;
+    CPU cpu{&memory, &framebuffer, &audio};
+
+    SaveState power_on; // the machine as constructed, restored on every load / reset
+    Rom rom;
+    uint32_t seed = DEFAULT_RANDOM_SEED;
+    int instructions_per_frame = DEFAULT_INSTRUCTIONS_PER_FRAME;
+    uint64_t frame_count = 0;
+    InputFrame input; // keys to latch at the start of the next step or frame
+
+    chip8() {
+        cpu.save_state(power_on);
+    }
+
+    void reset() {
+        cpu.load_state(power_on);
+        cpu.set_seed(seed);
+        memory.load_ROM(rom);
+        frame_count = 0;
+        input.released = 0;
+    }
+
+    void latch_input() {
+        cpu.set_input(input);
+        input.released = 0;
+    }
+};
+
+int chip8_get_api_version(void) {
+    return CHIP8_API_VERSION;
+}
+
+chip8_t* chip8_create(void) {
+    // no exceptions across the C boundary
+    try {
+        return new chip8();
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void chip8_destroy(chip8_t* chip8) {
+    delete chip8;
+}
+
+// the same checks as read_rom, without its messages. rom is left as it was on an error
+static int copy_rom(const uint8_t* data, size_t size, Rom& rom) {
+    if (data == nullptr && size != 0) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    if (size == 0) {
+        return CHIP8_ERROR_ROM_EMPTY;
+    }
+    if (size > MAX_ROM_SIZE) {
+        return CHIP8_ERROR_ROM_TOO_BIG;
+    }
+    std::copy(data, data + size, rom.data.begin());
+    std::fill(rom.data.begin() + size, rom.data.end(), 0);
+    rom.size = size;
+    rom.hash = hash_rom(data, size);
+    return CHIP8_OK;
+}
+
+int chip8_load_rom(chip8_t* chip8, const uint8_t* data, size_t size) {
+    if (chip8 == nullptr) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    int result = copy_rom(data, size, chip8->rom);
+    if (result == CHIP8_OK) {
+        chip8->reset();
+    }
+    return result;
+}
+
+int chip8_reset(chip8_t* chip8) {
+    if (chip8 == nullptr) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    if (chip8->rom.size == 0) {
+        return CHIP8_ERROR_NO_ROM;
+    }
+    chip8->reset();
+    return CHIP8_OK;
+}
+
+int chip8_set_quirks(chip8_t* chip8, int quirks) {
+    if (chip8 == nullptr || quirks < 0 || quirks >= QUIRK_PROFILE_COUNT) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    chip8->cpu.set_quirks(static_cast<QuirkProfile>(quirks));
+    return CHIP8_OK;
+}
+
+int chip8_set_instructions_per_frame(chip8_t* chip8, int instructions_per_frame) {
+    if (chip8 == nullptr || instructions_per_frame <= 0) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    chip8->instructions_per_frame = instructions_per_frame;
+    return CHIP8_OK;
+}
+
+void chip8_set_seed(chip8_t* chip8, uint32_t seed) {
+    chip8->seed = seed;
+    chip8->cpu.set_seed(seed);
+}
+
+void chip8_set_keys(chip8_t* chip8, uint16_t keys) {
+    chip8->input.released |= chip8->input.keys & ~keys;
+    chip8->input.keys = keys;
+}
+
+void chip8_step(chip8_t* chip8, int instructions) {
+    chip8->latch_input();
+    chip8->cpu.run_cycles(instructions);
+}
+
+void chip8_run_frames(chip8_t* chip8, int frames) {
+    for (int frame = 0; frame < frames; frame++) {
+        chip8->latch_input();
+        chip8->cpu.run_cycles(chip8->instructions_per_frame);
+        chip8->cpu.decrement_timer();
+        chip8->frame_count++;
+    }
+}
+
+const uint8_t* chip8_get_memory(const chip8_t* chip8) {
+    return chip8->memory.get_contents();
+}
+
+const uint64_t* chip8_get_framebuffer(const chip8_t* chip8) {
+    return chip8->framebuffer.get_words();
+}
+
+int chip8_get_width(const chip8_t* chip8) {
+    return chip8->framebuffer.get_width();
+}
+
+int chip8_get_height(const chip8_t* chip8) {
+    return chip8->framebuffer.get_height();
+}
+
+void chip8_get_registers(const chip8_t* chip8, chip8_registers_t* registers) {
+    Registers current = chip8->cpu.get_registers();
+    registers->pc = current.pc;
+    registers->i = current.i;
+    std::copy(current.v.begin(), current.v.end(), registers->v);
+    registers->delay_timer = current.delay_timer;
+    registers->sound_timer = current.sound_timer;
+}
+
+uint64_t chip8_get_frame_count(const chip8_t* chip8) {
+    return chip8->frame_count;
+}
+
+int chip8_is_waiting_for_key(const chip8_t* chip8) {
+    return chip8->cpu.is_waiting_for_key();
+}
+
+int chip8_is_stopped(const chip8_t* chip8) {
+    return chip8->cpu.is_stopped();
+}
+
+// a VectorEnv, and the C done function (which returns an int rather than a bool) it calls through done_adapter
+struct chip8_vector_env {
+    VectorEnv env;
+    Rom rom;
+    chip8_done_function done = nullptr;
+    void* done_context = nullptr;
+
+    chip8_vector_env(int instances, int threads) : env(instances, threads) {}
+
+    static bool done_adapter(int instance, const uint8_t* memory, void* context) {
+        chip8_vector_env* self = static_cast<chip8_vector_env*>(context);
+        return self->done(instance, memory, self->done_context) != 0;
+    }
+};
+
+chip8_vector_env_t* chip8_vector_env_create(int instances, int threads) {
+    if (instances <= 0 || threads <= 0) {
+        return nullptr;
+    }
+    try {
+        return new chip8_vector_env(instances, threads);
+    }
+    catch (const std::exception&) {
+        return nullptr; // out of memory, or out of threads
+    }
+}
+
+void chip8_vector_env_destroy(chip8_vector_env_t* env) {
+    delete env;
+}
+
+int chip8_vector_env_load_rom(chip8_vector_env_t* env, const uint8_t* data, size_t size) {
+    if (env == nullptr) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    int result = copy_rom(data, size, env->rom);
+    if (result == CHIP8_OK) {
+        env->env.load_ROM(env->rom);
+    }
+    return result;
+}
+
+int chip8_vector_env_set_quirks(chip8_vector_env_t* env, int quirks) {
+    if (env == nullptr || quirks < 0 || quirks >= QUIRK_PROFILE_COUNT) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    env->env.set_quirks(static_cast<QuirkProfile>(quirks));
+    return CHIP8_OK;
+}
+
+int chip8_vector_env_set_instructions_per_frame(chip8_vector_env_t* env, int instructions_per_frame) {
+    if (env == nullptr || instructions_per_frame <= 0) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    env->env.set_instructions_per_frame(instructions_per_frame);
+    return CHIP8_OK;
+}
+
+int chip8_vector_env_set_frame_skip(chip8_vector_env_t* env, int frame_skip) {
+    if (env == nullptr || frame_skip <= 0) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    env->env.set_frame_skip(frame_skip);
+    return CHIP8_OK;
+}
+
+void chip8_vector_env_set_reward(chip8_vector_env_t* env, chip8_reward_function reward, void* context) {
+    env->env.set_reward(reward, context);
+}
+
+void chip8_vector_env_set_done(chip8_vector_env_t* env, chip8_done_function done, void* context) {
+    env->done = done;
+    env->done_context = context;
+    env->env.set_done(done != nullptr ? &chip8_vector_env::done_adapter : nullptr, env);
+}
+
+int chip8_vector_env_reset(chip8_vector_env_t* env, const uint32_t* seeds, uint8_t* observations) {
+    if (env == nullptr || seeds == nullptr || observations == nullptr) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    if (env->rom.size == 0) {
+        return CHIP8_ERROR_NO_ROM;
+    }
+    env->env.reset(seeds, observations);
+    return CHIP8_OK;
+}
+
+int chip8_vector_env_step(chip8_vector_env_t* env, const uint16_t* actions, uint8_t* observations, float* rewards, uint8_t* dones) {
+    if (env == nullptr || actions == nullptr || observations == nullptr || rewards == nullptr || dones == nullptr) {
+        return CHIP8_ERROR_INVALID_ARGUMENT;
+    }
+    if (env->rom.size == 0) {
+        return CHIP8_ERROR_NO_ROM;
+    }
+    env->env.step(actions, observations, rewards, dones);
+    return CHIP8_OK;
+}
+
+int chip8_vector_env_get_instance_count(const chip8_vector_env_t* env) {
+    return env->env.get_instance_count();
+}
+
+const uint8_t* chip8_vector_env_get_memory(const chip8_vector_env_t* env, int instance) {
+    if (instance < 0 || instance >= env->env.get_instance_count()) {
+        return nullptr;
+    }
+    return env->env.get_memory(instance);
+}
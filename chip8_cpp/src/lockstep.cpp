@@ -0,0 +1,625 @@
+#include "lockstep.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <utility>
+
+// the vector kernels are built for AVX2 whatever the build targets, and only used if the host has it (see avx2_)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LOCKSTEP_AVX2
+#include <immintrin.h>
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+// the operation of a kernel, on one block of 32 lanes: a holds VX (or the register being written), b VY
+#define VECTOR_OP(...) [&]([[maybe_unused]] __m256i a, [[maybe_unused]] __m256i b) AVX2_TARGET { return __VA_ARGS__; }
+
+// unsigned a > b, as 0xff / 0x00 per byte
+AVX2_TARGET static inline __m256i greater_than(__m256i a, __m256i b) {
+    return _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), b), _mm256_set1_epi8(-1));
+}
+
+// a 0xff / 0x00 mask as the value written to VF, 1 / 0 or 0 / 1
+AVX2_TARGET static inline __m256i flag(__m256i mask) {
+    return _mm256_and_si256(mask, _mm256_set1_epi8(1));
+}
+
+AVX2_TARGET static inline __m256i inverted_flag(__m256i mask) {
+    return _mm256_andnot_si256(mask, _mm256_set1_epi8(1));
+}
+#endif
+
+LockstepEngine::LockstepEngine(int lanes)
+    : lanes_(lanes),
+      padded_lanes_(((lanes + LOCKSTEP_LANE_BLOCK - 1) / LOCKSTEP_LANE_BLOCK) * LOCKSTEP_LANE_BLOCK),
+      pc_(padded_lanes_, 0x200),
+      i_register_(padded_lanes_, 0),
+      var_registers_(16, std::vector<uint8_t>(padded_lanes_, 0)),
+      delay_timer_(padded_lanes_, 0),
+      sound_timer_(padded_lanes_, 0),
+      stack_(size_t(padded_lanes_) * LOCKSTEP_STACK_SIZE, 0),
+      stack_pointer_(padded_lanes_, 0),
+      memory_(size_t(lanes) * MEMORY_SIZE, 0),
+      framebuffers_(padded_lanes_),
+      planes_(padded_lanes_, 1),
+      flags_(size_t(padded_lanes_) * 16, 0),
+      keys_(padded_lanes_, 0),
+      released_key_(padded_lanes_, -1),
+      random_state_(padded_lanes_, 0),
+      opcodes_(padded_lanes_, 0),
+      step_pc_(padded_lanes_, 0),
+      step_key_(padded_lanes_, 0),
+      lane_order_(lanes),
+      mask_(padded_lanes_, 0),
+      block_lanes_(padded_lanes_ / LOCKSTEP_LANE_BLOCK, 0),
+      all_lanes_mask_(padded_lanes_, 0) {
+    std::iota(lane_order_.begin(), lane_order_.end(), 0);
+    std::fill(all_lanes_mask_.begin(), all_lanes_mask_.begin() + lanes_, 0xff);
+    for (int block = 0; block < padded_lanes_; block += LOCKSTEP_LANE_BLOCK) {
+        all_blocks_.push_back(block);
+    }
+    blocks_.reserve(all_blocks_.size());
+#if defined(LOCKSTEP_AVX2)
+    avx2_ = __builtin_cpu_supports("avx2");
+#endif
+
+    // every lane starts with memory as a new Memory has it, i.e. with the font loaded
+    Memory initial;
+    for (int address = 0; address < MEMORY_SIZE; address++) {
+        memory_of(0)[address] = initial.get_from_memory(address);
+    }
+    for (int lane = 1; lane < lanes_; lane++) {
+        std::copy(memory_of(0), memory_of(0) + MEMORY_SIZE, memory_of(lane));
+    }
+
+    for (int lane = 0; lane < lanes_; lane++) {
+        set_seed(lane, DEFAULT_RANDOM_SEED);
+    }
+}
+
+bool LockstepEngine::load_ROM(const std::string& file_path) {
+    Memory rom;
+    if (!rom.load_ROM(file_path)) {
+        return false;
+    }
+    for (int lane = 0; lane < lanes_; lane++) {
+        std::copy(rom.get_contents(), rom.get_contents() + MEMORY_SIZE, memory_of(lane));
+    }
+    return true;
+}
+
+void LockstepEngine::set_input(int lane, const InputFrame& input) {
+    // as CPU::set_input
+    keys_[lane] = input.keys;
+    released_key_[lane] = (input.released != 0) ? __builtin_ctz(input.released) : -1;
+}
+
+void LockstepEngine::set_seed(int lane, uint32_t seed) {
+    Random random(seed);
+    random_state_[lane] = random.get_state();
+}
+
+int LockstepEngine::get_lane_count() const {
+    return lanes_;
+}
+
+Registers LockstepEngine::get_registers(int lane) const {
+    Registers registers;
+    registers.pc = pc_[lane];
+    registers.i = i_register_[lane];
+    for (int index = 0; index < 16; index++) {
+        registers.v[index] = var_registers_[index][lane];
+    }
+    registers.delay_timer = delay_timer_[lane];
+    registers.sound_timer = sound_timer_[lane];
+    return registers;
+}
+
+Framebuffer LockstepEngine::get_framebuffer(int lane) const {
+    return framebuffers_[lane];
+}
+
+uint64_t LockstepEngine::get_vector_lane_steps() const {
+    return vector_lane_steps_;
+}
+
+uint64_t LockstepEngine::get_scalar_lane_steps() const {
+    return scalar_lane_steps_;
+}
+
+uint64_t LockstepEngine::get_random_draws() const {
+    return random_draws_;
+}
+
+void LockstepEngine::run_frame(int instructions_per_frame) {
+    for (int i = 0; i < instructions_per_frame; i++) {
+        step();
+    }
+
+    // 60Hz timer tick for every lane at once: count down, stopping at zero
+    for (std::vector<uint8_t>* timer : {&delay_timer_, &sound_timer_}) {
+        uint8_t* values = timer->data();
+#if defined(__AVX2__)
+        for (int lane = 0; lane < padded_lanes_; lane += LOCKSTEP_LANE_BLOCK) {
+            __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + lane));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + lane), _mm256_subs_epu8(value, _mm256_set1_epi8(1)));
+        }
+#else
+        for (int lane = 0; lane < padded_lanes_; lane++) {
+            values[lane] -= (values[lane] != 0);
+        }
+#endif
+    }
+}
+
+uint16_t LockstepEngine::fetch(int lane) {
+    const uint8_t* memory = memory_of(lane);
+    uint16_t pc = pc_[lane];
+    pc_[lane] = pc + 2;
+    return (memory[pc & (MEMORY_SIZE - 1)] << 8) | memory[(pc + 1) & (MEMORY_SIZE - 1)];
+}
+
+void LockstepEngine::step() {
+    bool converged = true;
+    for (int lane = 0; lane < lanes_; lane++) {
+        step_pc_[lane] = pc_[lane];
+        opcodes_[lane] = fetch(lane);
+        converged = converged && step_pc_[lane] == step_pc_[0] && opcodes_[lane] == opcodes_[0];
+    }
+
+    // usual case: every lane is at the same instruction, so the whole step is one group
+    if (converged) {
+        execute_group(lane_order_.data(), lanes_);
+        return;
+    }
+
+    // otherwise sort the lanes by pc and instruction (the pc alone isn't enough, as lanes may have written different
+    // code to memory), and execute each run of equal lanes as a group. lanes tend to stay in the same order from one
+    // step to the next, so the order from the last step is insertion sorted, which is close to linear
+    for (int lane = 0; lane < lanes_; lane++) {
+        step_key_[lane] = (uint32_t(step_pc_[lane]) << 16) | opcodes_[lane];
+    }
+    for (int index = 1; index < lanes_; index++) {
+        int lane = lane_order_[index];
+        int position = index;
+        while (position > 0 && step_key_[lane_order_[position - 1]] > step_key_[lane]) {
+            lane_order_[position] = lane_order_[position - 1];
+            position--;
+        }
+        lane_order_[position] = lane;
+    }
+
+    int start = 0;
+    while (start < lanes_) {
+        int end = start + 1;
+        while (end < lanes_ && step_key_[lane_order_[end]] == step_key_[lane_order_[start]]) {
+            end++;
+        }
+        execute_group(lane_order_.data() + start, end - start);
+        start = end;
+    }
+}
+
+void LockstepEngine::execute_group(const int* lanes, int count) {
+#if defined(LOCKSTEP_AVX2)
+    // the kernels only go over the blocks the group has lanes in, and a block costs about as much as a few lanes one at a
+    // time, so a group of a few lanes, or one spread thinly over the blocks, runs a lane at a time instead
+    if (avx2_ && count == lanes_) {
+        // every lane, as in most steps: the mask and blocks are always the same
+        group_mask_ = all_lanes_mask_.data();
+        group_blocks_ = &all_blocks_;
+        if (execute_vector(opcodes_[lanes[0]])) {
+            vector_lane_steps_ += count;
+            return;
+        }
+    }
+    else if (avx2_ && count >= LOCKSTEP_VECTOR_MIN_LANES) {
+        group_mask_ = mask_.data();
+        group_blocks_ = &blocks_;
+        for (int index = 0; index < count; index++) {
+            int lane = lanes[index];
+            mask_[lane] = 0xff;
+            if (block_lanes_[lane / LOCKSTEP_LANE_BLOCK]++ == 0) {
+                blocks_.push_back(lane - (lane % LOCKSTEP_LANE_BLOCK));
+            }
+        }
+        bool vectorized = count >= LOCKSTEP_VECTOR_MIN_LANES * int(blocks_.size()) && execute_vector(opcodes_[lanes[0]]);
+        for (int index = 0; index < count; index++) {
+            mask_[lanes[index]] = 0;
+        }
+        for (int block : blocks_) {
+            block_lanes_[block / LOCKSTEP_LANE_BLOCK] = 0;
+        }
+        blocks_.clear();
+        if (vectorized) {
+            vector_lane_steps_ += count;
+            return;
+        }
+    }
+#endif
+
+    for (int index = 0; index < count; index++) {
+        execute_lane(lanes[index], opcodes_[lanes[index]]);
+    }
+    scalar_lane_steps_ += count;
+}
+
+#if defined(LOCKSTEP_AVX2)
+template <typename VectorOp>
+AVX2_TARGET void LockstepEngine::map_register(uint8_t* vx, const uint8_t* vy, VectorOp vector_op) {
+    // vx = op(vx, vy) in the masked lanes
+    for (int lane : *group_blocks_) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vx + lane));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vy + lane));
+        __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group_mask_ + lane));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(vx + lane), _mm256_blendv_epi8(a, vector_op(a, b), mask));
+    }
+}
+
+template <typename VectorOp>
+AVX2_TARGET void LockstepEngine::map_register_with_flag(uint8_t* vx, const uint8_t* vy, VectorOp vector_op) {
+    // as map_register, for the 8XYN instructions which also set VF. the op gives {result, flag}; like on the CPU, both
+    // are worked out from the old VX and VY, and VF is written before VX (so 8FYN leaves the result in VF)
+    uint8_t* vf = var_registers_[0xf].data();
+    for (int lane : *group_blocks_) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vx + lane));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vy + lane));
+        __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group_mask_ + lane));
+        auto [result, carry] = vector_op(a, b);
+        __m256i old_flag = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vf + lane));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(vf + lane), _mm256_blendv_epi8(old_flag, carry, mask));
+        __m256i old_result = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vx + lane));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(vx + lane), _mm256_blendv_epi8(old_result, result, mask));
+    }
+}
+
+template <typename VectorOp>
+AVX2_TARGET void LockstepEngine::skip_if(const uint8_t* vx, const uint8_t* vy, VectorOp vector_op) {
+    // pc += 2 in the masked lanes where the condition on (vx, vy) holds
+    uint16_t* pc = pc_.data();
+    for (int lane : *group_blocks_) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vx + lane));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vy + lane));
+        __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group_mask_ + lane));
+        __m256i skip = _mm256_and_si256(vector_op(a, b), mask);
+        // widen the byte mask to the two vectors of 16 bit pcs covering the same lanes
+        for (int half = 0; half < 2; half++) {
+            __m256i wide_skip = _mm256_cvtepi8_epi16(half == 0 ? _mm256_castsi256_si128(skip) : _mm256_extracti128_si256(skip, 1));
+            __m256i* target = reinterpret_cast<__m256i*>(pc + lane + (half * 16));
+            __m256i value = _mm256_loadu_si256(target);
+            _mm256_storeu_si256(target, _mm256_add_epi16(value, _mm256_and_si256(wide_skip, _mm256_set1_epi16(2))));
+        }
+    }
+}
+
+AVX2_TARGET void LockstepEngine::set_wide(uint16_t* registers, uint16_t value) {
+    // a block of byte lanes is two vectors of 16 bit registers
+    for (int block : *group_blocks_) {
+        for (int lane = block; lane < block + LOCKSTEP_LANE_BLOCK; lane += 16) {
+            __m256i mask = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group_mask_ + lane)));
+            __m256i* target = reinterpret_cast<__m256i*>(registers + lane);
+            _mm256_storeu_si256(target, _mm256_blendv_epi8(_mm256_loadu_si256(target), _mm256_set1_epi16(value), mask));
+        }
+    }
+}
+
+AVX2_TARGET void LockstepEngine::add_wide(uint16_t* registers, const uint8_t* values) {
+    for (int block : *group_blocks_) {
+        for (int lane = block; lane < block + LOCKSTEP_LANE_BLOCK; lane += 16) {
+            __m256i mask = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group_mask_ + lane)));
+            __m256i addend = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + lane)));
+            __m256i* target = reinterpret_cast<__m256i*>(registers + lane);
+            _mm256_storeu_si256(target, _mm256_add_epi16(_mm256_loadu_si256(target), _mm256_and_si256(addend, mask)));
+        }
+    }
+}
+
+AVX2_TARGET bool LockstepEngine::execute_vector(uint16_t opcode) {
+    uint8_t x = (opcode & 0x0f00) >> 8;
+    uint8_t y = (opcode & 0x00f0) >> 4;
+    uint8_t nn = opcode & 0x00ff;
+    uint16_t nnn = opcode & 0x0fff;
+    uint8_t* vx = var_registers_[x].data();
+    uint8_t* vy = var_registers_[y].data();
+
+    switch (opcode & 0xf000) {
+        case 0x0000:
+            if (opcode == 0x00e0) {
+                for (int block : *group_blocks_) {
+                    for (int lane = block; lane < std::min(block + LOCKSTEP_LANE_BLOCK, lanes_); lane++) {
+                        if (group_mask_[lane]) {
+                            framebuffers_[lane].clear(planes_[lane]);
+                        }
+                    }
+                }
+                return true;
+            }
+            // 00EE needs each lane's stack, and the SUPER-CHIP / XO-CHIP 00CN - 00FF work on each lane's screen; anything
+            // else is ignored, as on the CPU
+            return opcode != 0x00ee && (opcode & 0xfff0) != 0x00c0 && (opcode & 0xfff0) != 0x00d0 && opcode < 0x00fb;
+        case 0x1000:
+            set_wide(pc_.data(), nnn);
+            return true;
+        case 0x3000:
+            skip_if(vx, vy, VECTOR_OP(_mm256_cmpeq_epi8(a, _mm256_set1_epi8(nn))));
+            return true;
+        case 0x4000:
+            skip_if(vx, vy, VECTOR_OP(_mm256_xor_si256(_mm256_cmpeq_epi8(a, _mm256_set1_epi8(nn)), _mm256_set1_epi8(-1))));
+            return true;
+        case 0x5000:
+            if ((opcode & 0x000f) == 0x2 || (opcode & 0x000f) == 0x3) {
+                return false; // XO-CHIP register save / load
+            }
+            skip_if(vx, vy, VECTOR_OP(_mm256_cmpeq_epi8(a, b)));
+            return true;
+        case 0x6000:
+            map_register(vx, vy, VECTOR_OP(_mm256_set1_epi8(nn)));
+            return true;
+        case 0x7000:
+            map_register(vx, vy, VECTOR_OP(_mm256_add_epi8(a, _mm256_set1_epi8(nn))));
+            return true;
+        case 0x8000:
+            switch (opcode & 0x000f) {
+                case 0x0:
+                    map_register(vx, vy, VECTOR_OP(b));
+                    return true;
+                case 0x1:
+                    map_register(vx, vy, VECTOR_OP(_mm256_or_si256(a, b)));
+                    return true;
+                case 0x2:
+                    map_register(vx, vy, VECTOR_OP(_mm256_and_si256(a, b)));
+                    return true;
+                case 0x3:
+                    map_register(vx, vy, VECTOR_OP(_mm256_xor_si256(a, b)));
+                    return true;
+                case 0x4:
+                    // carry if the saturating and wrapping sums differ
+                    map_register_with_flag(vx, vy,
+                        VECTOR_OP(std::pair(_mm256_add_epi8(a, b), inverted_flag(_mm256_cmpeq_epi8(_mm256_adds_epu8(a, b), _mm256_add_epi8(a, b))))));
+                    return true;
+                case 0x5:
+                    map_register_with_flag(vx, vy, VECTOR_OP(std::pair(_mm256_sub_epi8(a, b), inverted_flag(greater_than(a, b)))));
+                    return true;
+                case 0x6:
+                    map_register_with_flag(vx, vy,
+                        VECTOR_OP(std::pair(_mm256_and_si256(_mm256_srli_epi16(b, 1), _mm256_set1_epi8(0x7f)), _mm256_and_si256(b, _mm256_set1_epi8(1)))));
+                    return true;
+                case 0x7:
+                    map_register_with_flag(vx, vy, VECTOR_OP(std::pair(_mm256_sub_epi8(b, a), inverted_flag(greater_than(b, a)))));
+                    return true;
+                case 0xe:
+                    map_register_with_flag(vx, vy,
+                        VECTOR_OP(std::pair(_mm256_add_epi8(b, b), flag(greater_than(b, _mm256_set1_epi8(0x7f))))));
+                    return true;
+            }
+            // undefined 8XYN instructions are ignored
+            return true;
+        case 0x9000:
+            skip_if(vx, vy, VECTOR_OP(_mm256_xor_si256(_mm256_cmpeq_epi8(a, b), _mm256_set1_epi8(-1))));
+            return true;
+        case 0xa000:
+            set_wide(i_register_.data(), nnn);
+            return true;
+        case 0xf000:
+            switch (nn) {
+                case 0x07:
+                    map_register(vx, delay_timer_.data(), VECTOR_OP(b));
+                    return true;
+                case 0x15:
+                    map_register(delay_timer_.data(), vx, VECTOR_OP(b));
+                    return true;
+                case 0x18:
+                    map_register(sound_timer_.data(), vx, VECTOR_OP(b));
+                    return true;
+                case 0x1e:
+                    add_wide(i_register_.data(), vx);
+                    return true;
+            }
+            return false;
+    }
+
+    // memory, stack, display, keypad and random number instructions
+    return false;
+}
+#endif
+
+void LockstepEngine::execute_lane(int lane, uint16_t opcode) {
+    uint8_t x = (opcode & 0x0f00) >> 8;
+    uint8_t y = (opcode & 0x00f0) >> 4;
+    uint8_t n = opcode & 0x000f;
+    uint8_t nn = opcode & 0x00ff;
+    uint16_t nnn = opcode & 0x0fff;
+    uint8_t& vx = var_registers_[x][lane];
+    uint8_t& vy = var_registers_[y][lane];
+    uint8_t& vf = var_registers_[0xf][lane];
+    uint16_t& pc = pc_[lane];
+    uint16_t& i = i_register_[lane];
+    uint8_t* memory = memory_of(lane);
+    uint16_t* stack = stack_.data() + (size_t(lane) * LOCKSTEP_STACK_SIZE);
+    uint8_t& sp = stack_pointer_[lane];
+    Framebuffer& framebuffer = framebuffers_[lane];
+    uint8_t& planes = planes_[lane];
+    uint8_t* flags = flags_.data() + (size_t(lane) * 16);
+
+    // one lane's CPU::op_* handlers, over the structure-of-arrays state. addresses wrap at the end of memory, and a lane
+    // whose stack over / underflows stays on that 2NNN / 00EE, as the CPU does
+    switch (opcode & 0xf000) {
+        case 0x0000:
+            if (opcode == 0x00e0) {
+                framebuffer.clear(planes);
+            }
+            else if ((opcode & 0xfff0) == 0x00c0) {
+                framebuffer.scroll_down(n, planes);
+            }
+            else if ((opcode & 0xfff0) == 0x00d0) {
+                framebuffer.scroll_up(n, planes);
+            }
+            else if (opcode == 0x00fb) {
+                framebuffer.scroll_right(planes);
+            }
+            else if (opcode == 0x00fc) {
+                framebuffer.scroll_left(planes);
+            }
+            else if (opcode == 0x00fd) {
+                pc -= 2;
+            }
+            else if (opcode == 0x00fe || opcode == 0x00ff) {
+                framebuffer.set_hires(opcode == 0x00ff);
+            }
+            else if (opcode == 0x00ee) {
+                if (sp == 0) {
+                    pc -= 2;
+                    break;
+                }
+                sp--;
+                pc = stack[sp];
+            }
+            break;
+        case 0x1000:
+            pc = nnn;
+            break;
+        case 0x2000:
+            if (sp == LOCKSTEP_STACK_SIZE) {
+                pc -= 2;
+                break;
+            }
+            stack[sp] = pc;
+            sp++;
+            pc = nnn;
+            break;
+        case 0x3000:
+            pc += (vx == nn) ? 2 : 0;
+            break;
+        case 0x4000:
+            pc += (vx != nn) ? 2 : 0;
+            break;
+        case 0x5000:
+            if (n == 0x2 || n == 0x3) {
+                // XO-CHIP: save / load VX to VY at I, backwards if Y < X
+                int step = (x <= y) ? 1 : -1;
+                for (int offset = 0; offset <= std::abs(y - x); offset++) {
+                    uint8_t& v = var_registers_[x + offset * step][lane];
+                    uint8_t& byte = memory[(i + offset) & (MEMORY_SIZE - 1)];
+                    if (n == 0x2) {
+                        byte = v;
+                    }
+                    else {
+                        v = byte;
+                    }
+                }
+                break;
+            }
+            pc += (vx == vy) ? 2 : 0;
+            break;
+        case 0x6000:
+            vx = nn;
+            break;
+        case 0x7000:
+            vx += nn;
+            break;
+        case 0x8000: {
+            uint8_t a = vx;
+            uint8_t b = vy;
+            switch (n) {
+                case 0x0: vx = b; break;
+                case 0x1: vx = a | b; break;
+                case 0x2: vx = a & b; break;
+                case 0x3: vx = a ^ b; break;
+                case 0x4: vf = (a + b) > 255; vx = a + b; break;
+                case 0x5: vf = (a > b) ? 0 : 1; vx = a - b; break;
+                case 0x6: vf = b & 1; vx = b >> 1; break;
+                case 0x7: vf = (b > a) ? 0 : 1; vx = b - a; break;
+                case 0xe: vf = b >> 7; vx = b << 1; break;
+            }
+            break;
+        }
+        case 0x9000:
+            pc += (vx != vy) ? 2 : 0;
+            break;
+        case 0xa000:
+            i = nnn;
+            break;
+        case 0xb000:
+            pc = var_registers_[0x0][lane] + nnn;
+            break;
+        case 0xc000:
+            vx = nn & Random::next_byte(random_state_[lane]);
+            random_draws_++;
+            break;
+        case 0xd000: {
+            uint8_t sprite[MAX_SPRITE_BYTES];
+            unsigned int bytes = Framebuffer::sprite_bytes(n, planes);
+            for (unsigned int offset = 0; offset < bytes; offset++) {
+                sprite[offset] = memory[(i + offset) & (MEMORY_SIZE - 1)];
+            }
+            bool collision = framebuffer.draw(vx & (framebuffer.get_width() - 1), vy & (framebuffer.get_height() - 1), sprite, n, planes, false);
+            vf = collision ? 1 : 0;
+            break;
+        }
+        case 0xe000:
+            // as on the CPU, the key tested is the register index X
+            if (n == 0xe) {
+                pc += ((keys_[lane] >> x) & 1) ? 2 : 0;
+            }
+            else if (n == 0x1) {
+                pc += ((keys_[lane] >> x) & 1) ? 0 : 2;
+            }
+            break;
+        case 0xf000:
+            switch (nn) {
+                case 0x07: vx = delay_timer_[lane]; break;
+                case 0x15: delay_timer_[lane] = vx; break;
+                case 0x18: sound_timer_[lane] = vx; break;
+                case 0x1e: i += vx; break;
+                case 0x0a:
+                    // a lane waiting for a key just runs FX0A again: the batch is shared, so it can't stop early as the CPU does
+                    if (released_key_[lane] >= 0) {
+                        vx = released_key_[lane];
+                        released_key_[lane] = -1;
+                    }
+                    else {
+                        pc -= 2;
+                    }
+                    break;
+                case 0x29:
+                    i = memory[(5 * vx) & (MEMORY_SIZE - 1)];
+                    break;
+                case 0x33:
+                    memory[(i + 0) & (MEMORY_SIZE - 1)] = (vx / 100) % 10;
+                    memory[(i + 1) & (MEMORY_SIZE - 1)] = (vx / 10) % 10;
+                    memory[(i + 2) & (MEMORY_SIZE - 1)] = vx % 10;
+                    break;
+                case 0x55:
+                    for (int offset = 0; offset <= x; offset++) {
+                        memory[(i + offset) & (MEMORY_SIZE - 1)] = var_registers_[offset][lane];
+                    }
+                    break;
+                case 0x65:
+                    for (int offset = 0; offset <= x; offset++) {
+                        var_registers_[offset][lane] = memory[(i + offset) & (MEMORY_SIZE - 1)];
+                    }
+                    break;
+                case 0x00:
+                    if (x == 0) {
+                        i = (memory[pc & (MEMORY_SIZE - 1)] << 8) | memory[(pc + 1) & (MEMORY_SIZE - 1)];
+                        pc += 2;
+                    }
+                    break;
+                case 0x01: planes = x & ALL_PLANES; break;
+                case 0x30: i = BIG_FONT_START + 10 * (vx & 0xf); break;
+                case 0x75:
+                    for (int offset = 0; offset <= x; offset++) {
+                        flags[offset] = var_registers_[offset][lane];
+                    }
+                    break;
+                case 0x85:
+                    for (int offset = 0; offset <= x; offset++) {
+                        var_registers_[offset][lane] = flags[offset];
+                    }
+                    break;
+                // F002 / FX3A (the audio pattern and pitch) only change what is heard, and lanes have no audio
+            }
+            break;
+    }
+}
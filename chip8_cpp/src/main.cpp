@@ -1,14 +1,171 @@
 #include "chip8.h"
+#include "keyboard.h"
+#include "renderer.h"
+#include "rom.h"
+#include "sound.h"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <string>
+
+void print_usage() {
+    std::cout << "Usage: chip8emulator [--ipf <instructions per frame>] [--turbo] [--jit] [--quirks <chip8|vip|schip|xochip>] [--render-target] [--rewind] [--seed <n>] [--profile [--profile-json <file>]]" <<
+        " [--trace [--trace-file <file>]] [--dump-memory]" <<
+        " [--record-input <file> | --play-input <file>] [--rom-db <file>] <PATH_TO_ROM>" << std::endl;
+}
 
 int main(int argc, char* argv[]) {
+    std::string rom_path;
+    int instructions_per_frame = 0; // 0 until given, so that a known ROM's own clock can be used
+    bool turbo = false;
+    bool jit = false;
+    QuirkProfile quirks = QuirkProfile::chip8;
+    bool quirks_given = false;
+    std::string rom_db_path;
+    RenderMode render_mode = RenderMode::streaming;
+    bool rewind = false;
+    uint32_t seed = DEFAULT_RANDOM_SEED;
+    std::string record_path;
+    std::string play_path;
+    bool profile = false;
+    std::string profile_path = DEFAULT_PROFILE_PATH;
+    bool trace = false;
+    std::string trace_path = DEFAULT_TRACE_PATH;
+    bool dump_memory = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+            instructions_per_frame = std::atoi(argv[++i]);
+            if (instructions_per_frame <= 0) {
+                std::cout << "Instructions per frame must be a positive number" << std::endl;
+                exit(-1);
+            }
+        }
+        else if (std::strcmp(argv[i], "--turbo") == 0) {
+            turbo = true;
+        }
+        else if (std::strcmp(argv[i], "--jit") == 0) {
+            jit = true;
+        }
+        else if (std::strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            if (!parse_quirk_profile(argv[++i], quirks)) {
+                std::cout << "Unknown quirk profile " << argv[i] << std::endl;
+                print_usage();
+                exit(-1);
+            }
+            quirks_given = true;
+        }
+        else if (std::strcmp(argv[i], "--rom-db") == 0 && i + 1 < argc) {
+            rom_db_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--render-target") == 0) {
+            render_mode = RenderMode::target;
+        }
+        else if (std::strcmp(argv[i], "--rewind") == 0) {
+            rewind = true;
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = std::strtoul(argv[++i], nullptr, 0);
+        }
+        else if (std::strcmp(argv[i], "--record-input") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--play-input") == 0 && i + 1 < argc) {
+            play_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        }
+        else if (std::strcmp(argv[i], "--profile-json") == 0 && i + 1 < argc) {
+            profile_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0) {
+            trace = true;
+        }
+        else if (std::strcmp(argv[i], "--trace-file") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--dump-memory") == 0) {
+            dump_memory = true;
+        }
+        else {
+            rom_path = argv[i];
+        }
+    }
 
-    if (argc < 2) {
+    if (rom_path.empty()) {
         std::cout << "Must provide path to ROM" << std::endl; 
+        print_usage();
+        exit(-1);
+    }
+    if (!record_path.empty() && !play_path.empty()) {
+        std::cout << "Can't record and play back input at the same time" << std::endl;
+        print_usage();
+        exit(-1);
+    }
+
+    // the ROM is read once, up front, and looked up in the ROM database (the one named, or the one next to the ROM if
+    // there is one) for its quirks and clock, which the command line overrides
+    Rom rom;
+    if (!read_rom(rom_path, rom)) {
+        exit(-1);
+    }
+    if (rom_db_path.empty() && std::filesystem::is_regular_file(RomDatabase::default_path(rom_path))) {
+        rom_db_path = RomDatabase::default_path(rom_path);
+    }
+    RomDatabase rom_db;
+    if (!rom_db_path.empty() && !rom_db.load(rom_db_path)) {
+        exit(-1);
+    }
+    if (const RomProfile* profile = rom_db.find(rom.hash)) {
+        std::cout << "Known ROM: " << profile->name << " (" << get_quirk_profile_name(profile->quirks) << " quirks, "
+                  << profile->instructions_per_frame << " instructions per frame)" << std::endl;
+        quirks = quirks_given ? quirks : profile->quirks;
+        instructions_per_frame = (instructions_per_frame > 0) ? instructions_per_frame : profile->instructions_per_frame;
+    }
+    if (instructions_per_frame == 0) {
+        instructions_per_frame = DEFAULT_INSTRUCTIONS_PER_FRAME;
+    }
+
+    // the input log being recorded or played back (playback uses the seed it was recorded with)
+    InputLog input_log;
+    if (!play_path.empty() && !input_log.load(play_path)) {
+        exit(-1);
+    }
+    input_log.set_seed((play_path.empty()) ? seed : input_log.get_seed());
+
+    // SDL backed display, audio and keypad (the renderer initializes SDL, so must be created first)
+    Renderer renderer{render_mode};
+    Sound sound;
+    Keyboard keyboard;
+
+    Chip8 chip8{&renderer, &sound, &keyboard};
+    chip8.set_instructions_per_frame(instructions_per_frame);
+    chip8.set_turbo(turbo);
+    chip8.set_jit(jit);
+    chip8.set_quirks(quirks);
+    chip8.set_rewind(rewind);
+    chip8.set_seed(seed);
+    chip8.set_profiling(profile, profile_path);
+    if (trace && !chip8.set_tracing(true, trace_path)) {
         exit(-1);
     }
+    chip8.set_dump_memory(dump_memory);
+    if (!record_path.empty()) {
+        chip8.record_input(&input_log);
+    }
+    if (!play_path.empty()) {
+        chip8.play_input(&input_log);
+    }
+    chip8.run(rom);
+
+    if (!record_path.empty()) {
+        input_log.save(record_path);
+    }
 
-    Chip8 chip8;
-    chip8.run(argv[1]);
+    // quit sdl - close the renderer and window 
+    sound.quit();
+    renderer.quit();
     return 0;
-}
\ No newline at end of file
+}
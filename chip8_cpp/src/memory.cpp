@@ -1,85 +1,167 @@
 #include "memory.h"
+#include "rom.h"
 
 #include <algorithm>
 #include <array>
 #include <cstdint>
 #include <cstring>
-#include <fstream>
-#include <ios>
 #include <iostream>
 
-Memory::Memory() {
-    // load the font data into memory
-    std::array<uint8_t, 75> font = {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2 0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F 
-    };
-    
-    // copy font into the beginning of ram
-    std::copy(font.begin(), font.end(), memory_.begin());
+// the built in font, copied to the start of memory
+constexpr std::array<uint8_t, 75> FONT = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2 0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F 
+};
 
+// SUPER-CHIP's large digits, 8x10, copied in after the font
+constexpr std::array<uint8_t, 160> BIG_FONT = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
 
-    // initialize the scancode to hex unordered map by flipping the hex to scancode translation table
-    for (auto i = hex_to_scancode_translation.begin(); i != hex_to_scancode_translation.end(); ++i) {
-        scancode_to_hex_translation[i->second] = i->first;
-    }
+// the blocks of memory up to and including the one holding address
+static int blocks_through(int address) {
+    return (address / MEMORY_BLOCK_SIZE + 1) * MEMORY_BLOCK_SIZE;
+}
+
+Memory::Memory() : used_size_(blocks_through(BIG_FONT_START + BIG_FONT.size() - 1)) {
+    // load the font data into memory
+    std::copy(FONT.begin(), FONT.end(), memory_.begin() + FONT_START);
+    std::copy(BIG_FONT.begin(), BIG_FONT.end(), memory_.begin() + BIG_FONT_START);
 }
 
 // overload the << operator so that we can print a representation of the memory object
 std::ostream& operator<<(std::ostream& stream, const Memory& obj) {
+    // formatted into a buffer and written in one go, rather than a hex insertion per byte (which also left the stream
+    // in hex). rows of 8 bytes, "\n0x<address>:" then "<byte> " per byte, neither zero padded
+    const char* digits = "0123456789abcdef";
+    auto append_hex = [&](char*& out, unsigned value) {
+        int shift = 12;
+        while (shift > 0 && (value >> shift) == 0) {
+            shift -= 4;
+        }
+        for (; shift >= 0; shift -= 4) {
+            *out++ = digits[(value >> shift) & 0xf];
+        }
+    };
+
+    std::string text(MEMORY_SIZE / 8 * 10 + MEMORY_SIZE * 3, ' '); // "\n0x" + 4 digits + ":", and up to 3 per byte
+    char* out = text.data();
     for (int i = 0; i < obj.memory_.size(); i++) {
         if (i % 8 == 0) {
-            stream << std::endl << "0x" << std::hex << i << ":";
+            *out++ = '\n';
+            *out++ = '0';
+            *out++ = 'x';
+            append_hex(out, i);
+            *out++ = ':';
         }
-
-        uint8_t byte = obj.memory_[i];
-        stream << std::hex << unsigned(byte) << " ";
-        
-    } 
+        append_hex(out, obj.memory_[i]);
+        *out++ = ' ';
+    }
+    stream.write(text.data(), out - text.data());
 
     return stream;
 }
 
-int Memory::get_from_memory(int memory_loc) {
-    return memory_[memory_loc];
-}
-
 void Memory::set_memory(int memory_loc, uint8_t val) {
+    memory_loc &= MEMORY_SIZE - 1;
     memory_[memory_loc] = val; 
+    if (memory_loc >= used_size_) {
+        used_size_ = blocks_through(memory_loc);
+    }
+    if (watcher_ != nullptr) {
+        watcher_->memory_written(memory_loc, 1);
+    }
+}
+
+void Memory::set_contents(const uint8_t* contents, int size) {
+    // contents are zero after size, as memory is after used_size_, so only the longer of the two can differ. only the span
+    // between the first and last differing bytes needs invalidating (usually little or none of memory). this is most of
+    // the cost of restoring a save state, so the differing blocks are found with memcmp (vectorized by the C library),
+    // then the words within them 8 bytes at a time
+    static constexpr std::array<uint8_t, MEMORY_BLOCK_SIZE> zero_block{};
+    auto source = [&](int loc) { return (loc < size) ? contents + loc : zero_block.data() + (loc % MEMORY_BLOCK_SIZE); };
+    auto same_block = [&](int loc) { return std::memcmp(memory_.data() + loc, source(loc), MEMORY_BLOCK_SIZE) == 0; };
+    auto same_word = [&](int loc) { return std::memcmp(memory_.data() + loc, source(loc), sizeof(uint64_t)) == 0; };
+    int end = std::max(size, used_size_);
+    used_size_ = size;
+    int first = 0;
+    while (first < end && same_block(first)) {
+        first += MEMORY_BLOCK_SIZE;
+    }
+    if (first == end) {
+        return;
+    }
+    while (same_word(first)) {
+        first += 8;
+    }
+    int last = end - MEMORY_BLOCK_SIZE;
+    while (same_block(last)) {
+        last -= MEMORY_BLOCK_SIZE;
+    }
+    last += MEMORY_BLOCK_SIZE - 8;
+    while (same_word(last)) {
+        last -= 8;
+    }
+    int length = last + 8 - first;
+
+    int copied = std::clamp(size - first, 0, length);
+    std::memcpy(memory_.data() + first, contents + first, copied);
+    std::fill(memory_.begin() + first + copied, memory_.begin() + first + length, 0);
+    if (watcher_ != nullptr) {
+        watcher_->memory_written(first, length);
+    }
 }
 
-void Memory::load_ROM(std::string file_path) {
-    std::ifstream rom_file;
-    rom_file.open(file_path, std::ios::binary);
+void Memory::set_watcher(MemoryWatcher* watcher) {
+    watcher_ = watcher;
+}
 
-    if (!rom_file) {
-        // error opening the file
-        std::cout << "Error: could not find specified ROM file." << std::endl;
-        exit(-1);
+bool Memory::load_ROM(const std::string& file_path) {
+    Rom rom;
+    if (!read_rom(file_path, rom)) {
+        return false;
     }
+    load_ROM(rom);
+    return true;
+}
+
+void Memory::load_ROM(const Rom& rom) {
+    load_ROM(rom.data.data(), rom.size);
+}
 
-    // start loading into address 0x200 (after font + system) 
-    int location = 0x200;
-    uint8_t byte;
-    
-    // read bytes from file one by one, and insert them into <location>
-    while (rom_file.read(reinterpret_cast<char*>(&byte), sizeof(byte))) {
-        memory_[location] = byte;
-        location++;
+void Memory::load_ROM(const uint8_t* data, size_t size) {
+    // start loading into address 0x200 (after font + system), the whole ROM in one copy
+    std::copy(data, data + size, memory_.begin() + ROM_START);
+    used_size_ = std::max<int>(used_size_, blocks_through(ROM_START + size - 1));
+    if (watcher_ != nullptr) {
+        watcher_->memory_written(ROM_START, size);
     }
- 
-    rom_file.close();
 }
@@ -0,0 +1,132 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+    const std::array<const char*, STAGE_COUNT> stage_names = {"cpu", "render", "events", "sleep"};
+
+    // addresses which ran at least once, most run first
+    std::vector<uint16_t> sorted_pcs(const std::array<uint64_t, MEMORY_SIZE>& pc_counts) {
+        std::vector<uint16_t> pcs;
+        for (int pc = 0; pc < MEMORY_SIZE; pc++) {
+            if (pc_counts[pc] != 0) {
+                pcs.push_back(pc);
+            }
+        }
+        std::stable_sort(pcs.begin(), pcs.end(), [&](uint16_t a, uint16_t b) { return pc_counts[a] > pc_counts[b]; });
+        return pcs;
+    }
+
+    double percent(uint64_t part, uint64_t whole) {
+        return (whole != 0) ? 100.0 * part / whole : 0;
+    }
+
+}
+
+void Profiler::add_time(Stage stage, std::chrono::nanoseconds time) {
+    stage_times_[static_cast<int>(stage)].fetch_add(time.count(), std::memory_order_relaxed);
+}
+
+void Profiler::count_frame() {
+    frames_++;
+}
+
+void Profiler::clear() {
+    handler_counts_.fill(0);
+    pc_counts_.fill(0);
+    samples_ = 0;
+    for (std::atomic<int64_t>& time : stage_times_) {
+        time = 0;
+    }
+    frames_ = 0;
+}
+
+uint64_t Profiler::get_instruction_count() const {
+    return std::accumulate(handler_counts_.begin(), handler_counts_.end(), uint64_t(0));
+}
+
+uint64_t Profiler::get_handler_count(int handler) const {
+    return handler_counts_[handler];
+}
+
+uint64_t Profiler::get_pc_count(uint16_t pc) const {
+    return pc_counts_[pc & (MEMORY_SIZE - 1)];
+}
+
+void Profiler::write_report(std::ostream& stream) const {
+    uint64_t instructions = get_instruction_count();
+    std::array<int64_t, STAGE_COUNT> stage_times;
+    std::copy(stage_times_.begin(), stage_times_.end(), stage_times.begin());
+    int64_t total = std::accumulate(stage_times.begin(), stage_times.end(), int64_t(0));
+    std::ios_base::fmtflags flags = stream.flags();
+
+    stream << "Profile: " << instructions << " instructions over " << frames_ << " frames, opcodes and pcs from " << samples_ << " samples"
+           << std::endl;
+
+    // where the main loop's time went
+    stream << std::left << std::setw(12) << "stage" << std::right << std::setw(12) << "ms" << std::setw(10) << "%" << std::setw(14) << "us / frame"
+           << std::endl;
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        double ms = stage_times[stage] / 1e6;
+        stream << std::left << std::setw(12) << stage_names[stage] << std::right << std::fixed << std::setprecision(1) << std::setw(12) << ms
+               << std::setw(10) << percent(stage_times[stage], total) << std::setw(14)
+               << ((frames_ != 0) ? ms * 1000 / frames_ : 0) << std::endl;
+    }
+
+    // opcode families, most run first
+    std::array<int, HANDLER_COUNT> handlers;
+    std::iota(handlers.begin(), handlers.end(), 0);
+    std::stable_sort(handlers.begin(), handlers.end(), [&](int a, int b) { return handler_counts_[a] > handler_counts_[b]; });
+    stream << std::endl << std::left << std::setw(12) << "opcode" << std::right << std::setw(16) << "count" << std::setw(10) << "%" << std::endl;
+    for (int handler : handlers) {
+        if (handler_counts_[handler] == 0) {
+            break;
+        }
+        stream << std::left << std::setw(12) << CPU::get_handler_name(handler) << std::right << std::setw(16) << handler_counts_[handler]
+               << std::setw(10) << percent(handler_counts_[handler], instructions) << std::endl;
+    }
+
+    // the busiest addresses, usually the inner loops of the ROM
+    std::vector<uint16_t> pcs = sorted_pcs(pc_counts_);
+    stream << std::endl << std::left << std::setw(12) << "pc" << std::right << std::setw(16) << "count" << std::setw(10) << "%" << std::endl;
+    for (size_t i = 0; i < pcs.size() && i < PROFILER_HOTSPOTS; i++) {
+        stream << "0x" << std::hex << std::setfill('0') << std::setw(3) << pcs[i] << std::dec << std::setfill(' ') << std::string(7, ' ')
+               << std::setw(16) << pc_counts_[pcs[i]] << std::setw(10) << percent(pc_counts_[pcs[i]], instructions) << std::endl;
+    }
+    stream.flags(flags);
+}
+
+void Profiler::write_json(std::ostream& stream) const {
+    stream << "{\n  \"instructions\": " << get_instruction_count() << ",\n  \"frames\": " << frames_ << ",\n  \"samples\": " << samples_
+           << ",\n  \"stage_ns\": {";
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        stream << ((stage != 0) ? ", " : "") << '"' << stage_names[stage] << "\": " << stage_times_[stage].load();
+    }
+    stream << "},\n  \"opcodes\": {";
+    for (int handler = 0; handler < HANDLER_COUNT; handler++) {
+        stream << ((handler != 0) ? ", " : "") << '"' << CPU::get_handler_name(handler) << "\": " << handler_counts_[handler];
+    }
+    // every address which ran, most run first
+    stream << "},\n  \"pcs\": [";
+    std::vector<uint16_t> pcs = sorted_pcs(pc_counts_);
+    for (size_t i = 0; i < pcs.size(); i++) {
+        stream << ((i != 0) ? "," : "") << "\n    {\"pc\": " << pcs[i] << ", \"count\": " << pc_counts_[pcs[i]] << "}";
+    }
+    stream << "\n  ]\n}" << std::endl;
+}
+
+bool Profiler::save_json(const std::string& file_path) const {
+    std::ofstream file(file_path);
+    write_json(file);
+    if (!file) {
+        std::cout << "Error: could not write profile to " << file_path << std::endl;
+        return false;
+    }
+    return true;
+}
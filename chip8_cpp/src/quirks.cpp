@@ -0,0 +1,23 @@
+#include "quirks.h"
+
+#include <array>
+
+namespace {
+
+    const std::array<const char*, QUIRK_PROFILE_COUNT> profile_names = {"chip8", "vip", "schip", "xochip"};
+
+}
+
+const char* get_quirk_profile_name(QuirkProfile profile) {
+    return profile_names[static_cast<int>(profile)];
+}
+
+bool parse_quirk_profile(const std::string& name, QuirkProfile& profile) {
+    for (int i = 0; i < QUIRK_PROFILE_COUNT; i++) {
+        if (name == profile_names[i]) {
+            profile = static_cast<QuirkProfile>(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -6,10 +6,17 @@
 #include <SDL_render.h>
 #include <SDL_surface.h>
 #include <SDL_video.h>
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 
-Renderer::Renderer() {
+#define PIXEL_OFF 0xff000000 // opaque black
+
+// ARGB8888 colour of a pixel by which planes it is on in (bit p for plane p): off, plane 0 (the only one CHIP-8 and
+// SUPER-CHIP draw on), plane 1, both
+constexpr uint32_t PALETTE[1 << PLANE_COUNT] = {PIXEL_OFF, 0xffffffff, 0xffaaaaaa, 0xff555555};
+
+Renderer::Renderer(RenderMode mode) : mode_(mode) {
     // constructor - initialize the SDL2 components (window, renderer, etc.)
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
         std::cout << "Error: "  << SDL_GetError();
@@ -31,7 +38,30 @@ Renderer::Renderer() {
         exit(-1);
     }
 
-    texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (mode_ == RenderMode::streaming) {
+        texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+        pixels_.fill(PIXEL_OFF);
+    }
+    else {
+        texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
+    if (!texture_) {
+        std::cout << "Error creating texture: " << SDL_GetError() << std::endl;
+        exit(-1);
+    }
+    if (mode_ == RenderMode::streaming) {
+        SDL_UpdateTexture(texture_, NULL, pixels_.data(), SCREEN_WIDTH * sizeof(uint32_t));
+    }
+
+    SDL_AddEventWatch(window_event_watch, this);
+}
+
+int Renderer::window_event_watch(void* userdata, SDL_Event* event) {
+    // the window's contents may have been lost (exposed, resized, restored), so show the last frame again even if unchanged
+    if (event->type == SDL_WINDOWEVENT) {
+        static_cast<Renderer*>(userdata)->needs_present_ = true;
+    }
+    return 1;
 }
 
 void Renderer::clear_screen() {
@@ -40,30 +70,94 @@ void Renderer::clear_screen() {
     SDL_RenderClear(renderer_);
 }
 
-bool Renderer::get_pixel_is_on(unsigned int x, unsigned int y) {
-    return pixel_status_[x + (y * SCREEN_WIDTH)]; 
+void Renderer::render(const Framebuffer& framebuffer) {
+    if (mode_ == RenderMode::streaming) {
+        render_streaming(framebuffer);
+    }
+    else {
+        render_target(framebuffer);
+    }
+}
+
+bool Renderer::row_changed(const Framebuffer& framebuffer, unsigned int y) const {
+    for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+        for (unsigned int column = 0; column < framebuffer.get_width() / 64; column++) {
+            if (framebuffer.get_word(plane, column, y) != drawn_.get_word(plane, column, y)) {
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
-void Renderer::set_pixel(unsigned int x, unsigned int y, bool status) {
-    SDL_SetRenderTarget(renderer_, texture_);
-    if (status == true) {
-        // set the pixel to white
-        SDL_SetRenderDrawColor(renderer_, 255, 255, 255, SDL_ALPHA_OPAQUE);
-        SDL_RenderDrawPoint(renderer_, x, y);
-    } 
-    else {
-        // set the pixel to black
-        SDL_SetRenderDrawColor(renderer_, 0, 0, 0, SDL_ALPHA_OPAQUE);
-        SDL_RenderDrawPoint(renderer_, x, y);
+void Renderer::render_streaming(const Framebuffer& framebuffer) {
+    // redraw the changed rows into the pixel buffer (all of them after a change of resolution)
+    bool resized = framebuffer.is_hires() != drawn_.is_hires();
+    unsigned int scale = framebuffer.is_hires() ? 1 : 2;
+    bool changed = false;
+    for (unsigned int y = 0; y < framebuffer.get_height(); y++) {
+        if (!resized && !row_changed(framebuffer, y)) {
+            continue;
+        }
+        uint32_t* pixel_row = pixels_.data() + (y * scale * SCREEN_WIDTH);
+        for (unsigned int x = 0; x < framebuffer.get_width(); x++) {
+            uint32_t color = PALETTE[framebuffer.get_color(x, y)];
+            for (unsigned int i = 0; i < scale; i++) {
+                pixel_row[x * scale + i] = color;
+            }
+        }
+        if (scale == 2) {
+            std::copy(pixel_row, pixel_row + SCREEN_WIDTH, pixel_row + SCREEN_WIDTH);
+        }
+        changed = true;
     }
+    drawn_ = framebuffer;
 
-    SDL_SetRenderTarget(renderer_, NULL);
+    // nothing new to show - leave the window as it is, unless it was disturbed
+    bool needs_present = needs_present_.exchange(false);
+    if (!changed && !needs_present) {
+        return;
+    }
+
+    // one upload for the whole frame
+    if (changed) {
+        SDL_UpdateTexture(texture_, NULL, pixels_.data(), SCREEN_WIDTH * sizeof(uint32_t));
+    }
+    present();
+}
 
-    pixel_status_[x + (y * SCREEN_WIDTH)] = status;
+void Renderer::render_target(const Framebuffer& framebuffer) {
+    // bring the texture up to date with the framebuffer, only drawing the pixels which changed since the last render
+    // (all of them after a change of resolution)
+    SDL_SetRenderTarget(renderer_, texture_);
+    bool resized = framebuffer.is_hires() != drawn_.is_hires();
+    int scale = framebuffer.is_hires() ? 1 : 2;
+    for (unsigned int y = 0; y < framebuffer.get_height(); y++) {
+        for (unsigned int column = 0; column < framebuffer.get_width() / 64; column++) {
+            uint64_t changed = resized ? ~uint64_t(0) : 0;
+            for (unsigned int plane = 0; plane < PLANE_COUNT; plane++) {
+                changed |= framebuffer.get_word(plane, column, y) ^ drawn_.get_word(plane, column, y);
+            }
+            // walk only the set bits of the difference, leftmost first
+            while (changed != 0) {
+                unsigned int bit = 63 - __builtin_clzll(changed);
+                unsigned int x = column * 64 + 63 - bit;
+                uint32_t color = PALETTE[framebuffer.get_color(x, y)];
+                SDL_SetRenderDrawColor(renderer_, (color >> 16) & 0xff, (color >> 8) & 0xff, color & 0xff, SDL_ALPHA_OPAQUE);
+                SDL_Rect pixel = {int(x) * scale, int(y) * scale, scale, scale};
+                SDL_RenderFillRect(renderer_, &pixel);
+                changed &= ~(uint64_t(1) << bit);
+            }
+        }
+    }
+    drawn_ = framebuffer;
+    SDL_SetRenderTarget(renderer_, NULL);
+    present();
 }
 
-void Renderer::render() {
-    // copy the texture to the screen
+void Renderer::present() {
+    // fill the screen with black, then copy the texture to the screen
+    clear_screen();
     SDL_RenderCopy(renderer_, texture_, NULL, NULL);
     // update the window
     SDL_RenderPresent(renderer_);
@@ -71,6 +165,7 @@ void Renderer::render() {
 
 void Renderer::quit() {
     // quit out of all SDL processes
+    SDL_DelEventWatch(window_event_watch, this);
     SDL_DestroyTexture(texture_);
     SDL_DestroyRenderer(renderer_);
     SDL_DestroyWindow(window_);
@@ -0,0 +1,182 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+    // all zero, the base keyframes are encoded against (so that they are plain run length encoding)
+    const SaveState zero_state = [] {
+        SaveState state{};
+        state.magic = 0;
+        state.version = 0;
+        return state;
+    }();
+
+    void write_varint(std::vector<uint8_t>& out, size_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    size_t read_varint(const uint8_t*& in) {
+        size_t value = 0;
+        int shift = 0;
+        while (*in & 0x80) {
+            value |= size_t(*in++ & 0x7f) << shift;
+            shift += 7;
+        }
+        value |= size_t(*in++) << shift;
+        return value;
+    }
+
+    uint64_t word(const uint8_t* bytes, size_t loc) {
+        uint64_t value;
+        std::memcpy(&value, bytes + loc, sizeof(value));
+        return value;
+    }
+
+    // encode state as runs against base: (unchanged byte count, changed byte count, changed bytes XOR base)...
+    // with nothing for the unchanged bytes at the end, which include the memory past what either has in use (all zero)
+    void encode_delta(const SaveState& state, const SaveState& base, std::vector<uint8_t>& out) {
+        const uint8_t* now = reinterpret_cast<const uint8_t*>(&state);
+        const uint8_t* before = reinterpret_cast<const uint8_t*>(&base);
+        const size_t size = std::max(state.get_used_bytes(), base.get_used_bytes());
+
+        size_t loc = 0;
+        while (loc < size) {
+            // skip the unchanged run, a word at a time where possible
+            size_t run_start = loc;
+            while (loc + 8 <= size && word(now, loc) == word(before, loc)) {
+                loc += 8;
+            }
+            while (loc < size && now[loc] == before[loc]) {
+                loc++;
+            }
+            if (loc == size) {
+                break;
+            }
+
+            size_t changed_start = loc;
+            while (loc < size && now[loc] != before[loc]) {
+                loc++;
+            }
+            write_varint(out, changed_start - run_start);
+            write_varint(out, loc - changed_start);
+            for (size_t i = changed_start; i < loc; i++) {
+                out.push_back(now[i] ^ before[i]);
+            }
+        }
+    }
+
+    // XOR the runs into state, which holds the base it was encoded against
+    void decode_delta(const uint8_t* in, size_t length, SaveState& state) {
+        uint8_t* out = reinterpret_cast<uint8_t*>(&state);
+        const uint8_t* end = in + length;
+        size_t loc = 0;
+        while (in < end) {
+            loc += read_varint(in);
+            size_t changed = read_varint(in);
+            for (size_t i = 0; i < changed; i++) {
+                out[loc++] ^= *in++;
+            }
+        }
+    }
+
+}
+
+Rewind::Rewind(size_t capacity_bytes) : buffer_(std::max<size_t>(capacity_bytes, MIN_REWIND_BYTES)) {
+    encoded_.reserve(MAX_REWIND_FRAME_BYTES);
+}
+
+void Rewind::record(const SaveState& state) {
+    encoded_.clear();
+    if (!frames_.empty() && next_sequence_ - keyframe_sequence_ < REWIND_KEYFRAME_INTERVAL) {
+        encode_delta(state, keyframe_, encoded_);
+        if (store(encoded_, keyframe_sequence_)) {
+            return;
+        }
+        // its keyframe had to be overwritten to make room, so store this frame as a keyframe instead
+        encoded_.clear();
+    }
+
+    encode_delta(state, zero_state, encoded_);
+    keyframe_ = state;
+    keyframe_sequence_ = next_sequence_;
+    store(encoded_, keyframe_sequence_);
+}
+
+bool Rewind::store(const std::vector<uint8_t>& encoded, uint64_t keyframe_sequence) {
+    // a frame's encoding is never split across the end of the buffer, so start again from the beginning if it won't fit
+    if (frames_.empty() || head_ + encoded.size() > buffer_.size()) {
+        head_ = 0;
+    }
+
+    // drop the oldest frames which are in the way. they are always at the front, as the buffer is written in order
+    auto overlaps = [&](const Frame& frame) {
+        return frame.offset < head_ + encoded.size() && head_ < frame.offset + frame.size;
+    };
+    while (!frames_.empty() && overlaps(frames_.front())) {
+        bytes_used_ -= frames_.front().size;
+        frames_.pop_front();
+    }
+    // deltas can't be decoded without their keyframe, so drop them along with it
+    while (!frames_.empty() && frames_.front().sequence != frames_.front().keyframe_sequence) {
+        bytes_used_ -= frames_.front().size;
+        frames_.pop_front();
+    }
+    bool is_keyframe = keyframe_sequence == next_sequence_;
+    if (!is_keyframe && (frames_.empty() || frames_.front().sequence > keyframe_sequence)) {
+        return false;
+    }
+
+    std::memcpy(buffer_.data() + head_, encoded.data(), encoded.size());
+    frames_.push_back(Frame{head_, encoded.size(), next_sequence_, keyframe_sequence});
+    head_ += encoded.size();
+    bytes_used_ += encoded.size();
+    next_sequence_++;
+    return true;
+}
+
+bool Rewind::step_back(SaveState& state) {
+    if (frames_.size() < 2) {
+        return false;
+    }
+
+    // the newest frame is the current state, and its space is reused by the next frame recorded
+    head_ = frames_.back().offset;
+    bytes_used_ -= frames_.back().size;
+    next_sequence_ = frames_.back().sequence;
+    frames_.pop_back();
+
+    // the keyframe of the frame now newest is usually the one already decoded
+    const Frame& newest = frames_.back();
+    if (newest.keyframe_sequence != keyframe_sequence_) {
+        const Frame& keyframe = frame(newest.keyframe_sequence);
+        keyframe_ = zero_state;
+        decode_delta(buffer_.data() + keyframe.offset, keyframe.size, keyframe_);
+        keyframe_sequence_ = newest.keyframe_sequence;
+    }
+
+    state = keyframe_;
+    if (newest.sequence != newest.keyframe_sequence) {
+        decode_delta(buffer_.data() + newest.offset, newest.size, state);
+    }
+    return true;
+}
+
+void Rewind::clear() {
+    frames_.clear();
+    head_ = 0;
+    bytes_used_ = 0;
+}
+
+size_t Rewind::get_frame_count() const {
+    return frames_.size();
+}
+
+size_t Rewind::get_bytes_used() const {
+    return bytes_used_;
+}
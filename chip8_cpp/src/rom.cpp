@@ -0,0 +1,99 @@
+#include "rom.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+bool read_rom(const std::string& file_path, Rom& rom) {
+    std::FILE* file = std::fopen(file_path.c_str(), "rb");
+    if (file == nullptr) {
+        std::cout << "Error: could not find ROM file " << file_path << std::endl;
+        return false;
+    }
+    // unbuffered, so the read goes straight into the ROM. a byte left over once it is full shows up a ROM which is too
+    // big without a separate call for the file's size
+    std::setvbuf(file, nullptr, _IONBF, 0);
+    size_t size = std::fread(rom.data.data(), 1, rom.data.size(), file);
+    bool too_big = size == rom.data.size() && std::fgetc(file) != EOF;
+    bool failed = std::ferror(file) != 0;
+    std::fclose(file);
+
+    if (failed) {
+        std::cout << "Error: could not read ROM file " << file_path << std::endl;
+        return false;
+    }
+    if (size == 0) {
+        std::cout << "Error: " << file_path << " is empty" << std::endl;
+        return false;
+    }
+    if (too_big) {
+        std::cout << "Error: " << file_path << " is too big for memory (at most " << MAX_ROM_SIZE << " bytes)" << std::endl;
+        return false;
+    }
+
+    std::fill(rom.data.begin() + size, rom.data.end(), 0);
+    rom.size = size;
+    rom.hash = hash_rom(rom.data.data(), size);
+    return true;
+}
+
+uint64_t hash_rom(const uint8_t* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+bool RomDatabase::load(const std::string& file_path) {
+    std::ifstream file(file_path);
+    if (!file) {
+        std::cout << "Error: could not find ROM database " << file_path << std::endl;
+        return false;
+    }
+
+    std::unordered_map<uint64_t, RomProfile> profiles;
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); line_number++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string hash, quirks;
+        RomProfile profile;
+        if (!(fields >> hash)) {
+            continue; // blank or only a comment
+        }
+        fields >> quirks >> profile.instructions_per_frame >> std::ws;
+        std::getline(fields, profile.name);
+
+        size_t parsed = 0;
+        uint64_t key = 0;
+        try {
+            key = std::stoull(hash, &parsed, 16);
+        }
+        catch (const std::exception&) {
+            parsed = 0;
+        }
+        if (parsed != hash.size() || !parse_quirk_profile(quirks, profile.quirks) || profile.instructions_per_frame <= 0) {
+            std::cout << "Error: " << file_path << " line " << line_number << " is not \"<hash> <quirk profile> <instructions per frame> <name>\"" << std::endl;
+            return false;
+        }
+        profiles[key] = profile;
+    }
+
+    profiles_ = std::move(profiles);
+    return true;
+}
+
+const RomProfile* RomDatabase::find(uint64_t hash) const {
+    auto profile = profiles_.find(hash);
+    return (profile == profiles_.end()) ? nullptr : &profile->second;
+}
+
+std::string RomDatabase::default_path(const std::string& rom_path) {
+    return (std::filesystem::path(rom_path).parent_path() / ROM_DATABASE_FILE).string();
+}
@@ -0,0 +1,50 @@
+#include "savestate.h"
+
+#include <cstddef>
+#include <fstream>
+#include <ios>
+#include <iostream>
+
+bool write_save_state(const SaveState& state, const std::string& file_path) {
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&state), state.get_used_bytes());
+    if (!file) {
+        std::cout << "Error: could not write save state to " << file_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool read_save_state(SaveState& state, const std::string& file_path) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file) {
+        std::cout << "Error: could not find save state file " << file_path << std::endl;
+        return false;
+    }
+
+    // read into a temporary, so that a bad file leaves the caller's state alone. everything before memory first, then as
+    // much memory as that says is in use
+    SaveState loaded;
+    auto wrong_size = [&] {
+        std::cout << "Error: " << file_path << " is not a save state (wrong size)" << std::endl;
+        return false;
+    };
+    if (!file.read(reinterpret_cast<char*>(&loaded), offsetof(SaveState, memory))) {
+        return wrong_size();
+    }
+    if (loaded.magic != SAVE_STATE_MAGIC) {
+        std::cout << "Error: " << file_path << " is not a save state" << std::endl;
+        return false;
+    }
+    if (loaded.version != SAVE_STATE_VERSION) {
+        std::cout << "Error: " << file_path << " is a version " << loaded.version << " save state, expected version " << SAVE_STATE_VERSION << std::endl;
+        return false;
+    }
+    if (loaded.memory_size > MEMORY_SIZE || loaded.memory_size % MEMORY_BLOCK_SIZE != 0
+        || !file.read(reinterpret_cast<char*>(loaded.memory), loaded.memory_size) || file.peek() != std::ifstream::traits_type::eof()) {
+        return wrong_size();
+    }
+
+    state = loaded;
+    return true;
+}
@@ -1,5 +1,4 @@
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_mixer.h>
 #include <SDL_error.h>
 #include <cstdint>
 #include <iostream>
@@ -7,34 +6,43 @@
 #include "sound.h"
 
 Sound::Sound() {
-    // initialize the SDL mixer
-    if (Mix_OpenAudio(22050, MIX_DEFAULT_FORMAT, 2, 4096) != 0) {
-        std::cout << "Error: " << Mix_GetError();
-        exit(-1);
-    }
+    // mono 16 bit output with a small buffer, converted by SDL if the device wants something else (so the tone generator
+    // always gets the rate it was made for)
+    SDL_AudioSpec desired;
+    SDL_memset(&desired, 0, sizeof(desired));
+    desired.freq = AUDIO_SAMPLE_RATE;
+    desired.format = AUDIO_S16SYS;
+    desired.channels = 1;
+    desired.samples = AUDIO_BUFFER_SAMPLES;
+    desired.callback = audio_callback;
+    desired.userdata = this;
 
-    beep = Mix_LoadWAV(BEEP_PATH);
-    if (beep == NULL) {
-        std::cout << "Could not load beep file: " << Mix_GetError();
+    device_ = SDL_OpenAudioDevice(nullptr, 0, &desired, nullptr, 0);
+    if (device_ == 0) {
+        std::cout << "Error: " << SDL_GetError() << std::endl;
         exit(-1);
     }
+    // the callback runs (producing silence) from now on; the tone only depends on the sound timer
+    SDL_PauseAudioDevice(device_, 0);
 }
 
-void Sound::decrement_timer() {
-    if (sound_timer_ > 0) {
-        if (Mix_Playing(-1) == 0) {
-            Mix_PlayChannel(-1, beep, 0);
-        } 
-        sound_timer_--;
-    }
+void Sound::audio_callback(void* userdata, Uint8* stream, int len) {
+    static_cast<Sound*>(userdata)->tone_.generate(reinterpret_cast<int16_t*>(stream), len / sizeof(int16_t));
 }
 
-void Sound::set_timer(uint8_t val) {
-    sound_timer_ = val;
+void Sound::set_sound_timer(uint8_t sound_timer) {
+    tone_.set_sound_timer(sound_timer);
+}
+
+void Sound::set_pattern(const std::array<uint8_t, AUDIO_PATTERN_BYTES>& pattern, uint8_t pitch) {
+    SDL_LockAudioDevice(device_);
+    tone_.set_pattern(pattern, pitch);
+    SDL_UnlockAudioDevice(device_);
 }
 
 void Sound::quit() {
-    Mix_FreeChunk(beep);
-    Mix_CloseAudio();
-    Mix_Quit();
-}
\ No newline at end of file
+    if (device_ != 0) {
+        SDL_CloseAudioDevice(device_);
+        device_ = 0;
+    }
+}
@@ -0,0 +1,43 @@
+#include "tone.h"
+
+#include <cmath>
+
+ToneGenerator::ToneGenerator(int sample_rate) : sample_rate_(sample_rate) {
+    std::array<uint8_t, AUDIO_PATTERN_BYTES> square;
+    square.fill(DEFAULT_AUDIO_PATTERN_BYTE);
+    set_pattern(square, DEFAULT_AUDIO_PITCH);
+}
+
+void ToneGenerator::set_pattern(const std::array<uint8_t, AUDIO_PATTERN_BYTES>& pattern, uint8_t pitch) {
+    pattern_ = pattern;
+    // XO-CHIP: 4000 * 2 ^ ((pitch - 64) / 48) bits a second
+    double bits_per_second = 4000 * std::pow(2.0, (pitch - 64) / 48.0);
+    phase_step_ = static_cast<uint32_t>(bits_per_second * 65536 / sample_rate_);
+}
+
+void ToneGenerator::generate(int16_t* samples, int count) {
+    // the sound timer is read once per buffer, which at AUDIO_BUFFER_SAMPLES is well inside a 60Hz tick
+    bool on = sound_timer_.load(std::memory_order_relaxed) != 0;
+    const uint32_t pattern_length = AUDIO_PATTERN_BYTES * 8 << 16;
+
+    for (int i = 0; i < count; i++) {
+        if (on && gain_ < TONE_RAMP_SAMPLES) {
+            gain_++;
+        }
+        else if (!on && gain_ > 0) {
+            gain_--;
+        }
+        if (gain_ == 0) {
+            samples[i] = 0;
+            continue;
+        }
+
+        uint32_t bit = phase_ >> 16;
+        bool high = (pattern_[bit >> 3] >> (7 - (bit & 7))) & 1;
+        samples[i] = (high ? TONE_AMPLITUDE : -TONE_AMPLITUDE) * gain_ / TONE_RAMP_SAMPLES;
+        phase_ += phase_step_;
+        if (phase_ >= pattern_length) {
+            phase_ -= pattern_length;
+        }
+    }
+}
@@ -0,0 +1,162 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+namespace {
+
+    // fatal signals, on which the ring is written out before the process goes down
+    const std::array<int, 5> crash_signals = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+    std::array<struct sigaction, 5> previous_actions;
+    std::atomic<Tracer*> crash_tracer{nullptr};
+
+}
+
+Tracer::Tracer(size_t ring_records) {
+    size_t size = 1;
+    while (size < ring_records) {
+        size *= 2;
+    }
+    // allocated up front, so that tracing never allocates
+    ring_.resize(size);
+    mask_ = size - 1;
+}
+
+Tracer::~Tracer() {
+    close();
+}
+
+bool Tracer::open(const std::string& file_path) {
+    close();
+    fd_ = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        std::cout << "Error: could not create trace file " << file_path << std::endl;
+        return false;
+    }
+    head_ = 0;
+    tail_ = 0;
+    dropped_ = 0;
+    sequence_ = 0;
+    write_header();
+
+    // one tracer at a time (the first opened) is flushed on a crash. SA_RESETHAND: the handler runs once, then the
+    // signal is raised again with the default action
+    struct sigaction action = {};
+    action.sa_handler = crash_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESETHAND;
+    Tracer* none = nullptr;
+    if (crash_tracer.compare_exchange_strong(none, this)) {
+        for (size_t i = 0; i < crash_signals.size(); i++) {
+            sigaction(crash_signals[i], &action, &previous_actions[i]);
+        }
+    }
+
+    flushing_ = true;
+    flusher_ = std::thread(&Tracer::flush_loop, this);
+    return true;
+}
+
+void Tracer::close() {
+    if (fd_ < 0) {
+        return;
+    }
+    flushing_ = false;
+    flusher_.join();
+    Tracer* self = this;
+    if (crash_tracer.compare_exchange_strong(self, nullptr)) {
+        for (size_t i = 0; i < crash_signals.size(); i++) {
+            sigaction(crash_signals[i], &previous_actions[i], nullptr);
+        }
+    }
+    write_pending();
+    write_header();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+uint64_t Tracer::get_written() const {
+    return tail_.load(std::memory_order_acquire);
+}
+
+uint64_t Tracer::get_dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+size_t Tracer::write_pending() {
+    // only async-signal-safe calls from here on, as the crash handler uses it. every record has a fixed place in the
+    // file, so if the flusher thread was part way through the same span when the process crashed, both write the same
+    // bytes to the same place
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t start = tail;
+    while (tail != head) {
+        size_t index = tail & mask_;
+        size_t count = std::min<uint64_t>(head - tail, ring_.size() - index); // up to the end of the ring
+        ssize_t written = pwrite(fd_, &ring_[index], count * sizeof(TraceRecord), sizeof(TraceHeader) + tail * sizeof(TraceRecord));
+        if (written < static_cast<ssize_t>(sizeof(TraceRecord))) {
+            break; // the disk is full or gone: the records stay in the ring, and the cpu drops new ones once it fills
+        }
+        tail += written / sizeof(TraceRecord);
+    }
+    tail_.store(tail, std::memory_order_release);
+    return tail - start;
+}
+
+void Tracer::write_header() {
+    TraceHeader header;
+    header.records = tail_.load(std::memory_order_relaxed);
+    header.dropped = dropped_.load(std::memory_order_relaxed);
+    // if this fails there is nothing to be done from a signal handler, and the records can still be read without the counts
+    pwrite(fd_, &header, sizeof(header), 0);
+}
+
+void Tracer::flush_loop() {
+    while (flushing_.load(std::memory_order_relaxed)) {
+        if (write_pending() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_FLUSH_MS));
+        }
+    }
+}
+
+void Tracer::crash_handler(int signal) {
+    Tracer* tracer = crash_tracer.load();
+    if (tracer != nullptr) {
+        tracer->write_pending();
+        tracer->write_header();
+    }
+    // the default action is back in place (SA_RESETHAND)
+    raise(signal);
+}
+
+bool read_trace(const std::string& file_path, TraceHeader& header, std::vector<TraceRecord>& records) {
+    std::FILE* file = std::fopen(file_path.c_str(), "rb");
+    if (file == nullptr) {
+        std::cout << "Error: could not find trace file " << file_path << std::endl;
+        return false;
+    }
+    TraceHeader read_header;
+    bool valid = std::fread(&read_header, sizeof(read_header), 1, file) == 1 && read_header.magic == TRACE_MAGIC &&
+                 read_header.version == TRACE_VERSION && read_header.record_size == sizeof(TraceRecord);
+    if (!valid) {
+        std::fclose(file);
+        std::cout << "Error: " << file_path << " is not a version " << TRACE_VERSION << " trace" << std::endl;
+        return false;
+    }
+
+    std::vector<TraceRecord> read_records;
+    TraceRecord record;
+    while (std::fread(&record, sizeof(record), 1, file) == 1) {
+        read_records.push_back(record);
+    }
+    std::fclose(file);
+
+    header = read_header;
+    records = std::move(read_records);
+    return true;
+}
@@ -0,0 +1,85 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "trace.h"
+
+// decodes an execution trace (written by Chip8::set_tracing, e.g. chip8emulator --trace) into one line of text per
+// instruction: sequence number, frame, address, opcode and instruction, then the registers it ran with
+
+void print_usage() {
+    std::cout << "Usage: chip8trace [--from <sequence number>] [--count <instructions>] <PATH_TO_TRACE>" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string trace_path;
+    uint64_t from = 0;
+    uint64_t count = UINT64_MAX;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            from = std::strtoull(argv[++i], nullptr, 0);
+        }
+        else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = std::strtoull(argv[++i], nullptr, 0);
+        }
+        else if (argv[i][0] != '-' && trace_path.empty()) {
+            trace_path = argv[i];
+        }
+        else {
+            print_usage();
+            return -1;
+        }
+    }
+    if (trace_path.empty()) {
+        print_usage();
+        return -1;
+    }
+
+    TraceHeader header;
+    std::vector<TraceRecord> records;
+    if (!read_trace(trace_path, header, records)) {
+        return -1;
+    }
+
+    std::cout << "# " << trace_path << ": " << records.size() << " instructions, " << header.dropped << " dropped";
+    if (header.records != records.size()) {
+        std::cout << " (header says " << header.records << " instructions: the trace wasn't closed)";
+    }
+    std::cout << std::endl;
+    std::cout << "# sequence   frame    pc  opcode           i  v0 v1 v2 v3 v4 v5 v6 v7 v8 v9 va vb vc vd ve vf  dt st" << std::endl;
+
+    std::cout << std::hex << std::setfill('0');
+    uint64_t expected = 0; // sequence number of the next record, if none were dropped
+    uint64_t printed = 0;
+    for (const TraceRecord& record : records) {
+        if (record.sequence < from) {
+            expected = record.sequence + 1;
+            continue;
+        }
+        if (printed == count) {
+            break;
+        }
+        if (record.sequence != expected && printed != 0) {
+            std::cout << std::dec << "# " << (record.sequence - expected) << " instructions dropped" << std::hex << std::endl;
+        }
+        expected = record.sequence + 1;
+
+        std::cout << std::dec << std::setfill(' ') << std::setw(10) << record.sequence << " " << std::setw(7) << record.frame
+                  << std::hex << std::setfill('0') << "  " << std::setw(4) << record.pc << "  " << std::setw(4) << record.opcode
+                  << " " << std::left << std::setfill(' ') << std::setw(7) << CPU::get_handler_name(CPU::get_handler(record.opcode))
+                  << std::right << std::setfill('0') << "  " << std::setw(4) << record.i << " ";
+        for (uint8_t v : record.v) {
+            std::cout << " " << std::setw(2) << unsigned(v);
+        }
+        std::cout << "  " << std::setw(2) << unsigned(record.delay_timer) << " " << std::setw(2) << unsigned(record.sound_timer) << "\n";
+        printed++;
+    }
+    std::cout << std::flush;
+    return 0;
+}
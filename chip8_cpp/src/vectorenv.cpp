@@ -0,0 +1,217 @@
+#include "vectorenv.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "chip8.h"
+#include "inputlog.h"
+
+namespace {
+
+    // the 8 pixels of a byte of a row, as 8 bytes of 0 / 1, leftmost (most significant bit) first
+    constexpr std::array<std::array<uint8_t, 8>, 256> build_byte_pixels() {
+        std::array<std::array<uint8_t, 8>, 256> pixels{};
+        for (int byte = 0; byte < 256; byte++) {
+            for (int bit = 0; bit < 8; bit++) {
+                pixels[byte][bit] = (byte >> (7 - bit)) & 1;
+            }
+        }
+        return pixels;
+    }
+
+    constexpr std::array<std::array<uint8_t, 8>, 256> byte_pixels = build_byte_pixels();
+
+    uint64_t expand_byte(uint8_t byte) {
+        uint64_t pixels;
+        std::memcpy(&pixels, byte_pixels[byte].data(), sizeof(pixels));
+        return pixels;
+    }
+
+}
+
+VectorEnv::VectorEnv(int instances, int threads)
+    : instructions_per_frame_(DEFAULT_INSTRUCTIONS_PER_FRAME), slice_count_(std::clamp(threads, 1, std::max(instances, 1))),
+      job_start_(slice_count_), job_end_(slice_count_) {
+    instances_.reserve(instances);
+    for (int i = 0; i < instances; i++) {
+        instances_.push_back(std::make_unique<Instance>());
+    }
+    if (!instances_.empty()) {
+        instances_[0]->cpu.save_state(episode_start_);
+    }
+    // the caller's thread runs the first slice
+    for (int slice = 1; slice < slice_count_; slice++) {
+        workers_.emplace_back(&VectorEnv::worker_loop, this, slice);
+    }
+}
+
+VectorEnv::~VectorEnv() {
+    stopping_ = true;
+    if (!workers_.empty()) {
+        job_start_.arrive_and_wait();
+    }
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void VectorEnv::load_ROM(const Rom& rom) {
+    // straight into the state episodes start from, so that starting one is a single load_state. power on memory is a
+    // new Memory's with the ROM loaded
+    Memory memory;
+    memory.load_ROM(rom);
+    std::fill(std::begin(episode_start_.memory), std::end(episode_start_.memory), 0);
+    std::copy(memory.get_contents(), memory.get_contents() + memory.get_used_size(), episode_start_.memory);
+    episode_start_.memory_size = memory.get_used_size();
+}
+
+void VectorEnv::set_quirks(QuirkProfile profile) {
+    for (std::unique_ptr<Instance>& instance : instances_) {
+        instance->cpu.set_quirks(profile);
+    }
+}
+
+void VectorEnv::set_instructions_per_frame(int instructions_per_frame) {
+    instructions_per_frame_ = instructions_per_frame;
+}
+
+void VectorEnv::set_frame_skip(int frame_skip) {
+    frame_skip_ = frame_skip;
+}
+
+void VectorEnv::set_reward(RewardFunction reward, void* context) {
+    reward_ = reward;
+    reward_context_ = context;
+}
+
+void VectorEnv::set_done(DoneFunction done, void* context) {
+    done_ = done;
+    done_context_ = context;
+}
+
+void VectorEnv::reset(const uint32_t* seeds, uint8_t* observations) {
+    seeds_ = seeds;
+    actions_ = nullptr;
+    observations_ = observations;
+    run_job();
+}
+
+void VectorEnv::step(const uint16_t* actions, uint8_t* observations, float* rewards, uint8_t* dones) {
+    actions_ = actions;
+    observations_ = observations;
+    rewards_ = rewards;
+    dones_ = dones;
+    run_job();
+}
+
+const uint8_t* VectorEnv::get_memory(int instance) const {
+    return instances_[instance]->memory.get_contents();
+}
+
+const Framebuffer& VectorEnv::get_framebuffer(int instance) const {
+    return instances_[instance]->framebuffer;
+}
+
+Registers VectorEnv::get_registers(int instance) const {
+    return instances_[instance]->cpu.get_registers();
+}
+
+uint64_t VectorEnv::get_episode(int instance) const {
+    return instances_[instance]->episode;
+}
+
+void VectorEnv::start_episode(int index) {
+    Instance& instance = *instances_[index];
+    instance.cpu.load_state(episode_start_);
+    instance.cpu.set_seed(instance.seed + static_cast<uint32_t>(instance.episode));
+    instance.keys = 0;
+}
+
+void VectorEnv::observe(int index, uint8_t* observation) const {
+    const Framebuffer& framebuffer = instances_[index]->framebuffer;
+    if (!framebuffer.is_hires()) {
+        // a row is one word a plane: 8 table lookups (and 8 more for the second plane, if anything is drawn on it)
+        for (unsigned int y = 0; y < OBSERVATION_HEIGHT; y++) {
+            uint64_t plane0 = framebuffer.get_word(0, 0, y);
+            uint64_t plane1 = framebuffer.get_word(1, 0, y);
+            for (int byte = 0; byte < 8; byte++) {
+                int shift = 56 - 8 * byte;
+                uint64_t pixels = expand_byte(plane0 >> shift);
+                if (plane1 != 0) {
+                    pixels |= expand_byte(plane1 >> shift) << 1;
+                }
+                std::memcpy(observation + y * OBSERVATION_WIDTH + 8 * byte, &pixels, sizeof(pixels));
+            }
+        }
+        return;
+    }
+    for (unsigned int y = 0; y < OBSERVATION_HEIGHT; y++) {
+        for (unsigned int x = 0; x < OBSERVATION_WIDTH; x++) {
+            observation[y * OBSERVATION_WIDTH + x] = framebuffer.get_color(2 * x, 2 * y) | framebuffer.get_color(2 * x + 1, 2 * y)
+                                                     | framebuffer.get_color(2 * x, 2 * y + 1) | framebuffer.get_color(2 * x + 1, 2 * y + 1);
+        }
+    }
+}
+
+void VectorEnv::run_slice(int slice) {
+    int count = get_instance_count();
+    int first = count * slice / slice_count_;
+    int last = count * (slice + 1) / slice_count_;
+    for (int index = first; index < last; index++) {
+        Instance& instance = *instances_[index];
+        uint8_t* observation = observations_ + static_cast<size_t>(index) * OBSERVATION_BYTES;
+        if (actions_ == nullptr) {
+            instance.seed = seeds_[index];
+            instance.episode = 0;
+            start_episode(index);
+            observe(index, observation);
+            continue;
+        }
+
+        // the keys are latched for every frame of the step, as the frontends latch them for a frame
+        uint16_t keys = actions_[index];
+        InputFrame input{keys, static_cast<uint16_t>(instance.keys & ~keys)};
+        instance.keys = keys;
+        float reward = 0;
+        bool done = false;
+        for (int frame = 0; frame < frame_skip_ && !done; frame++) {
+            instance.cpu.set_input(input);
+            input.released = 0;
+            instance.cpu.run_cycles(instructions_per_frame_);
+            instance.cpu.decrement_timer();
+            const uint8_t* memory = instance.memory.get_contents();
+            if (reward_ != nullptr) {
+                reward += reward_(index, memory, reward_context_);
+            }
+            done = (done_ != nullptr && done_(index, memory, done_context_)) || instance.cpu.is_stopped();
+        }
+        rewards_[index] = reward;
+        dones_[index] = done;
+        if (done) {
+            instance.episode++;
+            start_episode(index);
+        }
+        observe(index, observation);
+    }
+}
+
+void VectorEnv::worker_loop(int slice) {
+    while (true) {
+        job_start_.arrive_and_wait();
+        if (stopping_) {
+            return;
+        }
+        run_slice(slice);
+        job_end_.arrive_and_wait();
+    }
+}
+
+void VectorEnv::run_job() {
+    if (workers_.empty()) {
+        run_slice(0);
+        return;
+    }
+    job_start_.arrive_and_wait();
+    run_slice(0);
+    job_end_.arrive_and_wait();
+}
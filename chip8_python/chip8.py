@@ -5,6 +5,7 @@ from memory import Memory
 from clock import Clock
 from cpu import CPU
 from sound import Sound
+from libchip8 import Chip8Core
 
 class Chip8:
     def __init__(self, ROM):
@@ -60,3 +61,63 @@ class Chip8:
         """
         self.renderer.quit()
         self.running = False
+
+
+class NativeChip8:
+    """
+    The same frontend as Chip8, with the C++ core (libchip8) running the ROM in place of the Python CPU
+    """
+    def __init__(self, ROM, instructions_per_frame=12):
+        self.core = Chip8Core()
+        self.core.load_rom(ROM)
+        self.core.set_instructions_per_frame(instructions_per_frame)
+
+        self.renderer = Renderer()
+        self.sound = Sound()
+        # only for the key mapping
+        self.valid_keys = Memory().valid_keys
+
+        # the core runs a frame's instructions at a time, so only the 60 fps clock is needed
+        self.renderer_clock = Clock(rate=60)
+
+        self.running = False
+
+    def start(self):
+        """
+        Run a frame of the core at a time, showing its framebuffer after each
+        """
+        self.running = True
+        while self.running:
+            # the keypad is latched for the whole frame
+            pressed = pygame.key.get_pressed()
+            keys = 0
+            for key, key_code in self.valid_keys.items():
+                if pressed[key_code]:
+                    keys |= 1 << key
+            self.core.set_keys(keys)
+            self.core.run_frames(1)
+
+            # the framebuffer, read straight out of the core
+            width, height = self.core.get_width(), self.core.get_height()
+            self.renderer.set_resolution(width, height)
+            for row in range(height):
+                for col in range(width):
+                    self.renderer.set_color_at_pixel(row, col, self.core.get_pixel(row, col))
+            self.renderer.render()
+
+            self.sound.set_timer(self.core.get_registers().sound_timer)
+            self.sound.decrement_timer()
+
+            for event in pygame.event.get():
+                if event.type == pygame.QUIT:
+                    self.close()
+
+            self.renderer_clock.tick()
+
+    def close(self):
+        """
+        Stop running the emulator - exit running loop and quit out of pygame
+        """
+        self.renderer.quit()
+        self.core.close()
+        self.running = False
@@ -0,0 +1,289 @@
+import ctypes
+import ctypes.util
+import os
+from typing import Optional
+
+# these follow chip8_cpp/include/libchip8.h
+API_VERSION = 1
+MEMORY_SIZE = 65536
+MAX_ROM_SIZE = MEMORY_SIZE - 0x200
+SCREEN_WIDTH = 128
+SCREEN_HEIGHT = 64
+ROW_WORDS = 2
+PLANE_COUNT = 2
+FRAMEBUFFER_WORDS = PLANE_COUNT * ROW_WORDS * SCREEN_HEIGHT
+OBSERVATION_WIDTH = 64
+OBSERVATION_HEIGHT = 32
+OBSERVATION_BYTES = OBSERVATION_WIDTH * OBSERVATION_HEIGHT
+
+QUIRKS = {"chip8": 0, "vip": 1, "schip": 2, "xochip": 3}
+
+ERRORS = {-1: "invalid argument", -2: "ROM is empty", -3: "ROM is too big for memory", -4: "no ROM loaded"}
+
+
+# called after every frame of every instance with the instance's index, its memory and the context given with it
+REWARD_FUNCTION = ctypes.CFUNCTYPE(ctypes.c_float, ctypes.c_int, ctypes.POINTER(ctypes.c_uint8), ctypes.c_void_p)
+DONE_FUNCTION = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_int, ctypes.POINTER(ctypes.c_uint8), ctypes.c_void_p)
+
+
+class Registers(ctypes.Structure):
+    _fields_ = [("pc", ctypes.c_uint16),
+                ("i", ctypes.c_uint16),
+                ("v", ctypes.c_uint8 * 16),
+                ("delay_timer", ctypes.c_uint8),
+                ("sound_timer", ctypes.c_uint8)]
+
+
+def find_library() -> str:
+    """
+    Return the path to libchip8: $CHIP8_LIBRARY if set, then the chip8_cpp build folder (as in the README), then wherever
+    the system keeps its libraries
+    """
+    if "CHIP8_LIBRARY" in os.environ:
+        return os.environ["CHIP8_LIBRARY"]
+    build = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "chip8_cpp", "build", "libchip8.so")
+    if os.path.exists(build):
+        return build
+    found = ctypes.util.find_library("chip8")
+    if found is None:
+        raise OSError("libchip8 not found: build chip8_cpp, or set CHIP8_LIBRARY to its path")
+    return found
+
+
+def load_library(path: Optional[str] = None) -> ctypes.CDLL:
+    """
+    Load libchip8 and declare the C API's signatures, checking that the library is the version this module expects
+    """
+    lib = ctypes.CDLL(path or find_library())
+    handle = ctypes.c_void_p
+
+    lib.chip8_get_api_version.argtypes = []
+    lib.chip8_get_api_version.restype = ctypes.c_int
+    if lib.chip8_get_api_version() != API_VERSION:
+        raise OSError(f"libchip8 is API version {lib.chip8_get_api_version()}, expected {API_VERSION}")
+
+    signatures = {"chip8_create": ([], handle),
+                  "chip8_destroy": ([handle], None),
+                  "chip8_load_rom": ([handle, ctypes.c_char_p, ctypes.c_size_t], ctypes.c_int),
+                  "chip8_reset": ([handle], ctypes.c_int),
+                  "chip8_set_quirks": ([handle, ctypes.c_int], ctypes.c_int),
+                  "chip8_set_instructions_per_frame": ([handle, ctypes.c_int], ctypes.c_int),
+                  "chip8_set_seed": ([handle, ctypes.c_uint32], None),
+                  "chip8_set_keys": ([handle, ctypes.c_uint16], None),
+                  "chip8_step": ([handle, ctypes.c_int], None),
+                  "chip8_run_frames": ([handle, ctypes.c_int], None),
+                  "chip8_get_memory": ([handle], ctypes.c_void_p),
+                  "chip8_get_framebuffer": ([handle], ctypes.c_void_p),
+                  "chip8_get_width": ([handle], ctypes.c_int),
+                  "chip8_get_height": ([handle], ctypes.c_int),
+                  "chip8_get_registers": ([handle, ctypes.POINTER(Registers)], None),
+                  "chip8_get_frame_count": ([handle], ctypes.c_uint64),
+                  "chip8_is_waiting_for_key": ([handle], ctypes.c_int),
+                  "chip8_is_stopped": ([handle], ctypes.c_int),
+                  "chip8_vector_env_create": ([ctypes.c_int, ctypes.c_int], handle),
+                  "chip8_vector_env_destroy": ([handle], None),
+                  "chip8_vector_env_load_rom": ([handle, ctypes.c_char_p, ctypes.c_size_t], ctypes.c_int),
+                  "chip8_vector_env_set_quirks": ([handle, ctypes.c_int], ctypes.c_int),
+                  "chip8_vector_env_set_instructions_per_frame": ([handle, ctypes.c_int], ctypes.c_int),
+                  "chip8_vector_env_set_frame_skip": ([handle, ctypes.c_int], ctypes.c_int),
+                  "chip8_vector_env_set_reward": ([handle, REWARD_FUNCTION, ctypes.c_void_p], None),
+                  "chip8_vector_env_set_done": ([handle, DONE_FUNCTION, ctypes.c_void_p], None),
+                  "chip8_vector_env_reset": ([handle, ctypes.c_void_p, ctypes.c_void_p], ctypes.c_int),
+                  "chip8_vector_env_step": ([handle, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p], ctypes.c_int),
+                  "chip8_vector_env_get_instance_count": ([handle], ctypes.c_int),
+                  "chip8_vector_env_get_memory": ([handle, ctypes.c_int], ctypes.c_void_p)}
+    for name, (argtypes, restype) in signatures.items():
+        function = getattr(lib, name)
+        function.argtypes = argtypes
+        function.restype = restype
+    return lib
+
+
+def check(result: int) -> None:
+    """
+    Raise the error a C API call returned, if any
+    """
+    if result != 0:
+        raise ValueError(ERRORS.get(result, f"error {result}"))
+
+
+class Chip8Core:
+    """
+    A CHIP-8 machine in the C++ core (libchip8), driven through its C API. The same instructions as the Python CPU,
+    many times faster, plus SUPER-CHIP / XO-CHIP.
+
+    memory and framebuffer are ctypes arrays over the machine itself rather than copies: they are made once, and show
+    the machine as it is after every step, without copying a byte
+    """
+    def __init__(self, lib: Optional[ctypes.CDLL] = None) -> None:
+        self.lib = lib or load_library()
+        self.handle = self.lib.chip8_create()
+        if not self.handle:
+            raise MemoryError("could not create a CHIP-8 machine")
+        self.memory = (ctypes.c_uint8 * MEMORY_SIZE).from_address(self.lib.chip8_get_memory(self.handle))
+        self.framebuffer = (ctypes.c_uint64 * FRAMEBUFFER_WORDS).from_address(self.lib.chip8_get_framebuffer(self.handle))
+
+    def close(self) -> None:
+        """
+        Free the machine. memory and framebuffer can't be used after this
+        """
+        if self.handle:
+            self.memory = None
+            self.framebuffer = None
+            self.lib.chip8_destroy(self.handle)
+            self.handle = None
+
+    def __del__(self) -> None:
+        self.close()
+
+    def load_rom(self, ROM: str) -> None:
+        """
+        Reset the machine and load the ROM file into memory at 0x200
+        """
+        with open(ROM, 'rb') as ROM_file:
+            data = ROM_file.read()
+        check(self.lib.chip8_load_rom(self.handle, data, len(data)))
+
+    def reset(self) -> None:
+        """
+        Back to power on, with the last ROM loaded
+        """
+        check(self.lib.chip8_reset(self.handle))
+
+    def set_quirks(self, quirks: str) -> None:
+        check(self.lib.chip8_set_quirks(self.handle, QUIRKS[quirks]))
+
+    def set_instructions_per_frame(self, instructions_per_frame: int) -> None:
+        check(self.lib.chip8_set_instructions_per_frame(self.handle, instructions_per_frame))
+
+    def set_seed(self, seed: int) -> None:
+        self.lib.chip8_set_seed(self.handle, seed)
+
+    def set_keys(self, keys: int) -> None:
+        """
+        Set the keypad for the next step or frame, bit k set while key k is held down
+        """
+        self.lib.chip8_set_keys(self.handle, keys)
+
+    def step(self, instructions: int = 1) -> None:
+        """
+        Run instructions without ticking the timers
+        """
+        self.lib.chip8_step(self.handle, instructions)
+
+    def run_frames(self, frames: int = 1) -> None:
+        """
+        Run frames: a frame's instructions, then the delay and sound timers tick
+        """
+        self.lib.chip8_run_frames(self.handle, frames)
+
+    def get_width(self) -> int:
+        return self.lib.chip8_get_width(self.handle)
+
+    def get_height(self) -> int:
+        return self.lib.chip8_get_height(self.handle)
+
+    def get_pixel(self, row: int, col: int, plane: int = 0) -> bool:
+        """
+        Return True if the pixel at <row, col> is on in the plane
+        """
+        word = self.framebuffer[(plane * ROW_WORDS + col // 64) * SCREEN_HEIGHT + row]
+        return (word >> (63 - col % 64)) & 1 == 1
+
+    def get_registers(self) -> Registers:
+        registers = Registers()
+        self.lib.chip8_get_registers(self.handle, ctypes.byref(registers))
+        return registers
+
+    def get_frame_count(self) -> int:
+        return self.lib.chip8_get_frame_count(self.handle)
+
+    def is_waiting_for_key(self) -> bool:
+        return self.lib.chip8_is_waiting_for_key(self.handle) != 0
+
+    def is_stopped(self) -> bool:
+        return self.lib.chip8_is_stopped(self.handle) != 0
+
+
+class VectorEnv:
+    """
+    Many instances of one ROM in the C++ core, as an environment for automated play: reset them all, then step them all
+    at once with a keypad mask each (bit k for key k), frame_skip frames a step, spread over threads.
+
+    Observations are written into one contiguous buffer of instances x 32 x 64 bytes, a byte per pixel, given by the
+    caller (a bytearray, a numpy uint8 array or anything else writable) or made here. memories are views of each
+    instance's memory, for reading the score and the like.
+
+    The reward and done functions are called after every frame of every instance. They can be ctypes functions
+    (REWARD_FUNCTION / DONE_FUNCTION, e.g. from a compiled library), which run at the core's speed, or Python
+    functions of (instance, memory), which are much slower as every call goes back into Python
+    """
+    def __init__(self, ROM: str, instances: int, threads: int = 1, frame_skip: int = 4, instructions_per_frame: int = 12,
+                 quirks: str = "chip8", lib: Optional[ctypes.CDLL] = None) -> None:
+        self.lib = lib or load_library()
+        self.instances = instances
+        self.handle = self.lib.chip8_vector_env_create(instances, threads)
+        if not self.handle:
+            raise ValueError("could not create the environment: instances and threads must be positive")
+        with open(ROM, 'rb') as ROM_file:
+            data = ROM_file.read()
+        check(self.lib.chip8_vector_env_load_rom(self.handle, data, len(data)))
+        check(self.lib.chip8_vector_env_set_frame_skip(self.handle, frame_skip))
+        check(self.lib.chip8_vector_env_set_instructions_per_frame(self.handle, instructions_per_frame))
+        check(self.lib.chip8_vector_env_set_quirks(self.handle, QUIRKS[quirks]))
+
+        self.memories = [(ctypes.c_uint8 * MEMORY_SIZE).from_address(self.lib.chip8_vector_env_get_memory(self.handle, i))
+                         for i in range(instances)]
+        self.rewards = (ctypes.c_float * instances)()
+        self.dones = (ctypes.c_uint8 * instances)()
+        self.observations = bytearray(instances * OBSERVATION_BYTES)
+        # ctypes functions must outlive the environment's use of them
+        self.reward_function = None
+        self.done_function = None
+
+    def close(self) -> None:
+        if self.handle:
+            self.memories = None
+            self.lib.chip8_vector_env_destroy(self.handle)
+            self.handle = None
+
+    def __del__(self) -> None:
+        self.close()
+
+    def set_reward(self, function) -> None:
+        if function is not None and not isinstance(function, REWARD_FUNCTION):
+            python_function = function
+            function = REWARD_FUNCTION(lambda instance, memory, context: python_function(instance, self.memories[instance]))
+        self.reward_function = function
+        self.lib.chip8_vector_env_set_reward(self.handle, function or REWARD_FUNCTION(), None)
+
+    def set_done(self, function) -> None:
+        if function is not None and not isinstance(function, DONE_FUNCTION):
+            python_function = function
+            function = DONE_FUNCTION(lambda instance, memory, context: int(bool(python_function(instance, self.memories[instance]))))
+        self.done_function = function
+        self.lib.chip8_vector_env_set_done(self.handle, function or DONE_FUNCTION(), None)
+
+    def __buffer(self, observations):
+        if observations is None:
+            observations = self.observations
+        buffer = (ctypes.c_uint8 * (self.instances * OBSERVATION_BYTES)).from_buffer(observations)
+        return observations, buffer
+
+    def reset(self, seeds, observations=None):
+        """
+        Start an episode in every instance, instance i seeded with seeds[i]. Returns the observations
+        """
+        observations, buffer = self.__buffer(observations)
+        check(self.lib.chip8_vector_env_reset(self.handle, (ctypes.c_uint32 * self.instances)(*seeds), buffer))
+        return observations
+
+    def step(self, actions, observations=None):
+        """
+        Hold down actions[i] in instance i for a step. Returns the observations, and each instance's reward and whether
+        its episode ended (after which it has started the next)
+        """
+        observations, buffer = self.__buffer(observations)
+        check(self.lib.chip8_vector_env_step(self.handle, (ctypes.c_uint16 * self.instances)(*actions), buffer, self.rewards,
+                                             self.dones))
+        return observations, self.rewards, self.dones
@@ -1,13 +1,20 @@
 import sys
 
-from chip8 import Chip8
+from chip8 import Chip8, NativeChip8
 
 if __name__ == "__main__":
-    # check if a ROM is specified
-    if len(sys.argv) != 2:
+    # check if a ROM is specified, and whether to run it on the C++ core
+    args = sys.argv[1:]
+    native = "--native" in args
+    if native:
+        args.remove("--native")
+    if len(args) != 1:
         print("Please specify ROM")
         exit(-1)
         
     # create the Chip 8 system
-    chip8 = Chip8(ROM=sys.argv[1])
+    if native:
+        chip8 = NativeChip8(ROM=args[0])
+    else:
+        chip8 = Chip8(ROM=args[0])
     chip8.start()
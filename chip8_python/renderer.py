@@ -12,6 +12,13 @@ class Renderer:
         self.white = (255, 255, 255)
         self.black = (0, 0, 0)
 
+    def set_resolution(self, width: int, height: int) -> None:
+        """
+        Resize the window to <width, height> pixels (SUPER-CHIP hi-res is 128x64)
+        """
+        if self.display.get_size() != (width, height):
+            self.display = pygame.display.set_mode((width, height))
+
     def clear_screen(self) -> None:
         self.display.fill('black')
 